@@ -34,6 +34,10 @@ config.indent_size = 2
 config.tab_type = "soft"
 config.keep_newline_whitespace = false
 config.line_limit = 80
+-- lines at least this many bytes long are only drawn where visible
+config.long_line_length = 1024
+-- ranges of at least this many lines are highlighted on worker threads
+config.highlight_job_lines = 200
 config.max_project_files = 2000
 config.transitions = true
 config.disabled_transitions = {
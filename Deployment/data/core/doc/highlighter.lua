@@ -14,18 +14,25 @@ function Highlighter:new(doc)
   -- init incremental syntax highlighting
   core.add_thread(function()
     while true do
+      local running = self.job and not self:update_job()
       if self.first_invalid_line > self.max_wanted_line then
         self.max_wanted_line = 0
         coroutine.yield(1 / config.fps)
 
+      elseif running then
+        coroutine.yield(1 / config.fps)
+
+      elseif self.max_wanted_line - self.first_invalid_line >= config.highlight_job_lines
+      and self:start_job() then
+        coroutine.yield(1 / config.fps)
+
       else
         local max = math.min(self.first_invalid_line + 40, self.max_wanted_line)
 
         for i = self.first_invalid_line, max do
-          local state = (i > 1) and self.lines[i - 1].state
-          local line = self.lines[i]
-          if not (line and line.init_state == state) then
-            self.lines[i] = self:tokenize_line(i, state)
+          local state = self.lines:get_state(i - 1)
+          if self.lines:get_init_state(i) ~= state then
+            self:tokenize_line(i, state)
           end
         end
 
@@ -39,7 +46,11 @@ end
 
 
 function Highlighter:reset()
-  self.lines = {}
+  if self.job then self.job:cancel() end
+  self.job = nil
+  self.job_first = nil
+  -- tokens are kept natively, see `tokenizer.lines`
+  self.lines = tokenizer.lines()
   self.first_invalid_line = 1
   self.max_wanted_line = 0
 end
@@ -48,32 +59,71 @@ end
 function Highlighter:invalidate(idx)
   self.first_invalid_line = math.min(self.first_invalid_line, idx)
   self.max_wanted_line = math.min(self.max_wanted_line, #self.doc.lines)
+  if self.job then self.job:truncate(idx) end
+end
+
+
+-- highlights the rest of the document on worker threads, replacing a
+-- previous job
+function Highlighter:start_job()
+  local compiled = tokenizer.compile(self.doc.syntax)
+  if not compiled then return false end
+  local first = self.first_invalid_line
+  if self.job then self.job:cancel() end
+  self.job = compiled:highlight(self.doc.buffer, first, self.lines:get_state(first - 1))
+  self.job_first = first
+  return true
+end
+
+
+-- takes over the lines the job has finished, the job is dropped once it is
+-- done; returns whether it is
+function Highlighter:update_job()
+  -- lines tokenized meanwhile from a guessed state give way to the job's
+  local ready, done = self.job:poll(self.lines, self.first_invalid_line)
+  local last = self.job_first + ready - 1
+  if last >= self.first_invalid_line then
+    self.first_invalid_line = last + 1
+    core.redraw = true
+  end
+  if done then
+    self.job:cancel()
+    self.job = nil
+  end
+  return done
 end
 
 
 function Highlighter:tokenize_line(idx, state)
-  local res = {}
-  res.init_state = state
-  res.text = self.doc.lines[idx]
-  res.tokens, res.state = tokenizer.tokenize(self.doc.syntax, res.text, state)
-  return res
+  return tokenizer.tokenize_line(self.doc.syntax, self.lines, idx, self.doc.lines[idx], state)
 end
 
 
-function Highlighter:get_line(idx)
-  local line = self.lines[idx]
-  if not line or line.text ~= self.doc.lines[idx] then
-    local prev = self.lines[idx - 1]
-    line = self:tokenize_line(idx, prev and prev.state)
-    self.lines[idx] = line
+-- makes sure the tokens of the line are those of its text, which is returned
+function Highlighter:update_line(idx)
+  local text = self.doc.lines[idx]
+  if not self.lines:matches(idx, text) then
+    self:tokenize_line(idx, self.lines:get_state(idx - 1))
   end
   self.max_wanted_line = math.max(self.max_wanted_line, idx)
-  return line
+  return text
+end
+
+
+-- returns the line as a table; `update_line` and `each_token` avoid making one
+function Highlighter:get_line(idx)
+  local text = self:update_line(idx)
+  return {
+    init_state = self.lines:get_init_state(idx) or nil,
+    state = self.lines:get_state(idx),
+    text = text,
+    tokens = self.lines:get_tokens(idx, text),
+  }
 end
 
 
 function Highlighter:each_token(idx)
-  return tokenizer.each_token(self:get_line(idx).tokens)
+  return self.lines:each_token(idx, self:update_line(idx))
 end
 
 
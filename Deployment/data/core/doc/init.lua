@@ -8,31 +8,33 @@ local common = require "core.common"
 local Doc = Object:extend()
 
 
-local function split_lines(text)
-  local res = {}
-  for line in (text .. "\n"):gmatch("(.-)\n") do
-    table.insert(res, line)
-  end
-  return res
-end
-
-
-local function splice(t, at, remove, insert)
-  insert = insert or {}
-  local offset = #insert - remove
-  local old_len = #t
-  if offset < 0 then
-    for i = at - offset, old_len - offset do
-      t[i + offset] = t[i]
-    end
-  elseif offset > 0 then
-    for i = old_len, at, -1 do
-      t[i + offset] = t[i]
-    end
-  end
-  for i, item in ipairs(insert) do
-    t[at + i - 1] = item
+-- read-only view of the buffer so `doc.lines[i]`, `#doc.lines` and
+-- `ipairs(doc.lines)` keep working; edits go through Doc:insert/remove.
+-- Long lines are kept until the next edit, so they are returned as the same
+-- string and the renderer can reuse the column index it built for them
+local function lines_view(doc)
+  local buf = doc.buffer
+  local function iter(_, i)
+    i = i + 1
+    local line = buf:get_line(i)
+    if line then return i, line end
   end
+  return setmetatable({}, {
+    __index = function(_, idx)
+      if type(idx) == "number" then
+        local line = doc.long_lines[idx]
+        if line then return line end
+        line = buf:get_line(idx)
+        if line and #line >= config.long_line_length then
+          doc.long_lines[idx] = line
+        end
+        return line
+      end
+    end,
+    __len = function() return buf:line_count() end,
+    __ipairs = function(t) return iter, t, 0 end,
+    __newindex = function() error("doc.lines is read-only") end,
+  })
 end
 
 
@@ -45,7 +47,9 @@ end
 
 
 function Doc:reset()
-  self.lines = { "\n" }
+  self.buffer = buffer.new()
+  self.long_lines = {}
+  self.lines = lines_view(self)
   self.selection = { a = { line=1, col=1 }, b = { line=1, col=1 } }
   self.undo_stack = { idx = 1 }
   self.redo_stack = { idx = 1 }
@@ -66,33 +70,20 @@ end
 
 
 function Doc:load(filename)
-  local fp = assert( io.open(filename, "rb") )
+  local buf, crlf = assert( buffer.load(filename) )
   self:reset()
   self.filename = filename
-  self.lines = {}
-  for line in fp:lines() do
-    if line:byte(-1) == 13 then
-      line = line:sub(1, -2)
-      self.crlf = true
-    end
-    table.insert(self.lines, line .. "\n")
-  end
-  if #self.lines == 0 then
-    table.insert(self.lines, "\n")
-  end
-  fp:close()
+  self.buffer = buf
+  self.long_lines = {}
+  self.lines = lines_view(self)
+  self.crlf = crlf or nil
   self:reset_syntax()
 end
 
 
 function Doc:save(filename)
   filename = filename or assert(self.filename, "no filename set to default to")
-  local fp = assert( io.open(filename, "wb") )
-  for _, line in ipairs(self.lines) do
-    if self.crlf then line = line:gsub("\n", "\r\n") end
-    fp:write(line)
-  end
-  fp:close()
+  assert( self.buffer:save(filename, self.crlf) )
   self.filename = filename or self.filename
   self:reset_syntax()
   self:clean()
@@ -159,8 +150,8 @@ end
 
 
 function Doc:sanitize_position(line, col)
-  line = common.clamp(line, 1, #self.lines)
-  col = common.clamp(col, 1, #self.lines[line])
+  line = common.clamp(line, 1, self.buffer:line_count())
+  col = common.clamp(col, 1, self.buffer:line_length(line))
   return line, col
 end
 
@@ -172,17 +163,7 @@ end
 
 
 local function position_offset_byte(self, line, col, offset)
-  line, col = self:sanitize_position(line, col)
-  col = col + offset
-  while line > 1 and col < 1 do
-    line = line - 1
-    col = col + #self.lines[line]
-  end
-  while line < #self.lines and col > #self.lines[line] do
-    col = col - #self.lines[line]
-    line = line + 1
-  end
-  return self:sanitize_position(line, col)
+  return self.buffer:position(self.buffer:offset(line, col) + offset)
 end
 
 
@@ -207,16 +188,7 @@ end
 function Doc:get_text(line1, col1, line2, col2)
   line1, col1 = self:sanitize_position(line1, col1)
   line2, col2 = self:sanitize_position(line2, col2)
-  line1, col1, line2, col2 = sort_positions(line1, col1, line2, col2)
-  if line1 == line2 then
-    return self.lines[line1]:sub(col1, col2 - 1)
-  end
-  local lines = { self.lines[line1]:sub(col1) }
-  for i = line1 + 1, line2 - 1 do
-    table.insert(lines, self.lines[i])
-  end
-  table.insert(lines, self.lines[line2]:sub(1, col2 - 1))
-  return table.concat(lines)
+  return self.buffer:get_text(line1, col1, line2, col2)
 end
 
 
@@ -263,18 +235,8 @@ end
 
 
 function Doc:raw_insert(line, col, text, undo_stack, time)
-  -- split text into lines and merge with line at insertion point
-  local lines = split_lines(text)
-  local before = self.lines[line]:sub(1, col - 1)
-  local after = self.lines[line]:sub(col)
-  for i = 1, #lines - 1 do
-    lines[i] = lines[i] .. "\n"
-  end
-  lines[1] = before .. lines[1]
-  lines[#lines] = lines[#lines] .. after
-
-  -- splice lines into line array
-  splice(self.lines, line, 1, lines)
+  self.buffer:insert(line, col, text)
+  self.long_lines = {}
 
   -- push undo
   local line2, col2 = self:position_offset(line, col, #text)
@@ -293,12 +255,8 @@ function Doc:raw_remove(line1, col1, line2, col2, undo_stack, time)
   push_undo(undo_stack, time, "selection", self:get_selection())
   push_undo(undo_stack, time, "insert", line1, col1, text)
 
-  -- get line content before/after removed text
-  local before = self.lines[line1]:sub(1, col1 - 1)
-  local after = self.lines[line2]:sub(col2)
-
-  -- splice line into line array
-  splice(self.lines, line1, line2 - line1 + 1, { before .. after })
+  self.buffer:remove(line1, col1, line2, col2)
+  self.long_lines = {}
 
   -- update highlighter and assure selection is in bounds
   self.highlighter:invalidate(line1)
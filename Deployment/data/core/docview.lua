@@ -137,25 +137,13 @@ end
 function DocView:get_col_x_offset(line, col)
   local text = self.doc.lines[line]
   if not text then return 0 end
-  return self:get_font():get_width(text:sub(1, col - 1))
+  return self:get_font():get_col_x_offset(text, col)
 end
 
 
 function DocView:get_x_offset_col(line, x)
   local text = self.doc.lines[line]
-
-  local xoffset, last_i, i = 0, 1, 1
-  for char in common.utf8_chars(text) do
-    local w = self:get_font():get_width(char)
-    if xoffset >= x then
-      return (xoffset - x > w / 2) and last_i or i
-    end
-    xoffset = xoffset + w
-    last_i = i
-    i = i + #char
-  end
-
-  return #text
+  return self:get_font():get_x_offset_col(text, x)
 end
 
 
@@ -294,12 +282,23 @@ end
 
 
 function DocView:draw_line_text(idx, x, y)
-  local tx, ty = x, y + self:get_line_text_y_offset()
+  local ty = y + self:get_line_text_y_offset()
+  local highlighter = self.doc.highlighter
+  local text = highlighter:update_line(idx)
   local font = self:get_font()
-  for _, type, text in self.doc.highlighter:each_token(idx) do
-    local color = style.syntax[type]
-    tx = renderer.draw_text(font, text, tx, ty, color)
+  if #text < config.long_line_length then
+    renderer.draw_tokens(font, highlighter.lines, idx, text, style.syntax, x, ty)
+    return
   end
+  -- only draw the part of long lines within the view, give or take a character
+  local col1 = self:get_x_offset_col(idx, self.position.x - x)
+  local col2 = self:get_x_offset_col(idx, self.position.x + self.size.x - x)
+  col1 = math.max(1, col1 - 4)
+  while col1 > 1 and common.is_utf8_cont(text, col1) do col1 = col1 - 1 end
+  col2 = math.min(#text, col2 + 4)
+  while col2 < #text and common.is_utf8_cont(text, col2 + 1) do col2 = col2 + 1 end
+  local x1 = x + self:get_col_x_offset(idx, col1)
+  renderer.draw_tokens(font, highlighter.lines, idx, text, style.syntax, x1, ty, col1, col2)
 end
 
 
@@ -351,6 +350,12 @@ end
 
 
 function DocView:draw()
+  -- everything is drawn as one scroll region, so that on a plain scroll the
+  -- renderer moves what's still visible and only draws the lines coming in
+  local pos = self.position
+  local _, oy = self:get_content_offset()
+  renderer.begin_scroll_region(pos.x, pos.y, self.size.x, self.size.y, pos.y - oy)
+
   self:draw_background(style.background)
 
   local font = self:get_font()
@@ -368,7 +373,6 @@ function DocView:draw()
 
   local x, y = self:get_line_screen_position(minline)
   local gw = self:get_gutter_width()
-  local pos = self.position
   core.push_clip_rect(pos.x + gw, pos.y, self.size.x, self.size.y)
   for i = minline, maxline do
     self:draw_line_body(i, x, y)
@@ -377,6 +381,7 @@ function DocView:draw()
   core.pop_clip_rect()
 
   self:draw_scrollbar()
+  renderer.end_scroll_region()
 end
 
 
@@ -16,63 +16,63 @@ print(USERDIR)
 print(DATADIR)
 
 local function project_scan_thread()
-  local function diff_files(a, b)
-    if #a ~= #b then return true end
-    for i, v in ipairs(a) do
-      if b[i].filename ~= v.filename
-      or b[i].modified ~= v.modified then
-        return true
+  -- malformed patterns are skipped, as core.dirwatch does
+  local function get_ignore_files()
+    local patterns = config.ignore_files
+    if type(patterns) ~= "table" then patterns = { patterns } end
+    local t = {}
+    for _, pattern in ipairs(patterns) do
+      if pcall(string.match, "a", pattern) then
+        table.insert(t, pattern)
       end
     end
+    return t
   end
 
-  local function compare_file(a, b)
-    return a.filename < b.filename
-  end
-
-  local function get_files(path, t)
-    coroutine.yield()
-    t = t or {}
-    local size_limit = config.file_size_limit * 10e5
-    local all = system.list_dir(path) or {}
-    local dirs, files = {}, {}
-
-    for _, file in ipairs(all) do
-      if not common.match_pattern(file, config.ignore_files) then
-        local file = (path ~= "." and path .. PATHSEP or "") .. file
-        local info = system.get_file_info(file)
-        if info and info.size < size_limit then
-          info.filename = file
-          table.insert(info.type == "dir" and dirs or files, info)
-        end
-      end
-    end
-
-    table.sort(dirs, compare_file)
-    for _, f in ipairs(dirs) do
-      table.insert(t, f)
-      get_files(f.filename, t)
-    end
+  local root = system.absolute_path(".")
+  local watch = dirwatch.new()
+  local watched = {}
+  local scan, ignore_files, size_limit
 
-    table.sort(files, compare_file)
-    for _, f in ipairs(files) do
-      table.insert(t, f)
+  local function on_change(dir)
+    if dir == root then
+      scan:invalidate("")
+    elseif dir:sub(1, #root + 1) == root .. PATHSEP then
+      scan:invalidate(dir:sub(#root + 2))
     end
-
-    return t
   end
 
   while true do
-    -- get project files and replace previous table if the new table is
-    -- different
-    local t = get_files(".")
-    if diff_files(core.project_files, t) then
-      core.project_files = t
+    -- the native scanner walks the project on its own thread; restart it if
+    -- the settings it was created with have changed
+    if ignore_files ~= config.ignore_files or size_limit ~= config.file_size_limit then
+      ignore_files, size_limit = config.ignore_files, config.file_size_limit
+      scan = scanner.new(".", get_ignore_files(), size_limit * 1e6)
+    end
+
+    local files = scan:poll()
+    if files then
+      core.project_files = files
       core.redraw = true
+      -- watch every project directory so only the ones that change get
+      -- re-read by the scanner
+      local dirs = { [root] = true }
+      for _, info in ipairs(files) do
+        if info.type == "dir" then
+          dirs[root .. PATHSEP .. info.filename] = true
+        end
+      end
+      for dir in pairs(watched) do
+        if not dirs[dir] then watch:unwatch(dir) end
+      end
+      for dir in pairs(dirs) do
+        if not watched[dir] then watch:watch(dir) end
+      end
+      watched = dirs
     end
 
-    -- wait for next scan
-    coroutine.yield(config.project_scan_rate)
+    watch:check(on_change)
+    coroutine.yield(0.1)
   end
 end
 
@@ -249,7 +249,7 @@ end
 function core.pop_clip_rect()
   table.remove(core.clip_rect_stack)
   local x, y, w, h = table.unpack(core.clip_rect_stack[#core.clip_rect_stack])
-  renderer.pop_clip_rect()
+  renderer.set_clip_rect(x, y, w, h)
 end
 
 
@@ -388,11 +388,15 @@ function core.step()
   end
 
   local width, height = renderer.get_size()
-  core.redraw = true
+
   -- update
   core.root_view.size.x, core.root_view.size.y = width, height
   core.root_view:update()
-  if not core.redraw then return false end
+  if not core.redraw then
+    -- nothing changed: show the cached frame again
+    renderer.present()
+    return false
+  end
   core.redraw = false
 
   -- close unreferenced docs
@@ -462,7 +466,10 @@ function core.run()
     if not did_redraw and not system.window_has_focus() then
       system.wait_event(0.25)
     end
+    -- garbage is only collected here, in what is left of the frame
     local elapsed = system.get_time() - core.frame_start
+    system.step_gc(1 / config.fps - elapsed)
+    elapsed = system.get_time() - core.frame_start
     system.sleep(math.max(0, 1 / config.fps - elapsed))
 end
 
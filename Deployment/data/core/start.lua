@@ -35,8 +35,24 @@ package.cpath =
   DATADIR .. '/?.' .. suffix .. ";" ..
   DATADIR .. '/?/init.' .. suffix .. ";"
 
+-- Lua modules are loaded through a bytecode cache in USERDIR (see
+-- bytecache.c); this file is always parsed, USERDIR is only known here
+local bytecode_dir = USERDIR .. PATHSEP .. 'bytecode'
+system.mkdir(USERDIR)
+system.mkdir(bytecode_dir)
+
+local function lua_searcher(modname)
+  local path, err = package.searchpath(modname, package.path)
+  if not path then return err end
+  local fn, load_err = system.load_cached(path, bytecode_dir)
+  if not fn then
+    error(string.format("error loading module '%s' from file '%s':\n\t%s", modname, path, load_err), 0)
+  end
+  return fn, path
+end
+
 package.native_plugins = {}
-package.searchers = { package.searchers[1], package.searchers[2], function(modname)
+package.searchers = { package.searchers[1], lua_searcher, function(modname)
   local path = package.searchpath(modname, package.cpath)
   if not path then return nil end
   return system.load_native_plugin, path
@@ -1,5 +1,20 @@
+local native = tokenizer
 local tokenizer = {}
 
+-- syntaxes are compiled into native tokenizers the first time they are used;
+-- one that does not compile (e.g. a malformed pattern) keeps using the Lua
+-- tokenizer below, which raises the error where it always did
+local compiled = setmetatable({}, { __mode = "k" })
+
+local function get_compiled(syntax)
+  local c = compiled[syntax]
+  if c == nil then
+    c = native.compile(syntax) or false
+    compiled[syntax] = c
+  end
+  return c
+end
+
 
 local function push_token(t, type, text)
   local prev_type = t[#t-1]
@@ -38,7 +53,17 @@ local function find_non_escaped(text, pattern, offset, esc)
 end
 
 
+-- returns the native tokenizer of the syntax or nil if it has none
+function tokenizer.compile(syntax)
+  return get_compiled(syntax) or nil
+end
+
+
 function tokenizer.tokenize(syntax, text, state)
+  local c = get_compiled(syntax)
+  if c then
+    return c:tokenize(text, state)
+  end
   local res = {}
   local i = 1
 
@@ -96,6 +121,24 @@ function tokenizer.tokenize(syntax, text, state)
 end
 
 
+-- returns the native store for the highlighted lines of a document
+function tokenizer.lines()
+  return native.lines()
+end
+
+
+-- tokenizes `text` as line `idx` of `lines` and returns the state it ends in
+function tokenizer.tokenize_line(syntax, lines, idx, text, state)
+  local c = get_compiled(syntax)
+  if c then
+    return lines:tokenize(idx, c, text, state)
+  end
+  local tokens, end_state = tokenizer.tokenize(syntax, text, state)
+  lines:set(idx, tokens, state, end_state, text)
+  return end_state
+end
+
+
 local function iter(t, i)
   i = i + 2
   local type, text = t[i], t[i+1]
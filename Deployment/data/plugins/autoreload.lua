@@ -33,7 +33,15 @@ core.add_thread(function()
     for _, doc in ipairs(core.docs) do
       local info = system.get_file_info(doc.filename or "")
       if info and times[doc] ~= info.modified then
-        reload_doc(doc)
+        -- the document may still read the old file through a mapping; if
+        -- the file shrank its old text is gone, so it is loaded anew
+        if doc.buffer:detach(info.size) then
+          reload_doc(doc)
+        else
+          local sel = { doc:get_selection() }
+          doc:load(doc.filename)
+          doc:set_selection(table.unpack(sel))
+        end
       end
       coroutine.yield()
     end
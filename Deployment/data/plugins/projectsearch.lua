@@ -9,11 +9,11 @@ local View = require "core.view"
 local ResultsView = View:extend()
 
 
-function ResultsView:new(text, fn)
+function ResultsView:new(text, fn, native)
   ResultsView.super.new(self)
   self.scrollable = true
   self.brightness = 0
-  self:begin_search(text, fn)
+  self:begin_search(text, fn, native)
 end
 
 
@@ -40,13 +40,33 @@ local function find_all_matches_in_file(t, filename, fn)
 end
 
 
-function ResultsView:begin_search(text, fn)
-  self.search_args = { text, fn }
+function ResultsView:begin_search(text, fn, native)
+  self.search_args = { text, fn, native }
   self.results = {}
   self.last_file_idx = 1
+  self.file_count = #core.project_files
   self.query = text
   self.searching = true
   self.selected_idx = 0
+  if self.native_search then
+    self.native_search:cancel()
+    self.native_search = nil
+  end
+
+  -- plain text searches run on native worker threads, their results are
+  -- drained into `self.results` by `update()`
+  if native then
+    local files = {}
+    for _, file in ipairs(core.project_files) do
+      if file.type == "file" then
+        table.insert(files, file.filename)
+      end
+    end
+    self.file_count = #files
+    self.native_search = search.find(files, text)
+    self.scroll.to.y = 0
+    return
+  end
 
   core.add_thread(function()
     for i, file in ipairs(core.project_files) do
@@ -104,6 +124,19 @@ end
 
 
 function ResultsView:update()
+  if self.native_search then
+    local searching, files_done, added = self.native_search:drain(self.results)
+    if added > 0 or files_done ~= self.last_file_idx then
+      self.last_file_idx = files_done
+      core.redraw = true
+    end
+    if not searching then
+      self.native_search = nil
+      self.searching = false
+      self.brightness = 100
+      core.redraw = true
+    end
+  end
   self:move_towards("brightness", 0, 0.1)
   ResultsView.super.update(self)
 end
@@ -162,11 +195,11 @@ function ResultsView:draw()
   -- status
   local ox, oy = self:get_content_offset()
   local x, y = ox + style.padding.x, oy + style.padding.y
-  local per = self.last_file_idx / #core.project_files
+  local per = self.last_file_idx / math.max(self.file_count, 1)
   local text
   if self.searching then
     text = string.format("Searching %d%% (%d of %d files, %d matches) for %q...",
-      per * 100, self.last_file_idx, #core.project_files,
+      per * 100, self.last_file_idx, self.file_count,
       #self.results, self.query)
   else
     text = string.format("Found %d matches for %q",
@@ -204,12 +237,12 @@ function ResultsView:draw()
 end
 
 
-local function begin_search(text, fn)
+local function begin_search(text, fn, native)
   if text == "" then
     core.error("Expected non-empty string")
     return
   end
-  local rv = ResultsView(text, fn)
+  local rv = ResultsView(text, fn, native)
   core.root_view:get_active_node():add_view(rv)
 end
 
@@ -220,7 +253,7 @@ command.add(nil, {
       text = text:lower()
       begin_search(text, function(line_text)
         return line_text:lower():find(text, nil, true)
-      end)
+      end, true)
     end)
   end,
 
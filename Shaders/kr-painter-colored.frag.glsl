@@ -1,8 +0,0 @@
-#version 450
-
-in vec4 fragmentColor;
-out vec4 FragColor;
-
-void main() {
-	FragColor = fragmentColor;
-}
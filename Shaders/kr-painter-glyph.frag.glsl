@@ -0,0 +1,28 @@
+#version 450
+
+// Same glyph shading as kind 1 in kr-painter-uber.frag
+
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+uniform sampler2D tex2;
+uniform sampler2D tex3;
+in vec2 texCoord;
+in vec4 color;
+in float slot;
+in vec2 pixel;
+in vec4 clipRect;
+out vec4 FragColor;
+
+float sampleTex(float slot, vec2 uv) {
+	if (slot < 0.5) return texture(tex0, uv).r;
+	if (slot < 1.5) return texture(tex1, uv).r;
+	if (slot < 2.5) return texture(tex2, uv).r;
+	return texture(tex3, uv).r;
+}
+
+void main() {
+	if (pixel.x < clipRect.x || pixel.y < clipRect.y || pixel.x >= clipRect.z || pixel.y >= clipRect.w) {
+		discard;
+	}
+	FragColor = vec4(color.rgb, sampleTex(slot, texCoord) * color.a);
+}
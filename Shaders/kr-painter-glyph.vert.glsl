@@ -0,0 +1,27 @@
+#version 450
+
+in vec2 corner;
+in vec2 glyphPosition;
+in vec4 glyphUV;
+in vec4 glyphSize;
+in vec4 glyphColor;
+uniform mat4 projectionMatrix;
+// x0, y0, x1, y1 in pixels, see KR_G2_USP_MAX_CLIP_RECTS
+uniform vec4 clipRects[64];
+out vec2 texCoord;
+out vec4 color;
+out float slot;
+out vec2 pixel;
+out vec4 clipRect;
+
+void main() {
+	// position is a normalized short, width, height, texture slot and clip index normalized bytes
+	vec4 ids = floor(glyphSize * 255.0 + 0.5);
+	vec2 pos = floor(glyphPosition * 32767.0 + 0.5) + corner * ids.xy;
+	gl_Position = projectionMatrix * vec4(pos, -5.0, 1.0);
+	texCoord = mix(glyphUV.xy, glyphUV.zw, corner);
+	color = glyphColor;
+	slot = ids.z;
+	pixel = pos;
+	clipRect = clipRects[int(ids.w)];
+}
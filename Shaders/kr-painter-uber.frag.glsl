@@ -0,0 +1,79 @@
+#version 450
+
+// kind.x selects the shading, kind.y the texture unit; see kr_usp_kind_t in uberpainter.c
+// shape is box.xy, border and smooth for the SDF kinds
+// pixel is the position in the render target, fragments outside of clipRect are discarded
+
+uniform sampler2D tex0;
+uniform sampler2D tex1;
+uniform sampler2D tex2;
+uniform sampler2D tex3;
+in vec2 texCoord;
+in vec4 color;
+in vec4 borderColor;
+in vec4 shape;
+in vec4 corner;
+in vec2 kind;
+in vec2 pixel;
+in vec4 clipRect;
+out vec4 FragColor;
+
+
+vec4 sampleTex(float slot, vec2 uv) {
+	if (slot < 0.5) return texture(tex0, uv);
+	if (slot < 1.5) return texture(tex1, uv);
+	if (slot < 2.5) return texture(tex2, uv);
+	return texture(tex3, uv);
+}
+
+float sdRoundBoxCorners(vec2 p, vec2 b, vec4 r) {
+	r.xy = (p.x > 0.0) ? r.xy : r.zw;
+	r.x  = (p.y > 0.0) ? r.x  : r.y;
+	vec2 q = abs(p) - b + r.x;
+	return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - r.x;
+}
+
+float sdRoundBox(vec2 p, vec2 b, float r) {
+	vec2 q = abs(p) - b + r;
+	return min(max(q.x, q.y), 0.0) + length(max(q, 0.0)) - r;
+}
+
+float sdCircle(vec2 p, float r) {
+	return length(p) - r;
+}
+
+vec4 framed(vec4 fgCol, vec4 bdCol, float d, float border, float s) {
+	float dA = 1.0 - smoothstep(0.0, s, clamp(-d, 0.0, 1.0));
+	float dB = 1.0 - smoothstep(0.0, s, clamp(-(abs(d) - border), 0.0, 1.0));
+	return mix(mix(bdCol, fgCol, dB), vec4(0.0), dA);
+}
+
+void main() {
+	if (pixel.x < clipRect.x || pixel.y < clipRect.y || pixel.x >= clipRect.z || pixel.y >= clipRect.w) {
+		discard;
+	}
+	if (kind.x < 0.5) {
+		FragColor = color;
+	}
+	else if (kind.x < 1.5) {
+		FragColor = vec4(color.rgb, sampleTex(kind.y, texCoord).r * color.a);
+	}
+	else if (kind.x < 2.5) {
+		vec4 texcolor = sampleTex(kind.y, texCoord) * color;
+		texcolor.rgb *= color.a;
+		FragColor = texcolor;
+	}
+	else if (kind.x < 3.5) {
+		float d = sdRoundBoxCorners(texCoord - shape.xy, shape.xy + shape.w / 2.0, corner);
+		FragColor = framed(color, borderColor, d, shape.z, shape.w);
+	}
+	else if (kind.x < 4.5) {
+		float d = sdCircle(texCoord - 0.5, 0.5 + shape.w / 2.0);
+		FragColor = framed(color, borderColor, d, shape.z, shape.w);
+	}
+	else {
+		float d = sdRoundBox(texCoord - shape.xy, shape.xy + shape.w / 2.0, shape.y);
+		float a = 1.0 - smoothstep(0.0, shape.w, clamp(-d, 0.0, 1.0));
+		FragColor = mix(color, vec4(0.0), a);
+	}
+}
@@ -0,0 +1,34 @@
+#version 450
+
+in vec2 vertexPosition;
+in vec2 vertexUV;
+in vec4 vertexColor;
+in vec4 vertexBorderColor;
+in vec4 vertexShape;
+in vec4 vertexCorner;
+in vec4 vertexIds;
+uniform mat4 projectionMatrix;
+// x0, y0, x1, y1 in pixels, see KR_G2_USP_MAX_CLIP_RECTS
+uniform vec4 clipRects[64];
+out vec2 texCoord;
+out vec4 color;
+out vec4 borderColor;
+out vec4 shape;
+out vec4 corner;
+out vec2 kind;
+out vec2 pixel;
+out vec4 clipRect;
+
+void main() {
+	gl_Position = projectionMatrix * vec4(vertexPosition, -5.0, 1.0);
+	texCoord = vertexUV;
+	color = vertexColor;
+	borderColor = vertexBorderColor;
+	shape = vertexShape;
+	corner = vertexCorner;
+	// kind, texture slot and clip index are packed as normalized bytes
+	vec4 ids = floor(vertexIds * 255.0 + 0.5);
+	kind = ids.xy;
+	pixel = vertexPosition;
+	clipRect = clipRects[int(ids.z)];
+}
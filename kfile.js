@@ -8,6 +8,8 @@ platform === Platform.Android ? "android" :
 platform === Platform.iOS     ? "ios" :
 								   "unknown";
 
+// "GPU", "CPU" (software rasterizer in a window) or "HEADLESS" (software
+// rasterizer into an offscreen framebuffer, no window; for benchmarks)
 const renderer_type = "GPU";
 let project = new Project('lit');
 
@@ -22,13 +24,14 @@ if(renderer_type === "GPU"){
 	project.addIncludeDir('src/gpu');
 	project.addExclude('src/cpu/renderer.c');
 	project.addExclude('src/cpu/renderer.h');
-	project.addExclude('src/cpu/rencache.c');
-	project.addExclude('src/cpu/rencache.h');
 }
 else {
 	project.addIncludeDir('src/cpu');
 	project.addExclude('src/gpu/renderer.c');
 	project.addExclude('src/gpu/renderer.h');
+	if (renderer_type === "HEADLESS") {
+		project.addDefine('LITE_HEADLESS');
+	}
 }
 //nfd
     project.addIncludeDir("Libraries/nfd/include");
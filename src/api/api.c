@@ -2,18 +2,26 @@
 
 
 int luaopen_system(lua_State *L);
+int luaopen_buffer(lua_State *L);
 int luaopen_renderer(lua_State *L);
 int luaopen_regex(lua_State *L);
 int luaopen_process(lua_State *L);
 int luaopen_dirmonitor(lua_State* L);
+int luaopen_search(lua_State *L);
+int luaopen_scanner(lua_State *L);
+int luaopen_tokenizer(lua_State *L);
 int luaopen_utf8extra(lua_State* L);
 
 static const luaL_Reg libs[] = {
   { "system",     luaopen_system     },
+  { "buffer",     luaopen_buffer     },
   { "renderer",   luaopen_renderer   },
   // { "regex",      luaopen_regex      },
   // { "process",    luaopen_process    },
   { "dirmonitor", luaopen_dirmonitor },
+  { "search",     luaopen_search     },
+  { "scanner",    luaopen_scanner    },
+  { "tokenizer",  luaopen_tokenizer  },
   // { "utf8extra",  luaopen_utf8extra  },
   { NULL, NULL }
 };
@@ -9,6 +9,12 @@
 #define API_TYPE_PROCESS "Process"
 #define API_TYPE_DIRMONITOR "Dirmonitor"
 #define API_TYPE_NATIVE_PLUGIN "NativePlugin"
+#define API_TYPE_BUFFER "Buffer"
+#define API_TYPE_SEARCH "Search"
+#define API_TYPE_SCANNER "Scanner"
+#define API_TYPE_TOKENIZER "Tokenizer"
+#define API_TYPE_HIGHLIGHT "Highlight"
+#define API_TYPE_TOKEN_LINES "TokenLines"
 
 #define API_CONSTANT_DEFINE(L, idx, key, n) (lua_pushnumber(L, n), lua_setfield(L, idx - 1, key))
 
@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include "api.h"
+#include "piecetable.h"
+
+
+static PieceTable* checkbuffer(lua_State *L, int idx) {
+  PieceTable **pt = luaL_checkudata(L, idx, API_TYPE_BUFFER);
+  return *pt;
+}
+
+
+static void pushbuffer(lua_State *L, PieceTable *pt) {
+  PieceTable **self = lua_newuserdata(L, sizeof(PieceTable*));
+  *self = pt;
+  luaL_setmetatable(L, API_TYPE_BUFFER);
+}
+
+
+static size_t checkline(lua_State *L, int idx, PieceTable *pt) {
+  lua_Number line = luaL_checknumber(L, idx);
+  size_t count = pt_line_count(pt);
+  if (line < 1) { return 1; }
+  if (line > count) { return count; }
+  return line;
+}
+
+
+/* converts the line/col pair at `idx` into a byte offset, clamping it to the
+** document like Doc:sanitize_position() does */
+static size_t checkposition(lua_State *L, int idx, PieceTable *pt) {
+  size_t line = checkline(L, idx, pt);
+  lua_Number col = luaL_checknumber(L, idx + 1);
+  size_t len = pt_line_length(pt, line);
+  if (col < 1) { col = 1; }
+  if (col > len) { col = len; }
+  return pt_line_offset(pt, line) + (size_t) col - 1;
+}
+
+
+static void pushrange(lua_State *L, PieceTable *pt, size_t offset, size_t len) {
+  luaL_Buffer b;
+  char *dst = luaL_buffinitsize(L, &b, len);
+  pt_copy(pt, offset, len, dst);
+  luaL_pushresultsize(&b, len);
+}
+
+
+static int f_new(lua_State *L) {
+  pushbuffer(L, pt_new());
+  return 1;
+}
+
+
+static int f_load(lua_State *L) {
+  const char *filename = luaL_checkstring(L, 1);
+  bool crlf;
+  PieceTable *pt = pt_load(filename, &crlf);
+  if (!pt) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "could not open file '%s'", filename);
+    return 2;
+  }
+  pushbuffer(L, pt);
+  lua_pushboolean(L, crlf);
+  return 2;
+}
+
+
+static int f_gc(lua_State *L) {
+  PieceTable **pt = luaL_checkudata(L, 1, API_TYPE_BUFFER);
+  if (*pt) { pt_free(*pt); }
+  *pt = NULL;
+  return 0;
+}
+
+
+static int f_line_count(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  lua_pushnumber(L, pt_line_count(pt));
+  return 1;
+}
+
+
+static int f_get_line(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  lua_Number line = luaL_checknumber(L, 2);
+  if (line < 1 || line > pt_line_count(pt) || line != (size_t) line) {
+    lua_pushnil(L);
+    return 1;
+  }
+  pushrange(L, pt, pt_line_offset(pt, line), pt_line_length(pt, line));
+  return 1;
+}
+
+
+static int f_line_length(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  lua_pushnumber(L, pt_line_length(pt, checkline(L, 2, pt)));
+  return 1;
+}
+
+
+static int f_get_text(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  size_t a = checkposition(L, 2, pt);
+  size_t b = checkposition(L, 4, pt);
+  if (a > b) { size_t t = a; a = b; b = t; }
+  pushrange(L, pt, a, b - a);
+  return 1;
+}
+
+
+static int f_insert(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  size_t offset = checkposition(L, 2, pt);
+  size_t len;
+  const char *text = luaL_checklstring(L, 4, &len);
+  pt_insert(pt, offset, text, len);
+  return 0;
+}
+
+
+static int f_remove(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  size_t a = checkposition(L, 2, pt);
+  size_t b = checkposition(L, 4, pt);
+  if (a > b) { size_t t = a; a = b; b = t; }
+  pt_remove(pt, a, b - a);
+  return 0;
+}
+
+
+static int f_offset(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  lua_pushnumber(L, checkposition(L, 2, pt) + 1);
+  return 1;
+}
+
+
+static int f_position(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  lua_Number offset = luaL_checknumber(L, 2);
+  size_t len = pt_length(pt);
+  if (offset < 1) { offset = 1; }
+  if (offset > len) { offset = len; }
+  size_t line, col;
+  pt_position(pt, (size_t) offset - 1, &line, &col);
+  lua_pushnumber(L, line);
+  lua_pushnumber(L, col);
+  return 2;
+}
+
+
+static int write_fn(const char *data, size_t len, void *udata) {
+  return fwrite(data, 1, len, udata) != len;
+}
+
+
+static int write_crlf_fn(const char *data, size_t len, void *udata) {
+  const char *end = data + len;
+  const char *nl;
+  while ((nl = memchr(data, '\n', end - data))) {
+    if (fwrite(data, 1, nl - data, udata) != (size_t) (nl - data)) { return 1; }
+    if (fwrite("\r\n", 1, 2, udata) != 2) { return 1; }
+    data = nl + 1;
+  }
+  return fwrite(data, 1, end - data, udata) != (size_t) (end - data);
+}
+
+
+/* The document may be reading the file it is saved to through a mapping, so
+** it is written to a temporary file next to it that is renamed over it once
+** complete; the document is detached from the mapping before that, as the old
+** file goes away (and Windows refuses to replace a mapped file). */
+static int f_save(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  const char *filename = luaL_checkstring(L, 2);
+  int crlf = lua_toboolean(L, 3);
+  const char *target = filename;
+  struct stat s;
+  bool exists = stat(filename, &s) == 0;
+#ifndef _WIN32
+  /* replace what a symlink points to, not the link */
+  char real[PATH_MAX];
+  if (exists && realpath(filename, real)) { target = real; }
+#endif
+  const char *tmp = lua_pushfstring(L, "%s.lit_save", target);
+  FILE *fp = fopen(tmp, "wb");
+  if (!fp) {
+    lua_pushnil(L);
+    lua_pushfstring(L, "could not open file '%s' for writing", tmp);
+    return 2;
+  }
+  int err = pt_each(pt, 0, pt_length(pt), crlf ? write_crlf_fn : write_fn, fp);
+  err |= fclose(fp);
+#ifndef _WIN32
+  if (!err && exists) { chmod(tmp, s.st_mode & 07777); }
+#endif
+  if (!err) {
+    pt_detach(pt, (size_t) -1);
+#ifdef _WIN32
+    remove(target);
+#endif
+    err = rename(tmp, target);
+  }
+  if (err) {
+    remove(tmp);
+    lua_pushnil(L);
+    lua_pushfstring(L, "could not write file '%s'", filename);
+    return 2;
+  }
+  lua_pushboolean(L, 1);
+  return 1;
+}
+
+
+/* copies the file the document was loaded from into memory, as it changed;
+** returns false if it shrank and the document can't be kept */
+static int f_detach(lua_State *L) {
+  PieceTable *pt = checkbuffer(L, 1);
+  lua_Number size = luaL_checknumber(L, 2);
+  lua_pushboolean(L, pt_detach(pt, size < 0 ? 0 : (size_t) size));
+  return 1;
+}
+
+
+static const luaL_Reg lib[] = {
+  { "new",         f_new         },
+  { "load",        f_load        },
+  { "__gc",        f_gc          },
+  { "__len",       f_line_count  },
+  { "line_count",  f_line_count  },
+  { "get_line",    f_get_line    },
+  { "line_length", f_line_length },
+  { "get_text",    f_get_text    },
+  { "insert",      f_insert      },
+  { "remove",      f_remove      },
+  { "offset",      f_offset      },
+  { "position",    f_position    },
+  { "save",        f_save        },
+  { "detach",      f_detach      },
+  { NULL,          NULL          }
+};
+
+
+int luaopen_buffer(lua_State *L) {
+  luaL_newmetatable(L, API_TYPE_BUFFER);
+  luaL_setfuncs(L, lib, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  return 1;
+}
@@ -1,8 +1,11 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include "api.h"
 #include "renderer.h"
-// #include "rencache.h"
+#include "rencache.h"
+#include "tokenlines.h"
 
 
 static RenColor checkcolor(lua_State *L, int idx, int def) {
@@ -22,10 +25,9 @@ static RenColor checkcolor(lua_State *L, int idx, int def) {
   return color;
 }
 
-static int show_debug;
 static int f_show_debug(lua_State *L) {
   luaL_checkany(L, 1);
-  show_debug = lua_toboolean(L, 1);
+  rencache_show_debug(lua_toboolean(L, 1));
   return 0;
 }
 
@@ -41,29 +43,38 @@ static int f_get_size(lua_State *L) {
 
 static int f_begin_frame(lua_State *L) {
   ren_begin_frame();
+  rencache_begin_frame();
   return 0;
 }
 
 
 static int f_end_frame(lua_State *L) {
+  rencache_end_frame();
   ren_end_frame();
   return 0;
 }
 
 
+static int f_present(lua_State *L) {
+  ren_present();
+  return 0;
+}
+
+
 static int f_set_clip_rect(lua_State *L) {
   RenRect rect;
   rect.x = luaL_checknumber(L, 1);
   rect.y = luaL_checknumber(L, 2);
   rect.width = luaL_checknumber(L, 3);
   rect.height = luaL_checknumber(L, 4);
-  ren_set_clip_rect(rect);
-  // rencache_set_clip_rect(rect);
+  rencache_set_clip_rect(rect);
   return 0;
 }
 
-static void f_pop_clip_rect(lua_State* L){
-  void ren_pop_clip_rect();
+static int f_pop_clip_rect(lua_State* L){
+  RenRect rect = { 0, 0, 0, 0 };
+  ren_get_size(&rect.width, &rect.height);
+  rencache_set_clip_rect(rect);
   return 0;
 }
 
@@ -75,12 +86,7 @@ static int f_draw_rect(lua_State *L) {
   rect.width = luaL_checknumber(L, 3);
   rect.height = luaL_checknumber(L, 4);
   RenColor color = checkcolor(L, 5, 255);
-  ren_draw_rect(rect,color);
-  if (show_debug) {
-    RenColor color = { rand(), rand(), rand(), 50 };
-    ren_draw_rect(rect, color);
-  }
-  // rencache_draw_rect(rect, color);
+  rencache_draw_rect(rect, color);
   return 0;
 }
 
@@ -91,21 +97,148 @@ static int f_draw_text(lua_State *L) {
   int x = luaL_checknumber(L, 3);
   int y = luaL_checknumber(L, 4);
   RenColor color = checkcolor(L, 5, 255);
-  x = ren_draw_text(*font, text, x, y, color);
+  x = rencache_draw_text(*font, text, x, y, color);
   lua_pushnumber(L, x);
   return 1;
 }
 
 
+/* draws the tokens of a line as returned by the tokenizer ({ type, text, ... }),
+** colored by looking their types up in the colors table. With `first` and
+** `last` only those bytes of the line are drawn, starting at x; both should be
+** on character boundaries */
+static int f_draw_line(lua_State *L) {
+  RenFont **font = luaL_checkudata(L, 1, API_TYPE_FONT);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  luaL_checktype(L, 3, LUA_TTABLE);
+  int x = luaL_checknumber(L, 4);
+  int y = luaL_checknumber(L, 5);
+  lua_Number first_arg = luaL_optnumber(L, 6, 1);
+  size_t first = first_arg < 1 ? 1 : first_arg;
+  size_t last = lua_isnoneornil(L, 7) ? (size_t) -1 : luaL_checknumber(L, 7);
+  const char *texts[REN_MAX_LINE_TOKENS];
+  RenColor colors[REN_MAX_LINE_TOKENS];
+  int count = 0;
+  int n = lua_rawlen(L, 2);
+  size_t pos = 1;
+  for (int i = 1; i < n && pos <= last; i += 2) {
+    size_t len;
+    lua_rawgeti(L, 2, i + 1);
+    const char *text = luaL_checklstring(L, -1, &len);
+    size_t start = pos;
+    pos += len;
+    if (pos <= first) { lua_pop(L, 1); continue; }
+    if (start < first || pos - 1 > last) {
+      /* cut the token to the range, the copy is left on the stack until drawn */
+      size_t a = start < first ? first - start : 0;
+      size_t b = pos - 1 > last ? last - start + 1 : len;
+      text = lua_pushlstring(L, text + a, b - a);
+      lua_remove(L, -2);
+    } else {
+      /* the string stays referenced by the tokens table */
+      lua_pop(L, 1);
+    }
+    texts[count] = text;
+    lua_rawgeti(L, 2, i);
+    lua_rawget(L, 3);
+    colors[count++] = checkcolor(L, lua_gettop(L), 255);
+    lua_pop(L, 1);
+    if (count == REN_MAX_LINE_TOKENS) {
+      x = rencache_draw_line(*font, texts, colors, count, x, y);
+      count = 0;
+    }
+  }
+  if (count > 0) { x = rencache_draw_line(*font, texts, colors, count, x, y); }
+  lua_pushnumber(L, x);
+  return 1;
+}
+
+
+/* draws line `idx` of the TokenLines, cut from `text`, the text it was
+** tokenized from, like draw_line does with a tokens table. The tokens are
+** copied to a scratch buffer to end them with a NUL, no strings are made */
+static int f_draw_tokens(lua_State *L) {
+  static char *scratch;
+  static size_t scratch_size;
+  RenFont **font = luaL_checkudata(L, 1, API_TYPE_FONT);
+  TokenLines *tl = *(TokenLines**) luaL_checkudata(L, 2, API_TYPE_TOKEN_LINES);
+  int idx = luaL_checknumber(L, 3);
+  size_t len;
+  const char *line = luaL_checklstring(L, 4, &len);
+  luaL_checktype(L, 5, LUA_TTABLE);
+  int x = luaL_checknumber(L, 6);
+  int y = luaL_checknumber(L, 7);
+  lua_Number first_arg = luaL_optnumber(L, 8, 1);
+  size_t first = first_arg < 1 ? 0 : first_arg - 1;
+  size_t last = lua_isnoneornil(L, 9) ? len : luaL_checknumber(L, 9);
+  if (last > len) { last = len; }
+  int n;
+  const TokenRun *runs = tl_get(tl, idx, &n);
+  if (!runs) { n = 0; }
+  if (scratch_size < len + REN_MAX_LINE_TOKENS) {
+    scratch_size = len + REN_MAX_LINE_TOKENS;
+    scratch = realloc(scratch, scratch_size);
+  }
+  const char *texts[REN_MAX_LINE_TOKENS];
+  RenColor colors[REN_MAX_LINE_TOKENS];
+  int count = 0;
+  char *p = scratch;
+  for (int i = 0; i < n && runs[i].offset < last; i++) {
+    size_t start = runs[i].offset, end = start + runs[i].length;
+    if (end <= first) { continue; }
+    if (start < first) { start = first; }
+    if (end > last) { end = last; }
+    memcpy(p, line + start, end - start);
+    texts[count] = p;
+    p += end - start;
+    *p++ = '\0';
+    lua_getfield(L, 5, tl_type_name(tl, runs[i].type));
+    colors[count++] = checkcolor(L, lua_gettop(L), 255);
+    lua_pop(L, 1);
+    if (count == REN_MAX_LINE_TOKENS) {
+      x = rencache_draw_line(*font, texts, colors, count, x, y);
+      count = 0;
+      p = scratch;
+    }
+  }
+  if (count > 0) { x = rencache_draw_line(*font, texts, colors, count, x, y); }
+  lua_pushnumber(L, x);
+  return 1;
+}
+
+
+static int f_begin_scroll_region(lua_State *L) {
+  RenRect rect;
+  rect.x = luaL_checknumber(L, 1);
+  rect.y = luaL_checknumber(L, 2);
+  rect.width = luaL_checknumber(L, 3);
+  rect.height = luaL_checknumber(L, 4);
+  int scroll = luaL_checknumber(L, 5);
+  rencache_begin_scroll_region(rect, scroll);
+  return 0;
+}
+
+
+static int f_end_scroll_region(lua_State *L) {
+  rencache_end_scroll_region();
+  return 0;
+}
+
+
 static const luaL_Reg lib[] = {
   { "show_debug",    f_show_debug    },
   { "get_size",      f_get_size      },
   { "begin_frame",   f_begin_frame   },
   { "end_frame",     f_end_frame     },
+  { "present",       f_present       },
   { "set_clip_rect", f_set_clip_rect },
   { "pop_clip_rect", f_pop_clip_rect },
   { "draw_rect",     f_draw_rect     },
   { "draw_text",     f_draw_text     },
+  { "draw_line",     f_draw_line     },
+  { "draw_tokens",   f_draw_tokens   },
+  { "begin_scroll_region", f_begin_scroll_region },
+  { "end_scroll_region",   f_end_scroll_region   },
   { NULL,            NULL            }
 };
 
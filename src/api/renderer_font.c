@@ -1,9 +1,34 @@
+#include <stdlib.h>
 #include "api.h"
 #include "renderer.h"
-// #include "rencache.h"
+#include "rencache.h"
 
 #define FONT_FALLBACK_MAX 10
 
+/* x offsets in long lines are measured from the nearest of the pen positions
+** stored every COLUMN_INDEX_STEP bytes, so converting between columns and x
+** offsets only walks a few hundred bytes. The indexes of the last few lines
+** are kept along with a reference to their string, which keeps its pointer
+** from being reused by another one */
+#define COLUMN_INDEX_STEP 256
+#define COLUMN_INDEX_MIN_LENGTH 1024
+#define COLUMN_INDEX_CACHE_SIZE 8
+
+typedef struct {
+  const char *text;
+  size_t len;
+  RenFont *font;
+  int tab_width;
+  int ref;
+  unsigned last_used;
+  int count;
+  size_t *offsets;   /* checkpoints, each at the start of a character */
+  float *xs;         /* pen position at each checkpoint */
+} ColumnIndex;
+
+static ColumnIndex column_indexes[COLUMN_INDEX_CACHE_SIZE];
+static unsigned column_index_clock;
+
 static int font_get_options(
   lua_State *L,
   ERenFontAntialiasing *antialiasing,
@@ -126,7 +151,7 @@ static int f_copy(lua_State *L) {
   }
   for (int i = 0; i < FONT_FALLBACK_MAX && fonts[i]; ++i) {
     RenFont** font = lua_newuserdata(L, sizeof(RenFont*));
-    *font = ren_load_font(fonts[i]->path, size);//@TODO(JSN): Support antialising and stuff.
+    *font = ren_load_font(ren_get_font_path(fonts[i]), size);//@TODO(JSN): Support antialising and stuff.
     if (!*font)
       return luaL_error(L, "failed to copy font");
     luaL_setmetatable(L, API_TYPE_FONT);
@@ -145,9 +170,70 @@ static int f_set_tab_width(lua_State *L) {
 }
 
 
+static void free_column_index(lua_State *L, ColumnIndex *ci) {
+  if (!ci->text) { return; }
+  luaL_unref(L, LUA_REGISTRYINDEX, ci->ref);
+  free(ci->offsets);
+  free(ci->xs);
+  ci->text = NULL;
+}
+
+
+/* returns the index for the string at stack index `idx`, NULL for short ones */
+static ColumnIndex* get_column_index(lua_State *L, RenFont *font, int idx) {
+  size_t len;
+  const char *text = lua_tolstring(L, idx, &len);
+  if (len < COLUMN_INDEX_MIN_LENGTH) { return NULL; }
+  int tab_width = ren_get_font_tab_width(font);
+  ColumnIndex *ci = &column_indexes[0];
+  for (int i = 0; i < COLUMN_INDEX_CACHE_SIZE; i++) {
+    ColumnIndex *c = &column_indexes[i];
+    if (c->text == text && c->len == len && c->font == font && c->tab_width == tab_width) {
+      c->last_used = ++column_index_clock;
+      return c;
+    }
+    if (c->last_used < ci->last_used) { ci = c; }
+  }
+
+  /* replace the least recently used index */
+  free_column_index(L, ci);
+  ci->count = len / COLUMN_INDEX_STEP + 1;
+  ci->offsets = malloc(ci->count * sizeof(size_t));
+  ci->xs = malloc(ci->count * sizeof(float));
+  if (!ci->offsets || !ci->xs) {
+    free(ci->offsets);
+    free(ci->xs);
+    return NULL;
+  }
+  size_t offset = 0;
+  float x = 0;
+  for (int i = 0; i < ci->count; i++) {
+    size_t end = i * COLUMN_INDEX_STEP;
+    while (end < len && (text[end] & 0xc0) == 0x80) { end++; }
+    x = ren_get_font_advance(font, text + offset, end - offset, x);
+    offset = end;
+    ci->offsets[i] = offset;
+    ci->xs[i] = x;
+  }
+  lua_pushvalue(L, idx);
+  ci->ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  ci->text = text;
+  ci->len = len;
+  ci->font = font;
+  ci->tab_width = tab_width;
+  ci->last_used = ++column_index_clock;
+  return ci;
+}
+
+
 static int f_gc(lua_State *L) {
   RenFont **self = luaL_checkudata(L, 1, API_TYPE_FONT);
-  if (*self) { ren_free_font(*self); }
+  if (*self) {
+    for (int i = 0; i < COLUMN_INDEX_CACHE_SIZE; i++) {
+      if (column_indexes[i].font == *self) { free_column_index(L, &column_indexes[i]); }
+    }
+    rencache_free_font(*self);
+  }
   return 0;
 }
 
@@ -160,6 +246,65 @@ static int f_get_width(lua_State *L) {
 }
 
 
+/* returns the width of text:sub(1, col - 1) */
+static int f_get_col_x_offset(lua_State *L) {
+  RenFont **self = luaL_checkudata(L, 1, API_TYPE_FONT);
+  size_t len;
+  const char *text = luaL_checklstring(L, 2, &len);
+  lua_Number col = luaL_checknumber(L, 3);
+  size_t end = col < 1 ? 0 : col - 1 > len ? len : (size_t) col - 1;
+  ColumnIndex *ci = get_column_index(L, *self, 2);
+  size_t offset = 0;
+  float x = 0;
+  if (ci) {
+    int i = end / COLUMN_INDEX_STEP;
+    while (i > 0 && ci->offsets[i] > end) { i--; }
+    offset = ci->offsets[i];
+    x = ci->xs[i];
+  }
+  lua_pushnumber(L, (int) ren_get_font_advance(*self, text + offset, end - offset, x));
+  return 1;
+}
+
+
+/* returns the column of the character boundary closest to x */
+static int f_get_x_offset_col(lua_State *L) {
+  RenFont **self = luaL_checkudata(L, 1, API_TYPE_FONT);
+  size_t len;
+  const char *text = luaL_checklstring(L, 2, &len);
+  float x = luaL_checknumber(L, 3);
+  ColumnIndex *ci = get_column_index(L, *self, 2);
+  size_t offset = 0;
+  float xoffset = 0;
+  if (ci && ci->xs[0] < x) {
+    /* start from the last checkpoint left of x */
+    int lo = 0, hi = ci->count - 1;
+    while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (ci->xs[mid] < x) { lo = mid; } else { hi = mid - 1; }
+    }
+    offset = ci->offsets[lo];
+    xoffset = ci->xs[lo];
+  }
+
+  size_t last = offset;
+  while (offset < len) {
+    size_t next = offset + 1;
+    while (next < len && (text[next] & 0xc0) == 0x80) { next++; }
+    float w = ren_get_font_advance(*self, text + offset, next - offset, 0);
+    if (xoffset >= x) {
+      lua_pushinteger(L, (xoffset - x > w / 2 ? last : offset) + 1);
+      return 1;
+    }
+    xoffset += w;
+    last = offset;
+    offset = next;
+  }
+  lua_pushinteger(L, len);
+  return 1;
+}
+
+
 static int f_get_height(lua_State *L) {
   RenFont **self = luaL_checkudata(L, 1, API_TYPE_FONT);
   lua_pushnumber(L, ren_get_font_height(*self) );
@@ -173,6 +318,8 @@ static const luaL_Reg lib[] = {
   { "copy",          f_copy          },
   { "set_tab_width", f_set_tab_width },
   { "get_width",     f_get_width     },
+  { "get_col_x_offset", f_get_col_x_offset },
+  { "get_x_offset_col", f_get_x_offset_col },
   { "get_height",    f_get_height    },
   { NULL, NULL }
 };
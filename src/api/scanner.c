@@ -0,0 +1,813 @@
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdbool.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <kinc/threads/atomic.h>
+#include <kinc/threads/event.h>
+#include <kinc/threads/mutex.h>
+#include <kinc/threads/thread.h>
+#include "api.h"
+
+#ifdef _WIN32
+  #define PATHSEP '\\'
+#else
+  #define PATHSEP '/'
+#endif
+
+/* Project file scanner. A background thread walks the project once and keeps
+** the result as a tree of sorted directory listings; afterwards it only
+** re-reads the directories it is told about through `scanner:invalidate()`,
+** keeping the subtrees of directories that still exist. `d_type` lets
+** ignored entries be dropped without a stat call and the remaining ones are
+** stat'ed relative to their directory's descriptor.
+**
+** The tree is only ever modified by the scanner thread; it takes the mutex
+** just to splice in a freshly read listing. `scanner:poll()` copies the tree
+** in `core.project_files` order under the same mutex and builds the Lua
+** tables after releasing it, as allocating them can raise an error. Each
+** entry remembers its Lua info table, re-polling after a small change only
+** allocates tables for the entries that were re-read.
+**
+** Paths inside the tree are kept with '/' separators, which also is what
+** `config.ignore_files` patterns are written against; `poll()` hands them out
+** with PATHSEP and `invalidate()` takes them that way. */
+
+#define SCANNER_MAX_DEPTH 64
+#define SCANNER_MATCH_DEPTH 200
+
+typedef struct Entry {
+  char *name;
+  bool dir;
+  lua_Number size, modified;
+  struct Entry *children;
+  int count;
+  int ref;
+} Entry;
+
+typedef struct {
+  char *pattern;
+  size_t len;
+  bool use_path, match_dir;
+} Ignore;
+
+typedef struct {
+  char *data;
+  size_t len, cap;
+} Path;
+
+typedef struct {
+  kinc_thread_t thread;
+  kinc_mutex_t mutex;
+  kinc_event_t event;
+  volatile int quit;
+  bool running;
+  char *root;
+  Ignore *ignore;
+  int ignore_count;
+  lua_Number size_limit;
+  Entry tree;
+  bool ready;
+  int version, seen_version;
+  char **pending;
+  int pending_count, pending_cap;
+  int *dead;
+  int dead_count, dead_cap;
+} Scanner;
+
+
+/*
+** Lua pattern matching, reduced from lstrlib.c for use off the Lua thread:
+** captures match as if they weren't there and back-references never match.
+** Patterns are validated with pcall(string.match) before they get here, a
+** malformed one simply doesn't match.
+*/
+
+typedef struct {
+  const char *src_init, *src_end, *p_end;
+  int depth;
+} MatchState;
+
+
+static const char* pattern_match(MatchState *ms, const char *s, const char *p);
+
+
+static const char* class_end(MatchState *ms, const char *p) {
+  switch (*p++) {
+    case '%':
+      return p == ms->p_end ? NULL : p + 1;
+    case '[':
+      if (p < ms->p_end && *p == '^') { p++; }
+      do {
+        if (p >= ms->p_end) { return NULL; }
+        if (*(p++) == '%' && p < ms->p_end) { p++; }
+      } while (p >= ms->p_end || *p != ']');
+      return p + 1;
+    default:
+      return p;
+  }
+}
+
+
+static int match_class(int c, int cl) {
+  int res;
+  switch (tolower(cl)) {
+    case 'a': res = isalpha(c);  break;
+    case 'c': res = iscntrl(c);  break;
+    case 'd': res = isdigit(c);  break;
+    case 'g': res = isgraph(c);  break;
+    case 'l': res = islower(c);  break;
+    case 'p': res = ispunct(c);  break;
+    case 's': res = isspace(c);  break;
+    case 'u': res = isupper(c);  break;
+    case 'w': res = isalnum(c);  break;
+    case 'x': res = isxdigit(c); break;
+    case 'z': res = (c == 0);    break;
+    default: return cl == c;
+  }
+  return islower(cl) ? res : !res;
+}
+
+
+static int match_bracket_class(int c, const char *p, const char *ec) {
+  int sig = 1;
+  if (*(p + 1) == '^') {
+    sig = 0;
+    p++;
+  }
+  while (++p < ec) {
+    if (*p == '%') {
+      p++;
+      if (match_class(c, (unsigned char) *p)) { return sig; }
+    } else if (*(p + 1) == '-' && p + 2 < ec) {
+      p += 2;
+      if ((unsigned char) *(p - 2) <= c && c <= (unsigned char) *p) { return sig; }
+    } else if ((unsigned char) *p == c) {
+      return sig;
+    }
+  }
+  return !sig;
+}
+
+
+static int single_match(MatchState *ms, const char *s, const char *p, const char *ep) {
+  if (s >= ms->src_end) { return 0; }
+  int c = (unsigned char) *s;
+  switch (*p) {
+    case '.': return 1;
+    case '%': return match_class(c, (unsigned char) *(p + 1));
+    case '[': return match_bracket_class(c, p, ep - 1);
+    default:  return (unsigned char) *p == c;
+  }
+}
+
+
+static const char* match_balance(MatchState *ms, const char *s, const char *p) {
+  if (p >= ms->p_end - 1 || s >= ms->src_end || *s != *p) { return NULL; }
+  int b = *p, e = *(p + 1), cont = 1;
+  while (++s < ms->src_end) {
+    if (*s == e) {
+      if (--cont == 0) { return s + 1; }
+    } else if (*s == b) {
+      cont++;
+    }
+  }
+  return NULL;
+}
+
+
+static const char* max_expand(MatchState *ms, const char *s, const char *p, const char *ep) {
+  ptrdiff_t i = 0;
+  while (single_match(ms, s + i, p, ep)) { i++; }
+  for (; i >= 0; i--) {
+    const char *res = pattern_match(ms, s + i, ep + 1);
+    if (res) { return res; }
+  }
+  return NULL;
+}
+
+
+static const char* min_expand(MatchState *ms, const char *s, const char *p, const char *ep) {
+  for (;;) {
+    const char *res = pattern_match(ms, s, ep + 1);
+    if (res) { return res; }
+    if (!single_match(ms, s, p, ep)) { return NULL; }
+    s++;
+  }
+}
+
+
+static const char* pattern_match(MatchState *ms, const char *s, const char *p) {
+  if (ms->depth-- == 0) { return NULL; }
+  while (s && p != ms->p_end) {
+    switch (*p) {
+      case '(':
+        p += (p + 1 < ms->p_end && *(p + 1) == ')') ? 2 : 1;
+        continue;
+      case ')':
+        p++;
+        continue;
+      case '$':
+        if (p + 1 != ms->p_end) { goto dflt; }
+        s = (s == ms->src_end) ? s : NULL;
+        p++;
+        continue;
+      case '%':
+        if (p + 1 >= ms->p_end) { s = NULL; continue; }
+        switch (*(p + 1)) {
+          case 'b':
+            s = match_balance(ms, s, p + 2);
+            p += 4;
+            continue;
+          case 'f': {
+            p += 2;
+            const char *ep = (p < ms->p_end && *p == '[') ? class_end(ms, p) : NULL;
+            if (!ep) { s = NULL; continue; }
+            int previous = (s == ms->src_init) ? '\0' : (unsigned char) *(s - 1);
+            int current = (s < ms->src_end) ? (unsigned char) *s : '\0';
+            if (match_bracket_class(previous, p, ep - 1) || !match_bracket_class(current, p, ep - 1)) {
+              s = NULL;
+            }
+            p = ep;
+            continue;
+          }
+          case '0': case '1': case '2': case '3': case '4':
+          case '5': case '6': case '7': case '8': case '9':
+            s = NULL;
+            continue;
+          default:
+            goto dflt;
+        }
+      default: dflt: {
+        const char *ep = class_end(ms, p);
+        if (!ep) { s = NULL; continue; }
+        char suffix = ep < ms->p_end ? *ep : '\0';
+        if (!single_match(ms, s, p, ep)) {
+          if (suffix == '*' || suffix == '?' || suffix == '-') {
+            p = ep + 1;
+          } else {
+            s = NULL;
+          }
+          continue;
+        }
+        switch (suffix) {
+          case '?': {
+            const char *res = pattern_match(ms, s + 1, ep + 1);
+            if (res) {
+              s = res;
+              p = ms->p_end;
+            } else {
+              p = ep + 1;
+            }
+            continue;
+          }
+          case '+':
+            s = max_expand(ms, s + 1, p, ep);
+            p = ms->p_end;
+            continue;
+          case '*':
+            s = max_expand(ms, s, p, ep);
+            p = ms->p_end;
+            continue;
+          case '-':
+            s = min_expand(ms, s, p, ep);
+            p = ms->p_end;
+            continue;
+          default:
+            s++;
+            p = ep;
+            continue;
+        }
+      }
+    }
+  }
+  ms->depth++;
+  return s;
+}
+
+
+/* behaves like `string.find(text, pattern)` returning a boolean */
+static bool pattern_find(const char *text, size_t len, const char *p, size_t plen) {
+  MatchState ms = { text, text + len, p + plen, SCANNER_MATCH_DEPTH };
+  bool anchor = plen > 0 && *p == '^';
+  if (anchor) { p++; }
+  const char *s = text;
+  do {
+    ms.depth = SCANNER_MATCH_DEPTH;
+    if (pattern_match(&ms, s, p)) { return true; }
+  } while (s++ < ms.src_end && !anchor);
+  return false;
+}
+
+
+/* mirrors fileinfo_pass_filter() in core/dirwatch.lua: patterns containing a
+** '/' are tested against the project path with a leading '/', the others
+** against the basename; patterns ending in '/' or '/$' only match
+** directories. `path` is the entry's project path with the leading '/' and
+** one spare byte at the end to append the trailing '/' in */
+static bool is_ignored(Scanner *sc, char *path, size_t len, size_t name_offset, bool dir) {
+  bool ignored = false;
+  if (dir) { path[len] = '/'; }
+  for (int i = 0; i < sc->ignore_count && !ignored; i++) {
+    Ignore *ig = &sc->ignore[i];
+    if (ig->match_dir && !dir) { continue; }
+    const char *test = ig->use_path ? path : path + name_offset;
+    size_t test_len = path + len - test + (ig->match_dir ? 1 : 0);
+    ignored = pattern_find(test, test_len, ig->pattern, ig->len);
+  }
+  if (dir) { path[len] = '\0'; }
+  return ignored;
+}
+
+
+static void path_reserve(Path *path, size_t len) {
+  /* room for the terminator and the '/' is_ignored() appends */
+  if (len + 2 > path->cap) {
+    path->cap = (len + 2) * 2;
+    path->data = realloc(path->data, path->cap);
+  }
+}
+
+
+static void path_set(Path *path, const char *str) {
+  size_t len = strlen(str);
+  path_reserve(path, len);
+  memcpy(path->data, str, len + 1);
+  path->len = len;
+}
+
+
+/* appends '/' and `name`; project paths are kept with the leading '/' */
+static void path_push(Path *path, const char *name) {
+  size_t len = strlen(name);
+  path_reserve(path, path->len + len + 1);
+  path->data[path->len++] = '/';
+  memcpy(path->data + path->len, name, len + 1);
+  path->len += len;
+}
+
+
+static void path_pop(Path *path, size_t len) {
+  path->len = len;
+  path->data[len] = '\0';
+}
+
+
+/* called with the mutex held; the Lua tables of dropped entries are released
+** by the next poll() on the main thread */
+static void release_ref(Scanner *sc, int ref) {
+  if (ref == LUA_NOREF) { return; }
+  if (sc->dead_count == sc->dead_cap) {
+    sc->dead_cap = sc->dead_cap ? sc->dead_cap * 2 : 64;
+    sc->dead = realloc(sc->dead, sc->dead_cap * sizeof(int));
+  }
+  sc->dead[sc->dead_count++] = ref;
+}
+
+
+static void free_entries(Scanner *sc, Entry *entries, int count) {
+  for (int i = 0; i < count; i++) {
+    release_ref(sc, entries[i].ref);
+    free(entries[i].name);
+    free_entries(sc, entries[i].children, entries[i].count);
+  }
+  free(entries);
+}
+
+
+static int compare_entries(const void *a, const void *b) {
+  const Entry *ea = a, *eb = b;
+  if (ea->dir != eb->dir) { return ea->dir ? -1 : 1; }
+  return strcmp(ea->name, eb->name);
+}
+
+
+static Entry* find_entry(Entry *entries, int count, const char *name, bool dir) {
+  if (count == 0) { return NULL; }
+  Entry key = { (char*) name, dir };
+  return bsearch(&key, entries, count, sizeof(Entry), compare_entries);
+}
+
+
+/* reads the directory at `path` (root prefix + project path) into a sorted
+** listing. Subdirectories that appear in the `old` listing are left empty for
+** adopt() to fill in, new ones are scanned recursively. `*count` is -1 if the
+** directory couldn't be opened. */
+static Entry* scan_dir(Scanner *sc, Path *path, size_t root_len, Entry *old, int old_count, int depth, int *count, Entry *self) {
+  *count = -1;
+  DIR *dir = opendir(path->data);
+  if (!dir) { return NULL; }
+  struct stat st;
+#ifndef _WIN32
+  if (self && fstat(dirfd(dir), &st) == 0) {
+    self->size = st.st_size;
+    self->modified = st.st_mtime;
+  }
+#endif
+  Entry *entries = NULL;
+  int n = 0, cap = 0;
+  size_t len = path->len;
+  struct dirent *ent;
+  while (!sc->quit && (ent = readdir(dir))) {
+    const char *name = ent->d_name;
+    if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0) { continue; }
+    path_push(path, name);
+    int known = -1;
+#ifdef DT_DIR
+    if (ent->d_type == DT_DIR) { known = 1; }
+    else if (ent->d_type == DT_REG) { known = 0; }
+    else if (ent->d_type != DT_LNK && ent->d_type != DT_UNKNOWN) { goto next; }
+    if (known >= 0 && is_ignored(sc, path->data + root_len, path->len - root_len, len + 1 - root_len, known)) {
+      goto next;
+    }
+#endif
+#ifdef _WIN32
+    if (stat(path->data, &st) != 0) { goto next; }
+#else
+    if (known == 1) {
+      st.st_mode = S_IFDIR;
+    } else if (fstatat(dirfd(dir), name, &st, 0) != 0) {
+      goto next;
+    }
+#endif
+    bool is_dir = S_ISDIR(st.st_mode);
+    if (!is_dir && !S_ISREG(st.st_mode)) { goto next; }
+    if (known != is_dir && is_ignored(sc, path->data + root_len, path->len - root_len, len + 1 - root_len, is_dir)) {
+      goto next;
+    }
+    if (!is_dir && st.st_size >= sc->size_limit) { goto next; }
+    if (n == cap) {
+      cap = cap ? cap * 2 : 16;
+      entries = realloc(entries, cap * sizeof(Entry));
+    }
+    entries[n++] = (Entry) {
+      strdup(name), is_dir,
+      is_dir ? 0 : st.st_size, is_dir ? 0 : st.st_mtime,
+      NULL, 0, LUA_NOREF
+    };
+next:
+    path_pop(path, len);
+  }
+  closedir(dir);
+  if (n > 1) { qsort(entries, n, sizeof(Entry), compare_entries); }
+
+  for (int i = 0; i < n && !sc->quit; i++) {
+    Entry *e = &entries[i];
+    if (!e->dir || depth >= SCANNER_MAX_DEPTH || find_entry(old, old_count, e->name, true)) {
+      continue;
+    }
+    path_push(path, e->name);
+    e->children = scan_dir(sc, path, root_len, NULL, 0, depth + 1, &e->count, e);
+    if (e->count < 0) { e->count = 0; }
+    path_pop(path, len);
+  }
+  *count = n;
+  return entries;
+}
+
+
+/* called with the mutex held; moves the subtrees of directories that are
+** still there from the `old` listing into the new one, as well as the Lua
+** tables of unchanged entries */
+static void adopt(Entry *entries, int count, Entry *old, int old_count) {
+  for (int i = 0; i < count; i++) {
+    Entry *e = &entries[i];
+    Entry *prev = find_entry(old, old_count, e->name, e->dir);
+    if (!prev) { continue; }
+    if (e->dir) {
+      *e = (Entry) { e->name, true, prev->size, prev->modified, prev->children, prev->count, prev->ref };
+      prev->children = NULL;
+      prev->count = 0;
+      prev->ref = LUA_NOREF;
+    } else if (e->size == prev->size && e->modified == prev->modified) {
+      e->ref = prev->ref;
+      prev->ref = LUA_NOREF;
+    }
+  }
+}
+
+
+/* re-reads the deepest known directory along the project path `rel`, or its
+** closest ancestor that still exists */
+static void rescan(Scanner *sc, Path *path, const char *rel) {
+  size_t root_len = strlen(sc->root);
+  path_pop(path, root_len);
+  Entry *nodes[SCANNER_MAX_DEPTH + 1];
+  size_t lens[SCANNER_MAX_DEPTH + 1];
+  Entry *node = nodes[0] = &sc->tree;
+  lens[0] = root_len;
+  int depth = 0;
+  while (*rel && depth < SCANNER_MAX_DEPTH) {
+    const char *sep = strchr(rel, '/');
+    size_t n = sep ? (size_t) (sep - rel) : strlen(rel);
+    char name[256];
+    if (n == 0 || n >= sizeof(name)) { break; }
+    memcpy(name, rel, n);
+    name[n] = '\0';
+    Entry *child = find_entry(node->children, node->count, name, true);
+    if (!child) { break; }
+    path_push(path, name);
+    node = nodes[++depth] = child;
+    lens[depth] = path->len;
+    rel = sep ? sep + 1 : "";
+  }
+  int count;
+  Entry self;
+  Entry *children;
+  for (;;) {
+    node = nodes[depth];
+    self = (Entry) { NULL, true, node->size, node->modified };
+    children = scan_dir(sc, path, root_len, node->children, node->count, depth, &count, &self);
+    if (count >= 0 || depth == 0) { break; }
+    path_pop(path, lens[--depth]);
+  }
+  if (count < 0) { count = 0; }
+  kinc_mutex_lock(&sc->mutex);
+  adopt(children, count, node->children, node->count);
+  free_entries(sc, node->children, node->count);
+  node->children = children;
+  node->count = count;
+  if (node->size != self.size || node->modified != self.modified) {
+    release_ref(sc, node->ref);
+    node->ref = LUA_NOREF;
+    node->size = self.size;
+    node->modified = self.modified;
+  }
+  sc->version++;
+  kinc_mutex_unlock(&sc->mutex);
+}
+
+
+static void scanner_thread(void *data) {
+  Scanner *sc = data;
+  Path path = { NULL, 0, 0 };
+  path_set(&path, sc->root);
+
+  int count;
+  Entry *children = scan_dir(sc, &path, path.len, NULL, 0, 0, &count, NULL);
+  kinc_mutex_lock(&sc->mutex);
+  sc->tree.children = children;
+  sc->tree.count = count < 0 ? 0 : count;
+  sc->ready = true;
+  sc->version++;
+  kinc_mutex_unlock(&sc->mutex);
+
+  while (!sc->quit) {
+    kinc_event_wait(&sc->event);
+    for (;;) {
+      kinc_mutex_lock(&sc->mutex);
+      char *rel = sc->pending_count > 0 ? sc->pending[--sc->pending_count] : NULL;
+      kinc_mutex_unlock(&sc->mutex);
+      if (!rel || sc->quit) {
+        free(rel);
+        break;
+      }
+      rescan(sc, &path, rel);
+      free(rel);
+    }
+  }
+  free(path.data);
+}
+
+
+static Scanner* checkscanner(lua_State *L, int idx) {
+  return luaL_checkudata(L, idx, API_TYPE_SCANNER);
+}
+
+
+static int f_new(lua_State *L) {
+  const char *root = luaL_checkstring(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  lua_Number size_limit = luaL_checknumber(L, 3);
+  Scanner *sc = lua_newuserdata(L, sizeof(Scanner));
+  memset(sc, 0, sizeof(Scanner));
+  luaL_setmetatable(L, API_TYPE_SCANNER);
+  /* holds the info tables handed out by poll(), see push_entries() */
+  lua_newtable(L);
+  lua_setuservalue(L, -2);
+
+  sc->root = strdup(root);
+  sc->size_limit = size_limit;
+  sc->tree.ref = LUA_NOREF;
+  int count = lua_rawlen(L, 2);
+  sc->ignore = calloc(count ? count : 1, sizeof(Ignore));
+  for (int i = 0; i < count; i++) {
+    lua_rawgeti(L, 2, i + 1);
+    size_t len;
+    const char *pattern = lua_tolstring(L, -1, &len);
+    if (pattern) {
+      Ignore *ig = &sc->ignore[sc->ignore_count++];
+      ig->pattern = malloc(len + 1);
+      memcpy(ig->pattern, pattern, len + 1);
+      ig->len = len;
+      /* same tests as compile_ignore_files() in core/dirwatch.lua */
+      for (size_t j = 0; j + 1 < len && !ig->use_path; j++) {
+        ig->use_path = pattern[j] == '/' && pattern[j + 1] != '/' && pattern[j + 1] != '$';
+      }
+      ig->match_dir = (len > 1 && pattern[len - 1] == '/')
+        || (len > 2 && pattern[len - 2] == '/' && pattern[len - 1] == '$');
+    }
+    lua_pop(L, 1);
+  }
+
+  kinc_mutex_init(&sc->mutex);
+  kinc_event_init(&sc->event, true);
+  kinc_thread_init(&sc->thread, scanner_thread, sc);
+  sc->running = true;
+  return 1;
+}
+
+
+static int f_gc(lua_State *L) {
+  Scanner *sc = checkscanner(L, 1);
+  if (!sc->running) { return 0; }
+  KINC_ATOMIC_EXCHANGE_32(&sc->quit, 1);
+  kinc_event_signal(&sc->event);
+  kinc_thread_wait_and_destroy(&sc->thread);
+  kinc_event_destroy(&sc->event);
+  kinc_mutex_destroy(&sc->mutex);
+  free_entries(sc, sc->tree.children, sc->tree.count);
+  for (int i = 0; i < sc->pending_count; i++) { free(sc->pending[i]); }
+  for (int i = 0; i < sc->ignore_count; i++) { free(sc->ignore[i].pattern); }
+  free(sc->pending);
+  free(sc->ignore);
+  free(sc->dead);
+  free(sc->root);
+  sc->running = false;
+  return 0;
+}
+
+
+/* queues the directory at project path `rel` ("" for the root) for re-reading */
+static int f_invalidate(lua_State *L) {
+  Scanner *sc = checkscanner(L, 1);
+  size_t len;
+  const char *rel = luaL_checklstring(L, 2, &len);
+  if (!sc->running) { return 0; }
+  char *copy = malloc(len + 1);
+  for (size_t i = 0; i <= len; i++) {
+    copy[i] = rel[i] == PATHSEP ? '/' : rel[i];
+  }
+  kinc_mutex_lock(&sc->mutex);
+  for (int i = 0; i < sc->pending_count; i++) {
+    if (strcmp(sc->pending[i], copy) == 0) {
+      kinc_mutex_unlock(&sc->mutex);
+      free(copy);
+      return 0;
+    }
+  }
+  if (sc->pending_count == sc->pending_cap) {
+    sc->pending_cap = sc->pending_cap ? sc->pending_cap * 2 : 8;
+    sc->pending = realloc(sc->pending, sc->pending_cap * sizeof(char*));
+  }
+  sc->pending[sc->pending_count++] = copy;
+  kinc_mutex_unlock(&sc->mutex);
+  kinc_event_signal(&sc->event);
+  return 0;
+}
+
+
+/* an entry as poll() found it, copied under the mutex */
+typedef struct {
+  Entry *entry;
+  size_t name, name_len;
+  bool dir;
+  lua_Number size, modified;
+  int ref;
+  bool created;
+} SnapshotEntry;
+
+typedef struct {
+  SnapshotEntry *entries;
+  int count, cap;
+  /* the project paths of the entries with PATHSEP, no leading separator */
+  Path names;
+  int version;
+} Snapshot;
+
+
+/* called with the mutex held; appends the subtree to the snapshot */
+static void snapshot_entries(Snapshot *snap, Entry *entries, int count, Path *path) {
+  for (int i = 0; i < count; i++) {
+    Entry *e = &entries[i];
+    size_t len = path->len;
+    path_push(path, e->name);
+    if (snap->count == snap->cap) {
+      snap->cap = snap->cap ? snap->cap * 2 : 256;
+      snap->entries = realloc(snap->entries, snap->cap * sizeof(SnapshotEntry));
+    }
+    size_t name = snap->names.len;
+    path_reserve(&snap->names, name + path->len - 1);
+    /* handed out with the platform's separators, like the Lua scanner did */
+    for (size_t j = 1; j < path->len; j++) {
+      snap->names.data[name + j - 1] = path->data[j] == '/' ? PATHSEP : path->data[j];
+    }
+    snap->names.len += path->len - 1;
+    snap->entries[snap->count++] = (SnapshotEntry) {
+      e, name, path->len - 1, e->dir, e->size, e->modified, e->ref, false
+    };
+    if (e->dir) { snapshot_entries(snap, e->children, e->count, path); }
+    path_pop(path, len);
+  }
+}
+
+
+/* pushes the list of info tables of the snapshot (argument 1) for the `refs`
+** table (argument 2); tables are created once per entry and kept in `refs`,
+** so after a change only the entries the scanner re-read cost an allocation.
+** Called through lua_pcall() so the snapshot is released on errors too. */
+static int push_snapshot(lua_State *L) {
+  Snapshot *snap = lua_touserdata(L, 1);
+  lua_createtable(L, snap->count, 0);
+  for (int i = 0; i < snap->count; i++) {
+    SnapshotEntry *e = &snap->entries[i];
+    if (e->ref == LUA_NOREF) {
+      lua_createtable(L, 0, 4);
+      lua_pushlstring(L, snap->names.data + e->name, e->name_len);
+      lua_setfield(L, -2, "filename");
+      lua_pushstring(L, e->dir ? "dir" : "file");
+      lua_setfield(L, -2, "type");
+      lua_pushnumber(L, e->size);
+      lua_setfield(L, -2, "size");
+      lua_pushnumber(L, e->modified);
+      lua_setfield(L, -2, "modified");
+      lua_pushvalue(L, -1);
+      e->ref = luaL_ref(L, 2);
+      e->created = true;
+    } else {
+      lua_rawgeti(L, 2, e->ref);
+    }
+    lua_rawseti(L, -2, i + 1);
+  }
+  return 1;
+}
+
+
+/* returns the project files in core.project_files order if they changed
+** since the last call, nil otherwise */
+static int f_poll(lua_State *L) {
+  Scanner *sc = checkscanner(L, 1);
+  if (!sc->running) { return 0; }
+  lua_getuservalue(L, 1);
+  int refs = lua_gettop(L);
+  Snapshot snap = { NULL, 0, 0, { NULL, 0, 0 }, 0 };
+  kinc_mutex_lock(&sc->mutex);
+  int *dead = sc->dead;
+  int dead_count = sc->dead_count;
+  sc->dead = NULL;
+  sc->dead_count = sc->dead_cap = 0;
+  bool changed = sc->ready && sc->version != sc->seen_version;
+  if (changed) {
+    Path path = { NULL, 0, 0 };
+    path_set(&path, "");
+    snapshot_entries(&snap, sc->tree.children, sc->tree.count, &path);
+    free(path.data);
+    snap.version = sc->version;
+  }
+  kinc_mutex_unlock(&sc->mutex);
+
+  /* luaL_unref() only clears existing slots, it doesn't allocate */
+  for (int i = 0; i < dead_count; i++) { luaL_unref(L, refs, dead[i]); }
+  free(dead);
+  if (!changed) { return 0; }
+  lua_pushcfunction(L, push_snapshot);
+  lua_pushlightuserdata(L, &snap);
+  lua_pushvalue(L, refs);
+  bool ok = lua_pcall(L, 2, 1, 0) == LUA_OK;
+
+  /* the new tables go to their entries, unless the tree changed meanwhile
+  ** and the entries may be gone; the next poll() makes them again then */
+  kinc_mutex_lock(&sc->mutex);
+  if (ok) { sc->seen_version = snap.version; }
+  bool keep = ok && sc->version == snap.version;
+  for (int i = 0; keep && i < snap.count; i++) {
+    if (snap.entries[i].created) { snap.entries[i].entry->ref = snap.entries[i].ref; }
+  }
+  kinc_mutex_unlock(&sc->mutex);
+  for (int i = 0; !keep && i < snap.count; i++) {
+    if (snap.entries[i].created) { luaL_unref(L, refs, snap.entries[i].ref); }
+  }
+  free(snap.entries);
+  free(snap.names.data);
+  if (!ok) { return lua_error(L); }
+  return 1;
+}
+
+
+static const luaL_Reg lib[] = {
+  { "new",        f_new        },
+  { "__gc",       f_gc         },
+  { "invalidate", f_invalidate },
+  { "poll",       f_poll       },
+  { NULL,         NULL         }
+};
+
+
+int luaopen_scanner(lua_State *L) {
+  luaL_newmetatable(L, API_TYPE_SCANNER);
+  luaL_setfuncs(L, lib, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  return 1;
+}
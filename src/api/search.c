@@ -0,0 +1,397 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <kinc/threads/atomic.h>
+#include <kinc/threads/thread.h>
+#include "api.h"
+#include "mapfile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define SEARCH_SSE2
+#endif
+
+/* Project-wide plain text search. A pool of worker threads claims files from
+** a shared atomic counter, maps each one and scans it for the (lowercased)
+** query. The matches of a file are collected into a single batch which is
+** handed to the main thread through the worker's own single-producer ring, so
+** neither side ever takes a lock. `search:drain()` is called once per frame
+** and turns at most SEARCH_DRAIN_MAX results into Lua tables. Workers finish
+** files in any order, so drain() holds the batches back by file and passes
+** them on in the order of the file list, like the Lua search did. */
+
+#define SEARCH_MAX_WORKERS 16
+#define SEARCH_DEFAULT_WORKERS 4
+#define SEARCH_RING_SIZE 64
+#define SEARCH_MAX_LINE 256
+#define SEARCH_DRAIN_MAX 2000
+
+/* per file, set by the worker once it is done with the file */
+enum { FILE_PENDING, FILE_NO_MATCH, FILE_MATCHED };
+
+typedef struct {
+  int line, col;
+  size_t text, text_len;
+} Match;
+
+typedef struct {
+  int file;
+  int count, capacity;
+  Match *matches;
+  char *text;
+  size_t text_len, text_capacity;
+} Batch;
+
+struct search;
+
+typedef struct {
+  kinc_thread_t thread;
+  struct search *search;
+  Batch *ring[SEARCH_RING_SIZE];
+  volatile int head, tail;
+} Worker;
+
+typedef struct search {
+  char **files;
+  int file_count;
+  char *query;
+  size_t query_len;
+  volatile int next_file;
+  volatile int files_done;
+  volatile int cancelled;
+  volatile int *file_state;
+  Worker workers[SEARCH_MAX_WORKERS];
+  int worker_count;
+  /* batches taken from the rings that are not passed on yet, by file */
+  Batch **held;
+  int next_held;
+  Batch *current;
+  int current_idx;
+} Search;
+
+
+/* Kinc has no atomic load; a compare-exchange that leaves the value as it is
+** doubles as one and is a full barrier on every backend */
+static inline int atomic_load(volatile int *p) {
+  int value;
+  do {
+    value = *p;
+  } while (!KINC_ATOMIC_COMPARE_EXCHANGE(p, value, value));
+  return value;
+}
+
+
+static inline unsigned char ascii_lower(unsigned char c) {
+  return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+
+static bool match_rest(const char *p, const char *needle, size_t len) {
+  for (size_t i = 1; i < len; i++) {
+    if (ascii_lower(p[i]) != (unsigned char) needle[i]) { return false; }
+  }
+  return true;
+}
+
+
+#ifdef SEARCH_SSE2
+static inline int count_trailing_zeros(unsigned x) {
+#ifdef _MSC_VER
+  unsigned long idx;
+  _BitScanForward(&idx, x);
+  return idx;
+#else
+  return __builtin_ctz(x);
+#endif
+}
+#endif
+
+
+/* finds the first case-insensitive occurrence of the lowercase `needle`;
+** candidates are found 16 bytes at a time by comparing against both cases of
+** the first needle byte */
+static const char* find_literal(const char *p, const char *end, const char *needle, size_t len) {
+  if ((size_t) (end - p) < len) { return NULL; }
+  const char *last = end - len;
+  unsigned char lo = needle[0];
+  unsigned char up = (lo >= 'a' && lo <= 'z') ? lo - ('a' - 'A') : lo;
+#ifdef SEARCH_SSE2
+  const __m128i vlo = _mm_set1_epi8(lo);
+  const __m128i vup = _mm_set1_epi8(up);
+  for (; last - p >= 15; p += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) p);
+    unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, vlo), _mm_cmpeq_epi8(v, vup)));
+    while (mask) {
+      const char *c = p + count_trailing_zeros(mask);
+      if (match_rest(c, needle, len)) { return c; }
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; p <= last; p++) {
+    unsigned char c = *p;
+    if ((c == lo || c == up) && match_rest(p, needle, len)) { return p; }
+  }
+  return NULL;
+}
+
+
+static void batch_add(Batch **batch, int file, int line, int col, const char *text, size_t len) {
+  Batch *b = *batch;
+  if (!b) {
+    b = *batch = calloc(1, sizeof(Batch));
+    b->file = file;
+  }
+  if (len > SEARCH_MAX_LINE) { len = SEARCH_MAX_LINE; }
+  if (b->count == b->capacity) {
+    b->capacity = b->capacity ? b->capacity * 2 : 8;
+    b->matches = realloc(b->matches, b->capacity * sizeof(Match));
+  }
+  if (b->text_len + len > b->text_capacity) {
+    b->text_capacity = (b->text_len + len) * 2;
+    b->text = realloc(b->text, b->text_capacity);
+  }
+  memcpy(b->text + b->text_len, text, len);
+  b->matches[b->count++] = (Match) { line, col, b->text_len, len };
+  b->text_len += len;
+}
+
+
+static void batch_free(Batch *b) {
+  free(b->matches);
+  free(b->text);
+  free(b);
+}
+
+
+/* scans one file, returns a batch holding the first match of every matching
+** line or NULL if nothing matched */
+static Batch* search_file(Search *s, int file) {
+  char *data;
+  size_t size;
+  if (!map_file(s->files[file], &data, &size) || !data) { return NULL; }
+  Batch *batch = NULL;
+  const char *end = data + size;
+  const char *p = data, *counted = data, *line_start = data;
+  int line = 1;
+  while (!s->cancelled && (p = find_literal(p, end, s->query, s->query_len))) {
+    const char *nl;
+    while ((nl = memchr(counted, '\n', p - counted))) {
+      line++;
+      line_start = counted = nl + 1;
+    }
+    counted = p;
+    const char *line_end = memchr(p, '\n', end - p);
+    if (!line_end) { line_end = end; }
+    batch_add(&batch, file, line, p - line_start + 1, line_start, line_end - line_start);
+    p = line_end;
+  }
+  unmap_file(data, size);
+  return batch;
+}
+
+
+static bool worker_push(Worker *w, Batch *b) {
+  while (w->head - atomic_load(&w->tail) >= SEARCH_RING_SIZE) {
+    if (w->search->cancelled) { return false; }
+    kinc_thread_sleep(1);
+  }
+  w->ring[w->head % SEARCH_RING_SIZE] = b;
+  KINC_ATOMIC_INCREMENT(&w->head);
+  return true;
+}
+
+
+static void search_thread(void *data) {
+  Worker *w = data;
+  Search *s = w->search;
+  while (!s->cancelled) {
+    int idx;
+    do {
+      idx = s->next_file;
+    } while (!KINC_ATOMIC_COMPARE_EXCHANGE(&s->next_file, idx, idx + 1));
+    if (idx >= s->file_count) { break; }
+    Batch *b = search_file(s, idx);
+    if (b && !worker_push(w, b)) { batch_free(b); }
+    /* after the push, so a matched file's batch is in the ring already */
+    KINC_ATOMIC_EXCHANGE_32(&s->file_state[idx], b ? FILE_MATCHED : FILE_NO_MATCH);
+    KINC_ATOMIC_INCREMENT(&s->files_done);
+  }
+}
+
+
+static Batch* worker_pop(Worker *w) {
+  if (w->tail == atomic_load(&w->head)) { return NULL; }
+  Batch *b = w->ring[w->tail % SEARCH_RING_SIZE];
+  KINC_ATOMIC_INCREMENT(&w->tail);
+  return b;
+}
+
+
+static void search_stop(Search *s) {
+  if (!s->files) { return; }
+  KINC_ATOMIC_EXCHANGE_32(&s->cancelled, 1);
+  for (int i = 0; i < s->worker_count; i++) {
+    Worker *w = &s->workers[i];
+    kinc_thread_wait_and_destroy(&w->thread);
+    Batch *b;
+    while ((b = worker_pop(w))) { batch_free(b); }
+  }
+  if (s->current) { batch_free(s->current); }
+  for (int i = 0; i < s->file_count; i++) {
+    if (s->held[i]) { batch_free(s->held[i]); }
+    free(s->files[i]);
+  }
+  free(s->files);
+  free(s->held);
+  free((void*) s->file_state);
+  free(s->query);
+  s->files = NULL;
+  s->current = NULL;
+}
+
+
+static Search* checksearch(lua_State *L, int idx) {
+  return luaL_checkudata(L, idx, API_TYPE_SEARCH);
+}
+
+
+static int f_find(lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  size_t query_len;
+  const char *query = luaL_checklstring(L, 2, &query_len);
+  int workers = luaL_optinteger(L, 3, SEARCH_DEFAULT_WORKERS);
+  if (workers < 1) { workers = 1; }
+  if (workers > SEARCH_MAX_WORKERS) { workers = SEARCH_MAX_WORKERS; }
+  luaL_argcheck(L, query_len > 0, 2, "empty query");
+
+  Search *s = lua_newuserdata(L, sizeof(Search));
+  memset(s, 0, sizeof(Search));
+  luaL_setmetatable(L, API_TYPE_SEARCH);
+
+  int count = lua_rawlen(L, 1);
+  s->files = calloc(count ? count : 1, sizeof(char*));
+  for (int i = 0; i < count; i++) {
+    lua_rawgeti(L, 1, i + 1);
+    const char *filename = lua_tostring(L, -1);
+    s->files[i] = strdup(filename ? filename : "");
+    lua_pop(L, 1);
+  }
+  s->file_count = count;
+  s->held = calloc(count ? count : 1, sizeof(Batch*));
+  s->file_state = calloc(count ? count : 1, sizeof(int));
+  s->query = malloc(query_len + 1);
+  for (size_t i = 0; i < query_len; i++) { s->query[i] = ascii_lower(query[i]); }
+  s->query[query_len] = '\0';
+  s->query_len = query_len;
+
+  s->worker_count = workers;
+  for (int i = 0; i < workers; i++) {
+    s->workers[i].search = s;
+    kinc_thread_init(&s->workers[i].thread, search_thread, &s->workers[i]);
+  }
+  return 1;
+}
+
+
+static void push_match(lua_State *L, Search *s, Batch *b, Match *m) {
+  lua_createtable(L, 0, 4);
+  lua_pushstring(L, s->files[b->file]);
+  lua_setfield(L, -2, "file");
+  lua_pushlstring(L, b->text + m->text, m->text_len);
+  lua_setfield(L, -2, "text");
+  lua_pushnumber(L, m->line);
+  lua_setfield(L, -2, "line");
+  lua_pushnumber(L, m->col);
+  lua_setfield(L, -2, "col");
+}
+
+
+/* moves the batches in the rings to `held` */
+static void collect_batches(Search *s) {
+  for (int i = 0; i < s->worker_count; i++) {
+    Batch *b;
+    while ((b = worker_pop(&s->workers[i]))) { s->held[b->file] = b; }
+  }
+}
+
+
+/* returns the batch of the next file in the list, skipping the files without
+** matches; NULL if the next file is not done yet or all of them are */
+static Batch* next_batch(Search *s) {
+  while (s->next_held < s->file_count) {
+    int state = atomic_load(&s->file_state[s->next_held]);
+    if (state == FILE_PENDING) { return NULL; }
+    if (state == FILE_MATCHED && !s->held[s->next_held]) { collect_batches(s); }
+    Batch *b = s->held[s->next_held];
+    s->held[s->next_held++] = NULL;
+    if (b) { return b; }
+  }
+  return NULL;
+}
+
+
+/* appends up to SEARCH_DRAIN_MAX new results to the table at 2; returns
+** whether the search is still running, the number of files searched so far
+** and the number of results added */
+static int f_drain(lua_State *L) {
+  Search *s = checksearch(L, 1);
+  luaL_checktype(L, 2, LUA_TTABLE);
+  if (!s->files) {
+    lua_pushboolean(L, 0);
+    lua_pushnumber(L, 0);
+    lua_pushnumber(L, 0);
+    return 3;
+  }
+  int n = lua_rawlen(L, 2);
+  int added = 0;
+  int files_done = atomic_load(&s->files_done);
+  collect_batches(s);
+  while (added < SEARCH_DRAIN_MAX) {
+    if (!s->current) {
+      s->current = next_batch(s);
+      if (!s->current) { break; }
+      s->current_idx = 0;
+    }
+    Batch *b = s->current;
+    while (s->current_idx < b->count && added < SEARCH_DRAIN_MAX) {
+      push_match(L, s, b, &b->matches[s->current_idx++]);
+      lua_rawseti(L, 2, n + ++added);
+    }
+    if (s->current_idx == b->count) {
+      batch_free(b);
+      s->current = NULL;
+    }
+  }
+  /* a cancelled search does not get here, so every file gets done */
+  bool running = s->current || s->next_held < s->file_count;
+  if (!running) { search_stop(s); }
+  lua_pushboolean(L, running);
+  lua_pushnumber(L, files_done);
+  lua_pushnumber(L, added);
+  return 3;
+}
+
+
+static int f_cancel(lua_State *L) {
+  search_stop(checksearch(L, 1));
+  return 0;
+}
+
+
+static const luaL_Reg lib[] = {
+  { "find",   f_find   },
+  { "drain",  f_drain  },
+  { "cancel", f_cancel },
+  { "__gc",   f_cancel },
+  { NULL,     NULL     }
+};
+
+
+int luaopen_search(lua_State *L) {
+  luaL_newmetatable(L, API_TYPE_SEARCH);
+  luaL_setfuncs(L, lib, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  return 1;
+}
@@ -13,8 +13,14 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include "api.h"
+#include "luaalloc.h"
+#include "bytecache.h"
+#include "luagc.h"
 #include "utfconv.h"
 #include "nfd.h"
+#ifdef LITE_HEADLESS
+#include "renderer.h"
+#endif
 #ifdef _WIN32
   #include <windows.h>
 #else
@@ -684,6 +690,7 @@ top:
 #include <unistd.h> // for usleep
 #endif
 
+#ifndef LITE_HEADLESS
 static int sleep_ms(int milliseconds){ // cross-platform sleep function
 #ifdef WIN32
     return Sleep(milliseconds);
@@ -698,10 +705,18 @@ static int sleep_ms(int milliseconds){ // cross-platform sleep function
     return usleep((milliseconds % 1000) * 1000);
 #endif
 }
+#endif
 
+/* headless frames run back to back, there are no events to wait for and
+** nothing to pace */
 static int f_wait_event(lua_State *L) {
   double n = luaL_checknumber(L, 1);
+#ifdef LITE_HEADLESS
+  (void) n;
+  lua_pushboolean(L, 0);
+#else
   lua_pushboolean(L, sleep_ms(n * 1000));
+#endif
   return 1;
 }
 
@@ -725,14 +740,20 @@ static const int cursor_enums[] = {
 static int f_set_cursor(lua_State *L) {
   int opt = luaL_checkoption(L, 1, "arrow", cursor_opts);
   int n = cursor_enums[opt];
+#ifndef LITE_HEADLESS
   kinc_mouse_set_cursor(n);
+#endif
+  (void) n;
   return 0;
 }
 
 
 static int f_set_window_title(lua_State *L) {
   const char *title = luaL_checkstring(L, 1);
+#ifndef LITE_HEADLESS
   kinc_window_set_title(0, title);
+#endif
+  (void) title;
   return 0;
 }
 
@@ -742,7 +763,9 @@ enum { WIN_NORMAL, WIN_MAXIMIZED, WIN_FULLSCREEN };
 
 static int f_set_window_mode(lua_State *L) {
   int n = luaL_checkoption(L, 1, "normal", window_opts);
-  
+#ifdef LITE_HEADLESS
+  return 0;
+#endif
   if (n == WIN_NORMAL) { kinc_window_change_mode(0,KINC_WINDOW_MODE_WINDOW); }
   if (n == WIN_MAXIMIZED || n == WIN_FULLSCREEN) {
     #ifdef _WIN32
@@ -756,6 +779,10 @@ static int f_set_window_mode(lua_State *L) {
 }
 
 static int f_get_window_mode(lua_State *L) {
+#ifdef LITE_HEADLESS
+  lua_pushstring(L, "normal");
+  return 1;
+#endif
   kinc_window_mode_t mode = kinc_window_get_mode(0);
   if (mode == KINC_WINDOW_MODE_FULLSCREEN) {
     lua_pushstring(L, "fullscreen");
@@ -771,6 +798,9 @@ static int f_get_window_mode(lua_State *L) {
 
 static int f_set_window_bordered(lua_State *L) {
   int bordered = lua_toboolean(L, 1);
+#ifdef LITE_HEADLESS
+  return 0;
+#endif
   if(bordered){
     kinc_window_change_features(0,KINC_WINDOW_FEATURE_MINIMIZABLE | KINC_WINDOW_FEATURE_RESIZEABLE | KINC_WINDOW_FEATURE_MAXIMIZABLE);
   }
@@ -782,10 +812,15 @@ static int f_set_window_bordered(lua_State *L) {
 
 static int f_get_window_size(lua_State *L) {
   int x, y, w, h;
+#ifdef LITE_HEADLESS
+  x = y = 0;
+  ren_get_size(&w, &h);
+#else
   x = kinc_window_x(0);
   y = kinc_window_y(0);
   w = kinc_window_width(0);
   h = kinc_window_height(0);
+#endif
   lua_pushinteger(L, w);
   lua_pushinteger(L, h);
   lua_pushinteger(L, x);
@@ -802,8 +837,10 @@ static int f_set_window_size(lua_State *L) {
   // SDL_SetWindowSize(window_renderer.window, w, h);
   // SDL_SetWindowPosition(window_renderer.window, x, y);
   // ren_resize_window(&window_renderer);
+#ifndef LITE_HEADLESS
   kinc_window_resize(0,w,h);
   kinc_window_move(0,x,y);
+#endif
   return 0;
 }
 
@@ -976,6 +1013,14 @@ static int f_get_file_info(lua_State *L) {
   return 1;
 }
 
+/* loads a Lua file like `loadfile`, through the bytecode cache in the
+** directory given, see bytecache.c */
+static int f_load_cached(lua_State *L) {
+  const char *filename = luaL_checkstring(L, 1);
+  const char *dir = luaL_checkstring(L, 2);
+  return bytecache_load(L, filename, dir);
+}
+
 #if __linux__
 // https://man7.org/linux/man-pages/man2/statfs.2.html
 
@@ -1037,7 +1082,10 @@ static int f_get_clipboard(lua_State *L) {
 
 static int f_set_clipboard(lua_State *L) {
   const char *text = luaL_checkstring(L,1);
+#ifndef LITE_HEADLESS
   kinc_copy_to_clipboard(text);
+#endif
+  (void) text;
   return 0;
 }
 
@@ -1057,9 +1105,99 @@ static int f_get_time(lua_State *L) {
 }
 
 
+/* time spent in the Lua part of the last frame, recorded by main.c */
+static double frame_time = 0.0;
+static double frame_time_total = 0.0;
+static unsigned frame_count = 0;
+
+void system_record_frame_time(double seconds) {
+  frame_time = seconds;
+  frame_time_total += seconds;
+  frame_count++;
+}
+
+static int f_get_frame_time(lua_State *L) {
+  lua_pushnumber(L, frame_time);
+  lua_pushnumber(L, frame_count ? frame_time_total / frame_count : 0.0);
+  lua_pushinteger(L, frame_count);
+  return 3;
+}
+
+
+/* counters of the Lua allocator, see luaalloc.c; only classes that have been
+** used are listed */
+static int f_get_memory_stats(lua_State *L) {
+  LuaAllocStats stats;
+  luaalloc_get_stats(&stats);
+  lua_createtable(L, 0, 4);
+  lua_pushnumber(L, stats.slabs);
+  lua_setfield(L, -2, "slabs");
+  lua_pushnumber(L, stats.large_blocks);
+  lua_setfield(L, -2, "large_blocks");
+  lua_pushnumber(L, stats.large_bytes);
+  lua_setfield(L, -2, "large_bytes");
+  lua_newtable(L);
+  int n = 0;
+  for (int i = 0; i < LUAALLOC_CLASSES; i++) {
+    LuaAllocClass *c = &stats.classes[i];
+    if (c->allocs == 0) { continue; }
+    lua_createtable(L, 0, 4);
+    lua_pushnumber(L, c->size);
+    lua_setfield(L, -2, "size");
+    lua_pushnumber(L, c->used);
+    lua_setfield(L, -2, "used");
+    lua_pushnumber(L, c->free);
+    lua_setfield(L, -2, "free");
+    lua_pushnumber(L, c->allocs);
+    lua_setfield(L, -2, "allocs");
+    lua_rawseti(L, -2, ++n);
+  }
+  lua_setfield(L, -2, "classes");
+  return 1;
+}
+
+
+/* runs the Lua collector in the time left of a frame, see luagc.c */
+static int f_step_gc(lua_State *L) {
+  luagc_step(L, luaL_checknumber(L, 1));
+  return 0;
+}
+
+
+static int f_get_gc_stats(lua_State *L) {
+  LuaGCStats stats;
+  luagc_get_stats(&stats);
+  lua_createtable(L, 0, 10);
+  lua_pushstring(L, stats.generational ? "generational" : "incremental");
+  lua_setfield(L, -2, "mode");
+  lua_pushnumber(L, stats.pause);
+  lua_setfield(L, -2, "pause");
+  lua_pushnumber(L, stats.max_pause);
+  lua_setfield(L, -2, "max_pause");
+  lua_pushnumber(L, stats.total);
+  lua_setfield(L, -2, "total");
+  lua_pushnumber(L, stats.alloc_rate);
+  lua_setfield(L, -2, "alloc_rate");
+  lua_pushnumber(L, stats.steps);
+  lua_setfield(L, -2, "steps");
+  lua_pushnumber(L, stats.cycles);
+  lua_setfield(L, -2, "cycles");
+  lua_pushnumber(L, stats.backstop);
+  lua_setfield(L, -2, "backstop");
+  lua_pushnumber(L, stats.minor);
+  lua_setfield(L, -2, "minor");
+  lua_pushnumber(L, stats.switches);
+  lua_setfield(L, -2, "switches");
+  return 1;
+}
+
+
 static int f_sleep(lua_State *L) {
   double n = luaL_checknumber(L, 1);
+#ifndef LITE_HEADLESS
   sleep_ms(n * 1000);
+#endif
+  (void) n;
   return 0;
 }
 
@@ -1187,10 +1325,15 @@ static const luaL_Reg lib[] = {
   { "list_dir",            f_list_dir            },
   { "absolute_path",       f_absolute_path       },
   { "get_file_info",       f_get_file_info       },
+  { "load_cached",         f_load_cached         },
   { "get_clipboard",       f_get_clipboard       },
   { "set_clipboard",       f_set_clipboard       },
   { "get_process_id",      f_get_process_id      },
   { "get_time",            f_get_time            },
+  { "get_frame_time",      f_get_frame_time      },
+  { "get_memory_stats",    f_get_memory_stats    },
+  { "step_gc",             f_step_gc             },
+  { "get_gc_stats",        f_get_gc_stats        },
   { "sleep",               f_sleep               },
   { "exec",                f_exec                },
   { "fuzzy_match",         f_fuzzy_match         },
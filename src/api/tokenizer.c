@@ -0,0 +1,734 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <kinc/threads/atomic.h>
+#include <kinc/threads/thread.h>
+#include "api.h"
+#include "tokenizer.h"
+#include "tokenlines.h"
+#include "piecetable.h"
+
+/* Lua interface of the native tokenizer: `tokenizer.compile(syntax)` turns a
+** table passed to `syntax.add` into a Tokenizer, whose `tokenize` method
+** returns the same alternating type/text table and end state as the Lua
+** `tokenizer.tokenize`. Syntax states are the 1-based pattern indices in both,
+** so lines tokenized by either one can follow each other.
+**
+** `tokenizer.lines()` makes the TokenLines a highlighter keeps its lines in.
+** They are read through the store instead of as tables: `each_token` and
+** `renderer.draw_tokens` only make strings of the tokens they are asked for.
+** For lines of LINES_KNOWN_MIN_LENGTH bytes or more the store also references
+** the string a line was last seen as, so `matches` only hashes such a line
+** when it is given another string; the reference keeps the pointer from being
+** reused by another one.
+**
+** `Tokenizer:highlight(buffer, line, state)` tokenizes a whole document from
+** `line` on worker threads. The text is copied from the buffer up front and
+** split into chunks of HIGHLIGHT_CHUNK_LINES lines. Every chunk but the first
+** is tokenized as if no pair was open at its start; `poll` accepts the chunks
+** in order on the main thread and, when the state carried over from the
+** previous chunk differs, re-tokenizes the first lines of the chunk until the
+** states agree again, or hands the chunk back to the workers if they do not
+** within HIGHLIGHT_RECONCILE_LINES lines. Workers and the main thread only
+** hand chunks over through their atomic status, so neither side blocks.
+** Accepted lines go straight into the TokenLines given to `poll`. */
+
+#define HIGHLIGHT_WORKERS 4
+#define HIGHLIGHT_CHUNK_LINES 1024
+#define HIGHLIGHT_RECONCILE_LINES 32
+#define LINES_KNOWN_MIN_LENGTH 1024
+
+enum { CHUNK_PENDING, CHUNK_RUNNING, CHUNK_DONE };
+
+typedef struct {
+  size_t offset, length;
+  uint64_t hash;
+  int first, count;
+  int init_state, state;
+} Line;
+
+typedef struct {
+  volatile int status;
+  int start_state, end_state;
+  int first_line, line_count;
+  size_t offset, end;
+  Line *lines;
+  Token *tokens;
+  int token_count, token_capacity;
+} Chunk;
+
+typedef struct {
+  Tokenizer *tk;
+  char *text;
+  int first_line, line_count, start_state;
+  Chunk *chunks;
+  int chunk_count;
+  /* main thread only: chunks accepted so far, the lines they hold and how
+  ** many of those were stored */
+  int ready_chunks, ready_lines, stored_lines;
+  /* lines from `limit` on were edited since, they are not worth tokenizing */
+  volatile int limit;
+  volatile int finished, cancelled, workers_done;
+  kinc_thread_t threads[HIGHLIGHT_WORKERS];
+  int thread_count;
+  bool joined;
+} Highlight;
+
+static TokenList tokens;
+
+
+/* see search.c */
+static inline int atomic_load(volatile int *p) {
+  int value;
+  do {
+    value = *p;
+  } while (!KINC_ATOMIC_COMPARE_EXCHANGE(p, value, value));
+  return value;
+}
+
+
+static Tokenizer* checktokenizer(lua_State *L, int idx) {
+  Tokenizer **tk = luaL_checkudata(L, idx, API_TYPE_TOKENIZER);
+  return *tk;
+}
+
+
+static int checktype(lua_State *L, Tokenizer *tk, int idx) {
+  if (lua_type(L, idx) != LUA_TSTRING) { return -1; }
+  return tk_add_type(tk, lua_tostring(L, idx));
+}
+
+
+/* compiles the patterns and symbols of the syntax table at `idx`; returns an
+** error message (left on the stack) or NULL */
+static const char* compile_syntax(lua_State *L, int idx, Tokenizer *tk) {
+  lua_getfield(L, idx, "patterns");
+  int n = lua_istable(L, -1) ? lua_rawlen(L, -1) : 0;
+  for (int i = 1; i <= n; i++) {
+    lua_rawgeti(L, -1, i);
+    lua_getfield(L, -1, "type");
+    int type = checktype(L, tk, -1);
+    lua_pop(L, 1);
+    if (type < 0) {
+      return lua_pushfstring(L, "pattern %d has no type", i);
+    }
+    lua_getfield(L, -1, "pattern");
+    const char *start, *end = NULL, *err;
+    size_t start_len, end_len = 0;
+    int escape = -1;
+    if (lua_istable(L, -1)) {
+      lua_rawgeti(L, -1, 1);
+      lua_rawgeti(L, -2, 2);
+      lua_rawgeti(L, -3, 3);
+      start = lua_tolstring(L, -3, &start_len);
+      end = lua_tolstring(L, -2, &end_len);
+      if (lua_isstring(L, -1) && lua_rawlen(L, -1) > 0) {
+        escape = (unsigned char) *lua_tostring(L, -1);
+      }
+      if (!start || !end) {
+        return lua_pushfstring(L, "pattern %d is not a start/end pair of strings", i);
+      }
+      err = tk_add_pattern(tk, start, start_len, end, end_len, escape, type);
+      lua_pop(L, 3);
+    } else {
+      start = lua_tolstring(L, -1, &start_len);
+      if (!start) { return lua_pushfstring(L, "pattern %d is not a string", i); }
+      err = tk_add_pattern(tk, start, start_len, NULL, 0, -1, type);
+    }
+    if (err) { return lua_pushfstring(L, "pattern %d: %s", i, err); }
+    lua_pop(L, 2);
+  }
+  lua_pop(L, 1);
+
+  lua_getfield(L, idx, "symbols");
+  if (lua_istable(L, -1)) {
+    lua_pushnil(L);
+    while (lua_next(L, -2)) {
+      int type = checktype(L, tk, -1);
+      if (type >= 0 && lua_type(L, -2) == LUA_TSTRING) {
+        size_t len;
+        const char *text = lua_tolstring(L, -2, &len);
+        tk_add_symbol(tk, text, len, type);
+      }
+      lua_pop(L, 1);
+    }
+  }
+  lua_pop(L, 1);
+
+  tk_finish(tk);
+  return NULL;
+}
+
+
+static int f_compile(lua_State *L) {
+  luaL_checktype(L, 1, LUA_TTABLE);
+  Tokenizer **self = lua_newuserdata(L, sizeof(Tokenizer*));
+  *self = tk_new();
+  luaL_setmetatable(L, API_TYPE_TOKENIZER);
+  const char *err = compile_syntax(L, 1, *self);
+  if (err) {
+    lua_pushnil(L);
+    lua_pushstring(L, err);
+    return 2;
+  }
+  return 1;
+}
+
+
+static int f_gc(lua_State *L) {
+  Tokenizer **tk = luaL_checkudata(L, 1, API_TYPE_TOKENIZER);
+  if (*tk) { tk_free(*tk); }
+  *tk = NULL;
+  return 0;
+}
+
+
+static void push_tokens(lua_State *L, Tokenizer *tk, const char *text, const Token *t, int count) {
+  lua_createtable(L, count * 2, 0);
+  for (int i = 0; i < count; i++) {
+    lua_pushstring(L, tk_type_name(tk, t[i].type));
+    lua_rawseti(L, -2, i * 2 + 1);
+    lua_pushlstring(L, text + t[i].offset, t[i].length);
+    lua_rawseti(L, -2, i * 2 + 2);
+  }
+}
+
+
+static void push_state(lua_State *L, int state) {
+  if (state) {
+    lua_pushinteger(L, state);
+  } else {
+    lua_pushnil(L);
+  }
+}
+
+
+/* no state is nil, or false as the highlighter passes for the first line */
+static int optstate(lua_State *L, int idx) {
+  return lua_toboolean(L, idx) ? luaL_checkint(L, idx) : 0;
+}
+
+
+static int f_tokenize(lua_State *L) {
+  Tokenizer *tk = checktokenizer(L, 1);
+  size_t len;
+  const char *text = luaL_checklstring(L, 2, &len);
+  int state = optstate(L, 3);
+  state = tk_tokenize(tk, text, len, state, &tokens);
+  push_tokens(L, tk, text, tokens.tokens, tokens.count);
+  push_state(L, state);
+  return 2;
+}
+
+
+/*
+** Token lines
+*/
+
+static TokenLines* checklines(lua_State *L, int idx) {
+  TokenLines **tl = luaL_checkudata(L, idx, API_TYPE_TOKEN_LINES);
+  return *tl;
+}
+
+
+/* the TokenLines recognize the tokenizer they map types of by its address, so
+** they keep the last one alive */
+static void lines_keep(lua_State *L, int idx, int tk_idx) {
+  lua_getuservalue(L, idx);
+  lua_pushvalue(L, tk_idx);
+  lua_rawseti(L, -2, 1);
+  lua_pop(L, 1);
+}
+
+
+/* pushes the table of strings the long lines were last seen as */
+static void lines_known(lua_State *L, int idx) {
+  lua_getuservalue(L, idx);
+  lua_rawgeti(L, -1, 2);
+  lua_remove(L, -2);
+}
+
+
+/* forgets the string of line `line` in the table on top of the stack; setting
+** absent keys to nil would still add them */
+static void lines_forget(lua_State *L, int line) {
+  lua_rawgeti(L, -1, line);
+  bool known = !lua_isnil(L, -1);
+  lua_pop(L, 1);
+  if (known) {
+    lua_pushnil(L);
+    lua_rawseti(L, -2, line);
+  }
+}
+
+
+/* remembers the string at `text_idx` as the text of line `line` */
+static void lines_remember(lua_State *L, int idx, int line, int text_idx) {
+  lines_known(L, idx);
+  if (lua_rawlen(L, text_idx) >= LINES_KNOWN_MIN_LENGTH) {
+    lua_pushvalue(L, text_idx);
+    lua_rawseti(L, -2, line);
+  } else {
+    lines_forget(L, line);
+  }
+  lua_pop(L, 1);
+}
+
+
+static int f_lines(lua_State *L) {
+  TokenLines **self = lua_newuserdata(L, sizeof(TokenLines*));
+  *self = tl_new();
+  luaL_setmetatable(L, API_TYPE_TOKEN_LINES);
+  lua_createtable(L, 2, 0);
+  lua_newtable(L);
+  lua_rawseti(L, -2, 2);
+  lua_setuservalue(L, -2);
+  return 1;
+}
+
+
+static int f_lines_gc(lua_State *L) {
+  TokenLines **tl = luaL_checkudata(L, 1, API_TYPE_TOKEN_LINES);
+  if (*tl) { tl_free(*tl); }
+  *tl = NULL;
+  return 0;
+}
+
+
+/* tokenizes `text` as line `idx` with the tokenizer; returns the end state */
+static int f_lines_tokenize(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int idx = luaL_checknumber(L, 2);
+  Tokenizer *tk = checktokenizer(L, 3);
+  size_t len;
+  const char *text = luaL_checklstring(L, 4, &len);
+  int init_state = optstate(L, 5);
+  int state = tk_tokenize(tk, text, len, init_state, &tokens);
+  lines_keep(L, 1, 3);
+  lines_remember(L, 1, idx, 4);
+  tl_set(tl, idx, tk, tokens.tokens, tokens.count, init_state, state, tl_hash(text, len), len);
+  push_state(L, state);
+  return 1;
+}
+
+
+/* stores the tokens of line `idx` as returned by the Lua tokenizer */
+static int f_lines_set(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int idx = luaL_checknumber(L, 2);
+  luaL_checktype(L, 3, LUA_TTABLE);
+  int init_state = optstate(L, 4);
+  int state = optstate(L, 5);
+  size_t len;
+  const char *text = luaL_checklstring(L, 6, &len);
+  int n = lua_rawlen(L, 3) / 2;
+  if (n > tokens.capacity) {
+    tokens.capacity = n;
+    tokens.tokens = realloc(tokens.tokens, n * sizeof(Token));
+  }
+  size_t offset = 0;
+  for (int i = 0; i < n; i++) {
+    lua_rawgeti(L, 3, i * 2 + 1);
+    lua_rawgeti(L, 3, i * 2 + 2);
+    Token *t = &tokens.tokens[i];
+    t->type = tl_add_type(tl, luaL_checkstring(L, -2));
+    t->offset = offset;
+    t->length = lua_rawlen(L, -1);
+    offset += t->length;
+    lua_pop(L, 2);
+  }
+  lines_remember(L, 1, idx, 6);
+  tl_set(tl, idx, NULL, tokens.tokens, n, init_state, state, tl_hash(text, len), len);
+  return 0;
+}
+
+
+/* whether line `idx` was tokenized from `text` */
+static int f_lines_matches(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int idx = luaL_checknumber(L, 2);
+  size_t len;
+  const char *text = luaL_checklstring(L, 3, &len);
+  if (len >= LINES_KNOWN_MIN_LENGTH) {
+    lines_known(L, 1);
+    lua_rawgeti(L, -1, idx);
+    bool known = lua_tostring(L, -1) == text;
+    lua_pop(L, 2);
+    if (known) {
+      lua_pushboolean(L, 1);
+      return 1;
+    }
+  }
+  bool matches = tl_matches(tl, idx, tl_hash(text, len), len);
+  if (matches) { lines_remember(L, 1, idx, 3); }
+  lua_pushboolean(L, matches);
+  return 1;
+}
+
+
+/* returns the state line `idx` ends in, nil for none or a line not stored */
+static int f_lines_get_state(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int init_state, state;
+  if (!tl_states(tl, luaL_checknumber(L, 2), &init_state, &state)) { state = 0; }
+  push_state(L, state);
+  return 1;
+}
+
+
+/* returns the state line `idx` was tokenized from, or false if it is not
+** stored; a nil state never equals it */
+static int f_lines_get_init_state(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int init_state, state;
+  if (tl_states(tl, luaL_checknumber(L, 2), &init_state, &state)) {
+    push_state(L, init_state);
+  } else {
+    lua_pushboolean(L, 0);
+  }
+  return 1;
+}
+
+
+/* the runs of line `idx` that lie within `len` bytes of text */
+static const TokenRun* get_runs(TokenLines *tl, int idx, size_t len, int *count) {
+  const TokenRun *runs = tl_get(tl, idx, count);
+  if (!runs) { return NULL; }
+  while (*count > 0 && runs[*count - 1].offset + runs[*count - 1].length > len) { (*count)--; }
+  return runs;
+}
+
+
+/* returns the type/text table of line `idx` cut from `text`, the text it was
+** tokenized from, or nil if it is not stored */
+static int f_lines_get_tokens(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int idx = luaL_checknumber(L, 2);
+  size_t len;
+  const char *text = luaL_checklstring(L, 3, &len);
+  int count;
+  const TokenRun *runs = get_runs(tl, idx, len, &count);
+  if (!runs) { return 0; }
+  lua_createtable(L, count * 2, 0);
+  for (int i = 0; i < count; i++) {
+    lua_pushstring(L, tl_type_name(tl, runs[i].type));
+    lua_rawseti(L, -2, i * 2 + 1);
+    lua_pushlstring(L, text + runs[i].offset, runs[i].length);
+    lua_rawseti(L, -2, i * 2 + 2);
+  }
+  return 1;
+}
+
+
+static int each_token_iter(lua_State *L) {
+  TokenLines *tl = checklines(L, 1);
+  int i = luaL_checkint(L, 2) + 2;
+  size_t len;
+  const char *text = lua_tolstring(L, lua_upvalueindex(1), &len);
+  int count;
+  const TokenRun *runs = get_runs(tl, lua_tointeger(L, lua_upvalueindex(2)), len, &count);
+  int k = (i - 1) / 2;
+  if (!runs || k >= count) { return 0; }
+  lua_pushinteger(L, i);
+  lua_pushstring(L, tl_type_name(tl, runs[k].type));
+  lua_pushlstring(L, text + runs[k].offset, runs[k].length);
+  return 3;
+}
+
+
+/* iterates over the tokens of line `idx` like `tokenizer.each_token` does
+** over a table, making the strings of a token only when it is reached */
+static int f_lines_each_token(lua_State *L) {
+  checklines(L, 1);
+  luaL_checknumber(L, 2);
+  luaL_checkstring(L, 3);
+  lua_pushvalue(L, 3);
+  lua_pushvalue(L, 2);
+  lua_pushcclosure(L, each_token_iter, 2);
+  lua_pushvalue(L, 1);
+  lua_pushinteger(L, -1);
+  return 3;
+}
+
+
+/*
+** Background highlighting
+*/
+
+static void chunk_add_line(Chunk *c, Line *line, const TokenList *list) {
+  if (c->token_count + list->count > c->token_capacity) {
+    c->token_capacity = (c->token_count + list->count) * 2;
+    c->tokens = realloc(c->tokens, c->token_capacity * sizeof(Token));
+  }
+  memcpy(c->tokens + c->token_count, list->tokens, list->count * sizeof(Token));
+  line->first = c->token_count;
+  line->count = list->count;
+  c->token_count += list->count;
+}
+
+
+static void tokenize_chunk(Highlight *h, Chunk *c, TokenList *list) {
+  const char *p = h->text + c->offset, *end = h->text + c->end;
+  int state = c->start_state;
+  c->token_count = 0;
+  for (int i = 0; i < c->line_count && !h->cancelled; i++) {
+    const char *nl = memchr(p, '\n', end - p);
+    Line *line = &c->lines[i];
+    line->offset = p - h->text;
+    line->length = nl ? nl - p + 1 : end - p;
+    line->hash = tl_hash(p, line->length);
+    line->init_state = state;
+    state = tk_tokenize(h->tk, p, line->length, state, list);
+    chunk_add_line(c, line, list);
+    line->state = state;
+    p += line->length;
+  }
+  c->end_state = state;
+}
+
+
+static void highlight_thread(void *data) {
+  Highlight *h = data;
+  TokenList list = { 0 };
+  while (!h->cancelled) {
+    Chunk *c = NULL;
+    for (int i = 0; i < h->chunk_count && !c; i++) {
+      if (h->chunks[i].status == CHUNK_PENDING &&
+          KINC_ATOMIC_COMPARE_EXCHANGE(&h->chunks[i].status, CHUNK_PENDING, CHUNK_RUNNING)) {
+        c = &h->chunks[i];
+      }
+    }
+    if (!c) {
+      if (atomic_load(&h->finished)) { break; }
+      kinc_thread_sleep(1);
+      continue;
+    }
+    if (c->first_line < atomic_load(&h->limit)) { tokenize_chunk(h, c, &list); }
+    /* a compare-exchange, unlike an exchange, publishes the chunk on every backend */
+    KINC_ATOMIC_COMPARE_EXCHANGE(&c->status, CHUNK_RUNNING, CHUNK_DONE);
+  }
+  tk_list_free(&list);
+  KINC_ATOMIC_INCREMENT(&h->workers_done);
+}
+
+
+/* re-tokenizes the lines of a chunk that was tokenized from the wrong state
+** until they agree with what the workers found; returns false if they do not
+** within HIGHLIGHT_RECONCILE_LINES lines */
+static bool reconcile(Highlight *h, Chunk *c, int state) {
+  int i;
+  for (i = 0; i < c->line_count && c->lines[i].init_state != state; i++) {
+    if (i == HIGHLIGHT_RECONCILE_LINES) { return false; }
+    Line *line = &c->lines[i];
+    line->init_state = state;
+    state = tk_tokenize(h->tk, h->text + line->offset, line->length, state, &tokens);
+    chunk_add_line(c, line, &tokens);
+    line->state = state;
+  }
+  if (i == c->line_count) { c->end_state = state; }
+  return true;
+}
+
+
+static void highlight_stop(Highlight *h) {
+  if (!h->text) { return; }
+  KINC_ATOMIC_EXCHANGE_32(&h->cancelled, 1);
+  if (!h->joined) {
+    for (int i = 0; i < h->thread_count; i++) { kinc_thread_wait_and_destroy(&h->threads[i]); }
+  }
+  for (int i = 0; i < h->chunk_count; i++) {
+    free(h->chunks[i].lines);
+    free(h->chunks[i].tokens);
+  }
+  free(h->chunks);
+  free(h->text);
+  h->text = NULL;
+  h->chunks = NULL;
+  h->chunk_count = h->ready_chunks = h->ready_lines = h->stored_lines = 0;
+}
+
+
+static Highlight* checkhighlight(lua_State *L, int idx) {
+  return luaL_checkudata(L, idx, API_TYPE_HIGHLIGHT);
+}
+
+
+static int f_highlight(lua_State *L) {
+  Tokenizer *tk = checktokenizer(L, 1);
+  PieceTable *pt = *(PieceTable**) luaL_checkudata(L, 2, API_TYPE_BUFFER);
+  int line_count = pt_line_count(pt);
+  int first = luaL_checknumber(L, 3);
+  if (first < 1) { first = 1; }
+  if (first > line_count) { first = line_count; }
+  int state = optstate(L, 4);
+
+  Highlight *h = lua_newuserdata(L, sizeof(Highlight));
+  memset(h, 0, sizeof(Highlight));
+  luaL_setmetatable(L, API_TYPE_HIGHLIGHT);
+  /* keeps the tokenizer alive as long as the job */
+  lua_createtable(L, 1, 0);
+  lua_pushvalue(L, 1);
+  lua_rawseti(L, -2, 1);
+  lua_setuservalue(L, -2);
+
+  size_t offset = pt_line_offset(pt, first);
+  size_t len = pt_length(pt) - offset;
+  h->tk = tk;
+  h->text = malloc(len ? len : 1);
+  pt_copy(pt, offset, len, h->text);
+  h->first_line = first;
+  h->line_count = h->limit = line_count - first + 1;
+  h->start_state = state;
+  h->chunk_count = (h->line_count + HIGHLIGHT_CHUNK_LINES - 1) / HIGHLIGHT_CHUNK_LINES;
+  h->chunks = calloc(h->chunk_count, sizeof(Chunk));
+  for (int i = 0; i < h->chunk_count; i++) {
+    Chunk *c = &h->chunks[i];
+    int line = first + i * HIGHLIGHT_CHUNK_LINES;
+    c->first_line = i * HIGHLIGHT_CHUNK_LINES;
+    c->line_count = h->line_count - c->first_line;
+    if (c->line_count > HIGHLIGHT_CHUNK_LINES) { c->line_count = HIGHLIGHT_CHUNK_LINES; }
+    c->offset = pt_line_offset(pt, line) - offset;
+    c->end = i + 1 < h->chunk_count ? pt_line_offset(pt, line + HIGHLIGHT_CHUNK_LINES) - offset : len;
+    c->lines = malloc(c->line_count * sizeof(Line));
+    c->start_state = i == 0 ? state : 0;
+  }
+
+  h->thread_count = h->chunk_count < HIGHLIGHT_WORKERS ? h->chunk_count : HIGHLIGHT_WORKERS;
+  for (int i = 0; i < h->thread_count; i++) {
+    kinc_thread_init(&h->threads[i], highlight_thread, h);
+  }
+  return 1;
+}
+
+
+/* stores a line of an accepted chunk, `idx` counts from the first line of the
+** job */
+static void store_line(Highlight *h, TokenLines *tl, int idx) {
+  Chunk *c = &h->chunks[idx / HIGHLIGHT_CHUNK_LINES];
+  Line *line = &c->lines[idx % HIGHLIGHT_CHUNK_LINES];
+  tl_set(tl, h->first_line + idx, h->tk, c->tokens + line->first, line->count,
+         line->init_state, line->state, line->hash, line->length);
+}
+
+
+/* accepts the chunks the workers are done with and stores their lines from
+** line `first` of the document on; returns the number of lines from the first
+** one of the job that are final and whether the job is done */
+static int f_poll(lua_State *L) {
+  Highlight *h = checkhighlight(L, 1);
+  TokenLines *tl = checklines(L, 2);
+  int first = luaL_checknumber(L, 3) - h->first_line;
+  while (h->text && !h->finished && h->ready_chunks < h->chunk_count) {
+    Chunk *c = &h->chunks[h->ready_chunks];
+    if (c->first_line >= h->limit || atomic_load(&c->status) != CHUNK_DONE) { break; }
+    int state = h->ready_chunks > 0 ? h->chunks[h->ready_chunks - 1].end_state : h->start_state;
+    if (c->start_state != state && !reconcile(h, c, state)) {
+      c->start_state = state;
+      KINC_ATOMIC_COMPARE_EXCHANGE(&c->status, CHUNK_DONE, CHUNK_PENDING);
+      break;
+    }
+    c->start_state = state;
+    h->ready_lines = c->first_line + c->line_count;
+    h->ready_chunks++;
+  }
+  if (h->ready_lines > h->limit) { h->ready_lines = h->limit; }
+  if (h->stored_lines < first) { h->stored_lines = first; }
+  if (h->stored_lines < h->ready_lines) {
+    lua_getuservalue(L, 1);
+    lua_rawgeti(L, -1, 1);
+    lines_keep(L, 2, lua_gettop(L));
+    lua_pop(L, 2);
+    lines_known(L, 2);
+    for (; h->stored_lines < h->ready_lines; h->stored_lines++) {
+      store_line(h, tl, h->stored_lines);
+      lines_forget(L, h->first_line + h->stored_lines);
+    }
+    lua_pop(L, 1);
+  }
+  bool done = !h->text || h->ready_lines == h->limit;
+  if (done && !h->finished) { KINC_ATOMIC_EXCHANGE_32(&h->finished, 1); }
+  if (h->finished && !h->joined && atomic_load(&h->workers_done) == h->thread_count) {
+    /* every worker has returned already, this does not wait */
+    for (int i = 0; i < h->thread_count; i++) { kinc_thread_wait_and_destroy(&h->threads[i]); }
+    h->joined = true;
+  }
+  lua_pushnumber(L, h->ready_lines);
+  lua_pushboolean(L, done);
+  return 2;
+}
+
+
+/* drops the lines from `idx` on, they were edited */
+static int f_truncate(lua_State *L) {
+  Highlight *h = checkhighlight(L, 1);
+  int idx = luaL_checknumber(L, 2) - h->first_line;
+  if (idx < 0) { idx = 0; }
+  if (idx < h->limit) { KINC_ATOMIC_EXCHANGE_32(&h->limit, idx); }
+  if (h->ready_lines > idx) { h->ready_lines = idx; }
+  if (h->stored_lines > idx) { h->stored_lines = idx; }
+  return 0;
+}
+
+
+static int f_cancel(lua_State *L) {
+  highlight_stop(checkhighlight(L, 1));
+  return 0;
+}
+
+
+static const luaL_Reg tokenizer_lib[] = {
+  { "__gc",      f_gc        },
+  { "tokenize",  f_tokenize  },
+  { "highlight", f_highlight },
+  { NULL,        NULL        }
+};
+
+
+static const luaL_Reg highlight_lib[] = {
+  { "poll",     f_poll     },
+  { "truncate", f_truncate },
+  { "cancel",   f_cancel   },
+  { "__gc",     f_cancel   },
+  { NULL,       NULL       }
+};
+
+
+static const luaL_Reg lines_lib[] = {
+  { "__gc",           f_lines_gc             },
+  { "tokenize",       f_lines_tokenize       },
+  { "set",            f_lines_set            },
+  { "matches",        f_lines_matches        },
+  { "get_state",      f_lines_get_state      },
+  { "get_init_state", f_lines_get_init_state },
+  { "get_tokens",     f_lines_get_tokens     },
+  { "each_token",     f_lines_each_token     },
+  { NULL,             NULL                   }
+};
+
+
+static const luaL_Reg lib[] = {
+  { "compile", f_compile },
+  { "lines",   f_lines   },
+  { NULL,      NULL      }
+};
+
+
+int luaopen_tokenizer(lua_State *L) {
+  luaL_newmetatable(L, API_TYPE_TOKENIZER);
+  luaL_setfuncs(L, tokenizer_lib, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+  luaL_newmetatable(L, API_TYPE_HIGHLIGHT);
+  luaL_setfuncs(L, highlight_lib, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+  luaL_newmetatable(L, API_TYPE_TOKEN_LINES);
+  luaL_setfuncs(L, lines_lib, 0);
+  lua_pushvalue(L, -1);
+  lua_setfield(L, -2, "__index");
+  lua_pop(L, 1);
+  luaL_newlib(L, lib);
+  return 1;
+}
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include "bytecache.h"
+#include "lib/lua52/lauxlib.h"
+
+/* Bytecode cache for Lua files. The first time a file is loaded its parsed
+** function is dumped (lua_dump, so with debug information) into `dir`, named
+** after a hash of the path; later loads undump that instead of parsing the
+** source. A cache file starts with a header holding the Lua release that
+** wrote it, the modification time and size of the source, the full source
+** path and a checksum of the bytecode. Anything that does not match, or
+** bytecode lundump.c refuses, loads the source again and rewrites the cache
+** file, so a stale or damaged cache is never used and never an error. Failing
+** to write the cache is not an error either. */
+
+#define CACHE_MAGIC "LITEBC1"
+
+/* files saved twice within a second must not look the same */
+#if defined(__APPLE__)
+  #define MTIME_NSEC(s) ((s).st_mtimespec.tv_nsec)
+#elif defined(__linux__)
+  #define MTIME_NSEC(s) ((s).st_mtim.tv_nsec)
+#else
+  #define MTIME_NSEC(s) 0
+#endif
+
+typedef struct {
+  char magic[8];
+  char release[16];
+  /* of the source, the time in nanoseconds */
+  int64_t mtime, size;
+  /* the source path follows the header, then the bytecode */
+  uint32_t path_len, checksum;
+} CacheHeader;
+
+typedef struct {
+  char *data;
+  size_t size, capacity;
+} DumpBuffer;
+
+
+static uint32_t hash_bytes(const char *data, size_t len) {
+  /* FNV-1a */
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (unsigned char) data[i]) * 16777619u;
+  }
+  return h;
+}
+
+
+static int dump_writer(lua_State *L, const void *p, size_t size, void *ud) {
+  DumpBuffer *b = ud;
+  if (b->size + size > b->capacity) {
+    size_t capacity = b->capacity ? b->capacity * 2 : 4096;
+    while (capacity < b->size + size) { capacity *= 2; }
+    char *data = realloc(b->data, capacity);
+    if (!data) { return 1; }
+    b->data = data;
+    b->capacity = capacity;
+  }
+  memcpy(b->data + b->size, p, size);
+  b->size += size;
+  return 0;
+}
+
+
+/* pushes the cached function if the cache file matches `expect` */
+static bool load_cache(lua_State *L, const char *cachefile, const char *filename,
+                       const CacheHeader *expect) {
+  FILE *fp = fopen(cachefile, "rb");
+  if (!fp) { return false; }
+  CacheHeader h;
+  char *data = NULL;
+  bool ok = fread(&h, sizeof(h), 1, fp) == 1 &&
+            memcmp(&h, expect, offsetof(CacheHeader, checksum)) == 0;
+  long size = 0;
+  if (ok) {
+    long start = ftell(fp);
+    ok = fseek(fp, 0, SEEK_END) == 0 && (size = ftell(fp) - start) > (long) h.path_len &&
+         fseek(fp, start, SEEK_SET) == 0;
+  }
+  if (ok) {
+    data = malloc(size);
+    ok = data && fread(data, 1, size, fp) == (size_t) size &&
+         memcmp(data, filename, h.path_len) == 0 &&
+         hash_bytes(data + h.path_len, size - h.path_len) == h.checksum;
+  }
+  fclose(fp);
+  if (ok) {
+    const char *chunkname = lua_pushfstring(L, "@%s", filename);
+    ok = luaL_loadbufferx(L, data + h.path_len, size - h.path_len, chunkname, "b") == LUA_OK;
+    if (ok) {
+      lua_remove(L, -2);
+    } else {
+      lua_pop(L, 2);
+    }
+  }
+  free(data);
+  return ok;
+}
+
+
+/* dumps the function on top of the stack into the cache file */
+static void save_cache(lua_State *L, const char *cachefile, const char *filename, CacheHeader *h) {
+  DumpBuffer b = { 0 };
+  if (lua_dump(L, dump_writer, &b) != 0 || !b.data) {
+    free(b.data);
+    return;
+  }
+  h->checksum = hash_bytes(b.data, b.size);
+  /* written next to it and renamed, so a cache file is always complete */
+  char tmp[1024];
+  snprintf(tmp, sizeof(tmp), "%s.tmp", cachefile);
+  FILE *fp = fopen(tmp, "wb");
+  if (fp) {
+    bool ok = fwrite(h, sizeof(*h), 1, fp) == 1 &&
+              fwrite(filename, 1, h->path_len, fp) == h->path_len &&
+              fwrite(b.data, 1, b.size, fp) == b.size;
+    ok = fclose(fp) == 0 && ok;
+#ifdef _WIN32
+    remove(cachefile);
+#endif
+    if (!ok || rename(tmp, cachefile) != 0) { remove(tmp); }
+  }
+  free(b.data);
+}
+
+
+/* Loads a Lua file like `loadfile` does, through the cache in `dir`: pushes the
+** function and returns 1, or pushes nil and the error message and returns 2 */
+int bytecache_load(lua_State *L, const char *filename, const char *dir) {
+  char cachefile[1024];
+  CacheHeader h;
+  memset(&h, 0, sizeof(h));
+  struct stat s;
+  bool cached = stat(filename, &s) == 0 &&
+    snprintf(cachefile, sizeof(cachefile), "%s/%08x.luac", dir,
+             hash_bytes(filename, strlen(filename))) < (int) sizeof(cachefile) - 4;
+  if (cached) {
+    memcpy(h.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    strncpy(h.release, LUA_RELEASE, sizeof(h.release) - 1);
+    h.mtime = (int64_t) s.st_mtime * 1000000000 + MTIME_NSEC(s);
+    h.size = s.st_size;
+    h.path_len = strlen(filename);
+    if (load_cache(L, cachefile, filename, &h)) { return 1; }
+  }
+  if (luaL_loadfile(L, filename) != LUA_OK) {
+    lua_pushnil(L);
+    lua_insert(L, -2);
+    return 2;
+  }
+  if (cached) { save_cache(L, cachefile, filename, &h); }
+  return 1;
+}
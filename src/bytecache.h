@@ -0,0 +1,8 @@
+#ifndef BYTECACHE_H
+#define BYTECACHE_H
+
+#include "lib/lua52/lua.h"
+
+int bytecache_load(lua_State *L, const char *filename, const char *dir);
+
+#endif
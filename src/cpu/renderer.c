@@ -1,12 +1,46 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <string.h>
 #include <assert.h>
 #include <math.h>
 #include "lib/stb/stb_truetype.h"
+#include <kinc/graphics4/graphics.h>
+#include <kinc/graphics4/texture.h>
+#include <kinc/system.h>
+#include <kinc/threads/atomic.h>
+#include <kinc/threads/event.h>
+#include <kinc/threads/mutex.h>
+#include <kinc/threads/thread.h>
+#include <kinc/threads/threadlocal.h>
+#include <krink/graphics2/graphics.h>
+#include <krink/image.h>
 #include "renderer.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define REN_SSE2
+#endif
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define REN_AVX2
+#endif
+
+/* Software renderer. Everything is drawn into `surface`, a plain RGBA pixel
+** buffer which is uploaded to a texture once the dirty rects of a frame are
+** drawn and presented by blitting it to the framebuffer. Rects and glyphs are
+** blended 4 (SSE2) or 8 (AVX2) pixels at a time with the same integer math as
+** the scalar fallback, so every path gives the very same pixels.
+**
+** Disjoint regions of the surface can be drawn on several threads at once with
+** `ren_parallel`; the clip rect is kept per thread for that.
+**
+** Built with LITE_HEADLESS there is no window and no texture: the surface has
+** the size given to `ren_set_headless` and every redrawn frame can be written
+** out as a binary PPM for comparing against golden images. */
+
 #define MAX_GLYPHSET 256
+#define REN_WORKERS 4
 
 struct RenImage {
   RenColor *pixels;
@@ -24,10 +58,39 @@ struct RenFont {
   GlyphSet *sets[MAX_GLYPHSET];
   float size;
   int height;
+  char path[260];
 };
 
+typedef struct { int left, top, right, bottom; } Clip;
 
-static struct { int left, top, right, bottom; } clip;
+typedef struct {
+  kinc_thread_t thread;
+  kinc_event_t start, done;
+  Clip clip;
+} Worker;
+
+static RenImage *surface;
+#ifdef LITE_HEADLESS
+static int headless_width = 1280, headless_height = 800;
+static const char *dump_dir;
+static int frame_idx;
+#else
+static kinc_g4_texture_t surface_tex;
+static kr_image_t surface_image;
+#endif
+
+static Clip main_clip;
+static kinc_thread_local_t clip_key;
+static kinc_mutex_t glyph_mutex;
+
+static Worker workers[REN_WORKERS];
+static bool workers_started;
+static struct {
+  void (*fn)(int idx, void *udata);
+  void *udata;
+  int count;
+  volatile int next;
+} job;
 
 
 static void* check_alloc(void *ptr) {
@@ -56,34 +119,64 @@ static const char* utf8_to_codepoint(const char *p, unsigned *dst) {
 }
 
 
+static inline Clip* get_clip(void) {
+  Clip *clip = kinc_thread_local_get(&clip_key);
+  return clip ? clip : &main_clip;
+}
+
+
 void ren_init(void) {
+#ifndef LITE_HEADLESS
   kr_g2_init();
-  int w = kinc_width();
-  int h = kinc_height();
+#endif
+  kinc_thread_local_init(&clip_key);
+  kinc_mutex_init(&glyph_mutex);
+}
+
+
+#ifdef LITE_HEADLESS
+void ren_set_headless(int width, int height, const char *dump) {
+  headless_width = width;
+  headless_height = height;
+  dump_dir = dump;
 }
 
+
+void ren_update_rects(RenRect *rects, int count) {}
+#else
+/* locking the texture may discard what it held, so the whole surface is
+** uploaded whenever anything in it was redrawn */
 void ren_update_rects(RenRect *rects, int count) {
-  SDL_UpdateWindowSurfaceRects(window, (SDL_Rect*) rects, count);
-  static bool initial_frame = true;
-  if (initial_frame) {
-    SDL_ShowWindow(window);
-    initial_frame = false;
+  (void) rects;
+  if (count == 0 || !surface) { return; }
+  uint8_t *data = kinc_g4_texture_lock(&surface_tex);
+  int stride = kinc_g4_texture_stride(&surface_tex);
+  for (int y = 0; y < surface->height; y++) {
+    memcpy(data + y * stride, surface->pixels + y * surface->width,
+           surface->width * sizeof(RenColor));
   }
+  kinc_g4_texture_unlock(&surface_tex);
 }
+#endif
 
 
 void ren_set_clip_rect(RenRect rect) {
-  clip.left   = rect.x;
-  clip.top    = rect.y;
-  clip.right  = rect.x + rect.width;
-  clip.bottom = rect.y + rect.height;
+  Clip *clip = get_clip();
+  clip->left   = rect.x;
+  clip->top    = rect.y;
+  clip->right  = rect.x + rect.width;
+  clip->bottom = rect.y + rect.height;
 }
 
 
 void ren_get_size(int *x, int *y) {
-  SDL_Surface *surf = SDL_GetWindowSurface(window);
-  *x = surf->w;
-  *y = surf->h;
+#ifdef LITE_HEADLESS
+  *x = headless_width;
+  *y = headless_height;
+#else
+  *x = kinc_width();
+  *y = kinc_height();
+#endif
 }
 
 
@@ -148,10 +241,16 @@ retry:
 }
 
 
+/* the sets drawn with were already loaded on the main thread when the text was
+** measured, the lock only keeps threads from loading the same one twice */
 static GlyphSet* get_glyphset(RenFont *font, int codepoint) {
   int idx = (codepoint >> 8) % MAX_GLYPHSET;
   if (!font->sets[idx]) {
-    font->sets[idx] = load_glyphset(font, idx);
+    kinc_mutex_lock(&glyph_mutex);
+    if (!font->sets[idx]) {
+      font->sets[idx] = load_glyphset(font, idx);
+    }
+    kinc_mutex_unlock(&glyph_mutex);
   }
   return font->sets[idx];
 }
@@ -164,6 +263,7 @@ RenFont* ren_load_font(const char *filename, float size) {
   /* init font */
   font = check_alloc(calloc(1, sizeof(RenFont)));
   font->size = size;
+  snprintf(font->path, sizeof(font->path), "%s", filename);
 
   /* load font into buffer */
   fp = fopen(filename, "rb");
@@ -240,6 +340,23 @@ int ren_get_font_width(RenFont *font, const char *text) {
 }
 
 
+float ren_get_font_advance(RenFont *font, const char *text, int len, float x) {
+  const char *p = text;
+  unsigned codepoint;
+  while (p < text + len) {
+    p = utf8_to_codepoint(p, &codepoint);
+    GlyphSet *set = get_glyphset(font, codepoint);
+    x += set->glyphs[codepoint & 0xff].xadvance;
+  }
+  return x;
+}
+
+
+const char* ren_get_font_path(RenFont *font) {
+  return font->path;
+}
+
+
 int ren_get_font_height(RenFont *font) {
   return font->height;
 }
@@ -264,34 +381,309 @@ static inline RenColor blend_pixel2(RenColor dst, RenColor src, RenColor color)
 }
 
 
-#define rect_draw_loop(expr)        \
-  for (int j = y1; j < y2; j++) {   \
-    for (int i = x1; i < x2; i++) { \
-      *d = expr;                    \
-      d++;                          \
-    }                               \
-    d += dr;                        \
+#ifdef REN_SSE2
+/* pixels are widened to 16 bit channels: `sa` holds the color premultiplied by
+** its alpha and `ia` the inverse alpha, with 0 and 256 in the alpha lanes so
+** the destination alpha passes through unchanged */
+static inline __m128i blend_half(__m128i d, __m128i sa, __m128i ia) {
+  return _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(d, ia), sa), 8);
+}
+
+static inline __m128i blend4(__m128i d, __m128i sa, __m128i ia) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = blend_half(_mm_unpacklo_epi8(d, zero), sa, ia);
+  __m128i hi = blend_half(_mm_unpackhi_epi8(d, zero), sa, ia);
+  return _mm_packus_epi16(lo, hi);
+}
+
+/* `color` holds the tint in every pixel's four lanes; the product of source
+** and tint fits 16 bits, so its scaling by the source alpha is a mulhi */
+static inline __m128i blend_image_half(__m128i d, __m128i s, __m128i color) {
+  __m128i sc = _mm_mullo_epi16(s, color);
+  __m128i sa = _mm_srli_epi16(sc, 8);
+  sa = _mm_shufflehi_epi16(_mm_shufflelo_epi16(sa, 0xff), 0xff);
+  __m128i ia = _mm_sub_epi16(_mm_set1_epi16(0xff), sa);
+  return _mm_add_epi16(_mm_mulhi_epu16(sc, sa), _mm_srli_epi16(_mm_mullo_epi16(d, ia), 8));
+}
+
+static inline __m128i blend_image4(__m128i d, __m128i s, __m128i color, __m128i alpha) {
+  __m128i zero = _mm_setzero_si128();
+  __m128i lo = blend_image_half(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero), color);
+  __m128i hi = blend_image_half(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero), color);
+  __m128i res = _mm_packus_epi16(lo, hi);
+  return _mm_or_si128(_mm_andnot_si128(alpha, res), _mm_and_si128(alpha, d));
+}
+#endif
+
+
+#ifdef REN_AVX2
+static inline __m256i blend_half8(__m256i d, __m256i sa, __m256i ia) {
+  return _mm256_srli_epi16(_mm256_add_epi16(_mm256_mullo_epi16(d, ia), sa), 8);
+}
+
+static inline __m256i blend8(__m256i d, __m256i sa, __m256i ia) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i lo = blend_half8(_mm256_unpacklo_epi8(d, zero), sa, ia);
+  __m256i hi = blend_half8(_mm256_unpackhi_epi8(d, zero), sa, ia);
+  return _mm256_packus_epi16(lo, hi);
+}
+
+static inline __m256i blend_image_half8(__m256i d, __m256i s, __m256i color) {
+  __m256i sc = _mm256_mullo_epi16(s, color);
+  __m256i sa = _mm256_srli_epi16(sc, 8);
+  sa = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(sa, 0xff), 0xff);
+  __m256i ia = _mm256_sub_epi16(_mm256_set1_epi16(0xff), sa);
+  return _mm256_add_epi16(_mm256_mulhi_epu16(sc, sa),
+                          _mm256_srli_epi16(_mm256_mullo_epi16(d, ia), 8));
+}
+
+static inline __m256i blend_image8(__m256i d, __m256i s, __m256i color, __m256i alpha) {
+  __m256i zero = _mm256_setzero_si256();
+  __m256i lo = blend_image_half8(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero), color);
+  __m256i hi = blend_image_half8(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero), color);
+  __m256i res = _mm256_packus_epi16(lo, hi);
+  return _mm256_or_si256(_mm256_andnot_si256(alpha, res), _mm256_and_si256(alpha, d));
+}
+#endif
+
+
+static void fill_rows(RenColor *d, int stride, int width, int height, RenColor color) {
+  uint32_t c;
+  memcpy(&c, &color, sizeof(c));
+  for (int j = 0; j < height; j++, d += stride) {
+    int i = 0;
+#ifdef REN_AVX2
+    __m256i c8 = _mm256_set1_epi32(c);
+    for (; i + 8 <= width; i += 8) { _mm256_storeu_si256((__m256i*) (d + i), c8); }
+#endif
+#ifdef REN_SSE2
+    __m128i c4 = _mm_set1_epi32(c);
+    for (; i + 4 <= width; i += 4) { _mm_storeu_si128((__m128i*) (d + i), c4); }
+#endif
+    for (; i < width; i++) { d[i] = color; }
+  }
+}
+
+
+static void blend_rows(RenColor *d, int stride, int width, int height, RenColor color) {
+#ifdef REN_SSE2
+  int ia = 0xff - color.a;
+  __m128i sa4 = _mm_setr_epi16(color.r * color.a, color.g * color.a, color.b * color.a, 0,
+                               color.r * color.a, color.g * color.a, color.b * color.a, 0);
+  __m128i ia4 = _mm_setr_epi16(ia, ia, ia, 256, ia, ia, ia, 256);
+#endif
+#ifdef REN_AVX2
+  __m256i sa8 = _mm256_broadcastsi128_si256(sa4);
+  __m256i ia8 = _mm256_broadcastsi128_si256(ia4);
+#endif
+  for (int j = 0; j < height; j++, d += stride) {
+    int i = 0;
+#ifdef REN_AVX2
+    for (; i + 8 <= width; i += 8) {
+      __m256i v = _mm256_loadu_si256((__m256i*) (d + i));
+      _mm256_storeu_si256((__m256i*) (d + i), blend8(v, sa8, ia8));
+    }
+#endif
+#ifdef REN_SSE2
+    for (; i + 4 <= width; i += 4) {
+      __m128i v = _mm_loadu_si128((__m128i*) (d + i));
+      _mm_storeu_si128((__m128i*) (d + i), blend4(v, sa4, ia4));
+    }
+#endif
+    for (; i < width; i++) { d[i] = blend_pixel(d[i], color); }
   }
+}
+
+
+static void blend_image_rows(RenColor *d, int dstride, const RenColor *s, int sstride,
+                             int width, int height, RenColor color) {
+#ifdef REN_SSE2
+  __m128i color4 = _mm_setr_epi16(color.r, color.g, color.b, color.a,
+                                  color.r, color.g, color.b, color.a);
+  __m128i alpha4 = _mm_set1_epi32(0xff << 24);
+#endif
+#ifdef REN_AVX2
+  __m256i color8 = _mm256_broadcastsi128_si256(color4);
+  __m256i alpha8 = _mm256_broadcastsi128_si256(alpha4);
+#endif
+  for (int j = 0; j < height; j++, d += dstride, s += sstride) {
+    int i = 0;
+#ifdef REN_AVX2
+    for (; i + 8 <= width; i += 8) {
+      __m256i dv = _mm256_loadu_si256((__m256i*) (d + i));
+      __m256i sv = _mm256_loadu_si256((const __m256i*) (s + i));
+      _mm256_storeu_si256((__m256i*) (d + i), blend_image8(dv, sv, color8, alpha8));
+    }
+#endif
+#ifdef REN_SSE2
+    for (; i + 4 <= width; i += 4) {
+      __m128i dv = _mm_loadu_si128((__m128i*) (d + i));
+      __m128i sv = _mm_loadu_si128((const __m128i*) (s + i));
+      _mm_storeu_si128((__m128i*) (d + i), blend_image4(dv, sv, color4, alpha4));
+    }
+#endif
+    for (; i < width; i++) { d[i] = blend_pixel2(d[i], s[i], color); }
+  }
+}
+
+
+static void resize_surface(int w, int h) {
+  if (surface && surface->width == w && surface->height == h) { return; }
+  if (surface) {
+    ren_free_image(surface);
+#ifndef LITE_HEADLESS
+    kinc_g4_texture_destroy(&surface_tex);
+#endif
+  }
+  surface = ren_new_image(w, h);
+  fill_rows(surface->pixels, w, w, h, (RenColor) { .r = 0, .g = 0, .b = 0, .a = 255 });
+#ifndef LITE_HEADLESS
+  kinc_g4_texture_init(&surface_tex, w, h, KINC_IMAGE_FORMAT_RGBA32);
+  kr_image_from_texture(&surface_image, &surface_tex, w, h);
+#endif
+}
+
+
+void ren_begin_frame(void) {
+  int w, h;
+  ren_get_size(&w, &h);
+  resize_surface(w, h);
+}
+
+
+#ifdef LITE_HEADLESS
+static void dump_surface(void) {
+  char filename[1024];
+  snprintf(filename, sizeof(filename), "%s/frame-%05d.ppm", dump_dir, frame_idx);
+  FILE *fp = fopen(filename, "wb");
+  if (!fp) {
+    fprintf(stderr, "Warning: could not write %s\n", filename);
+    return;
+  }
+  fprintf(fp, "P6\n%d %d\n255\n", surface->width, surface->height);
+  unsigned char *row = check_alloc(malloc(surface->width * 3));
+  for (int y = 0; y < surface->height; y++) {
+    RenColor *p = surface->pixels + y * surface->width;
+    for (int x = 0; x < surface->width; x++) {
+      row[x * 3 + 0] = p[x].r;
+      row[x * 3 + 1] = p[x].g;
+      row[x * 3 + 2] = p[x].b;
+    }
+    fwrite(row, 3, surface->width, fp);
+  }
+  free(row);
+  fclose(fp);
+}
+
+
+/* frames are numbered by their step of the main loop, whether they were
+** redrawn or not */
+void ren_end_frame(void) {
+  if (dump_dir) { dump_surface(); }
+  frame_idx++;
+}
+
+
+void ren_present(void) {
+  frame_idx++;
+}
+#else
+static void present_surface(void) {
+  kinc_g4_begin(0);
+  kr_g2_begin(0);
+  kr_g2_set_color(0xffffffff);
+  kr_g2_draw_scaled_sub_image(&surface_image, 0, 0, surface->width, surface->height,
+                              0, 0, surface->width, surface->height);
+  kr_g2_end();
+  kinc_g4_end(0);
+}
+
+
+void ren_end_frame(void) {
+  present_surface();
+}
+
+
+void ren_present(void) {
+  if (surface) { present_surface(); }
+}
+#endif
+
+
+static void run_job(void) {
+  for (;;) {
+    int idx;
+    do {
+      idx = job.next;
+    } while (!KINC_ATOMIC_COMPARE_EXCHANGE(&job.next, idx, idx + 1));
+    if (idx >= job.count) { return; }
+    job.fn(idx, job.udata);
+  }
+}
+
+
+static void worker_thread(void *data) {
+  Worker *w = data;
+  kinc_thread_local_set(&clip_key, &w->clip);
+  for (;;) {
+    kinc_event_wait(&w->start);
+    run_job();
+    kinc_event_signal(&w->done);
+  }
+}
+
+
+void ren_parallel(int count, void (*fn)(int idx, void *udata), void *udata) {
+  job.fn = fn;
+  job.udata = udata;
+  job.count = count;
+  job.next = 0;
+  int n = count - 1 < REN_WORKERS ? count - 1 : REN_WORKERS;
+  if (n > 0 && !workers_started) {
+    for (int i = 0; i < REN_WORKERS; i++) {
+      kinc_event_init(&workers[i].start, true);
+      kinc_event_init(&workers[i].done, true);
+      kinc_thread_init(&workers[i].thread, worker_thread, &workers[i]);
+    }
+    workers_started = true;
+  }
+  for (int i = 0; i < n; i++) { kinc_event_signal(&workers[i].start); }
+  run_job();
+  for (int i = 0; i < n; i++) { kinc_event_wait(&workers[i].done); }
+}
+
+
+void ren_scroll_rect(RenRect rect, int dy) {
+  RenColor *pixels = surface->pixels;
+  int rows = rect.height - abs(dy);
+  int from = dy > 0 ? rect.y : rect.y - dy;
+  int to = from + dy;
+  /* start on the side the rows move to, so none is overwritten before it is read */
+  for (int i = 0; i < rows; i++) {
+    int row = dy > 0 ? rows - 1 - i : i;
+    memmove(pixels + rect.x + (to + row) * surface->width,
+            pixels + rect.x + (from + row) * surface->width, rect.width * sizeof(RenColor));
+  }
+}
+
 
 void ren_draw_rect(RenRect rect, RenColor color) {
   if (color.a == 0) { return; }
 
-  int x1 = rect.x < clip.left ? clip.left : rect.x;
-  int y1 = rect.y < clip.top  ? clip.top  : rect.y;
+  Clip *clip = get_clip();
+  int x1 = rect.x < clip->left ? clip->left : rect.x;
+  int y1 = rect.y < clip->top  ? clip->top  : rect.y;
   int x2 = rect.x + rect.width;
   int y2 = rect.y + rect.height;
-  x2 = x2 > clip.right  ? clip.right  : x2;
-  y2 = y2 > clip.bottom ? clip.bottom : y2;
-
-  SDL_Surface *surf = SDL_GetWindowSurface(window);
-  RenColor *d = (RenColor*) surf->pixels;
-  d += x1 + y1 * surf->w;
-  int dr = surf->w - (x2 - x1);
+  x2 = x2 > clip->right  ? clip->right  : x2;
+  y2 = y2 > clip->bottom ? clip->bottom : y2;
+  if (x2 <= x1 || y2 <= y1) { return; }
 
+  RenColor *d = surface->pixels + x1 + y1 * surface->width;
   if (color.a == 0xff) {
-    rect_draw_loop(color);
+    fill_rows(d, surface->width, x2 - x1, y2 - y1, color);
   } else {
-    rect_draw_loop(blend_pixel(*d, color));
+    blend_rows(d, surface->width, x2 - x1, y2 - y1, color);
   }
 }
 
@@ -300,34 +692,21 @@ void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color)
   if (color.a == 0) { return; }
 
   /* clip */
+  Clip *clip = get_clip();
   int n;
-  if ((n = clip.left - x) > 0) { sub->width  -= n; sub->x += n; x += n; }
-  if ((n = clip.top  - y) > 0) { sub->height -= n; sub->y += n; y += n; }
-  if ((n = x + sub->width  - clip.right ) > 0) { sub->width  -= n; }
-  if ((n = y + sub->height - clip.bottom) > 0) { sub->height -= n; }
+  if ((n = clip->left - x) > 0) { sub->width  -= n; sub->x += n; x += n; }
+  if ((n = clip->top  - y) > 0) { sub->height -= n; sub->y += n; y += n; }
+  if ((n = x + sub->width  - clip->right ) > 0) { sub->width  -= n; }
+  if ((n = y + sub->height - clip->bottom) > 0) { sub->height -= n; }
 
   if (sub->width <= 0 || sub->height <= 0) {
     return;
   }
 
   /* draw */
-  SDL_Surface *surf = SDL_GetWindowSurface(window);
-  RenColor *s = image->pixels;
-  RenColor *d = (RenColor*) surf->pixels;
-  s += sub->x + sub->y * image->width;
-  d += x + y * surf->w;
-  int sr = image->width - sub->width;
-  int dr = surf->w - sub->width;
-
-  for (int j = 0; j < sub->height; j++) {
-    for (int i = 0; i < sub->width; i++) {
-      *d = blend_pixel2(*d, *s, color);
-      d++;
-      s++;
-    }
-    d += dr;
-    s += sr;
-  }
+  RenColor *s = image->pixels + sub->x + sub->y * image->width;
+  RenColor *d = surface->pixels + x + y * surface->width;
+  blend_image_rows(d, surface->width, s, image->width, sub->width, sub->height, color);
 }
 
 
@@ -348,3 +727,12 @@ int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color)
   }
   return x;
 }
+
+
+int ren_draw_line(RenFont *font, const char **texts, const RenColor *colors, int count, int x, int y) {
+  for (int i = 0; i < count; i++) {
+    ren_draw_text(font, texts[i], x, y, colors[i]);
+    x += ren_get_font_width(font, texts[i]);
+  }
+  return x;
+}
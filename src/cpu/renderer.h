@@ -6,14 +6,23 @@
 typedef struct RenImage RenImage;
 typedef struct RenFont RenFont;
 
-typedef struct { uint8_t b, g, r, a; } RenColor;
+typedef enum { FONT_HINTING_NONE, FONT_HINTING_SLIGHT, FONT_HINTING_FULL } ERenFontHinting;
+typedef enum { FONT_ANTIALIASING_NONE, FONT_ANTIALIASING_GRAYSCALE, FONT_ANTIALIASING_SUBPIXEL } ERenFontAntialiasing;
+typedef enum { FONT_STYLE_BOLD = 1, FONT_STYLE_ITALIC = 2, FONT_STYLE_UNDERLINE = 4, FONT_STYLE_SMOOTH = 8, FONT_STYLE_STRIKETHROUGH = 16 } ERenFontStyle;
+typedef struct { uint8_t r, g, b, a; } RenColor;
 typedef struct { int x, y, width, height; } RenRect;
 
+#define REN_MAX_LINE_TOKENS 256
+
+/* disjoint regions can be drawn from several threads, see `ren_parallel` */
+#define REN_THREADED
+
 
 void ren_init(void);
 void ren_update_rects(RenRect *rects, int count);
 void ren_set_clip_rect(RenRect rect);
 void ren_get_size(int *x, int *y);
+void ren_scroll_rect(RenRect rect, int dy);
 
 RenImage* ren_new_image(int width, int height);
 void ren_free_image(RenImage *image);
@@ -23,10 +32,20 @@ void ren_free_font(RenFont *font);
 void ren_set_font_tab_width(RenFont *font, int n);
 int ren_get_font_tab_width(RenFont *font);
 int ren_get_font_width(RenFont *font, const char *text);
+float ren_get_font_advance(RenFont *font, const char *text, int len, float x);
 int ren_get_font_height(RenFont *font);
-
+const char* ren_get_font_path(RenFont *font);
+
+void ren_begin_frame(void);
+void ren_end_frame(void);
+void ren_present(void);
+void ren_parallel(int count, void (*fn)(int idx, void *udata), void *udata);
+#ifdef LITE_HEADLESS
+void ren_set_headless(int width, int height, const char *dump_dir);
+#endif
 void ren_draw_rect(RenRect rect, RenColor color);
 void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color);
 int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color);
+int ren_draw_line(RenFont *font, const char **texts, const RenColor *colors, int count, int x, int y);
 
 #endif
@@ -7,12 +7,14 @@
 #include "lib/stb/stb_truetype.h"
 #include <kinc/color.h>
 #include <kinc/graphics4/graphics.h>
+#include <kinc/graphics4/rendertarget.h>
 #include <kinc/system.h>
 #include <krink/color.h>
 #include <krink/system.h>
 #include <krink/memory.h>
 #include <krink/graphics2/graphics.h>
 #include <krink/graphics2/ttf.h>
+#include <krink/image.h>
 #include "renderer.h"
 
 #define MAX_GLYPHSET 256
@@ -30,6 +32,17 @@ typedef struct {
 static kinc_image_t surf;
 static struct { int left, top, right, bottom; } clip;
 
+/* the window contents are kept in a persistent render target; rencache only
+** redraws the dirty regions into it and every frame is presented by blitting
+** the whole target to the framebuffer */
+static kinc_g4_render_target_t target;
+static kr_image_t target_image;
+static int target_width, target_height;
+/* scrolled regions are copied out of the target and back in shifted, as a
+** render target can't be sampled while drawing to it */
+static kinc_g4_render_target_t scratch;
+static kr_image_t scratch_image;
+
 static inline uint32_t color_to_uint(RenColor color) {
 	uint32_t c = 0;
 	c = kr_color_set_channel(c, 'A', color.a);
@@ -48,12 +61,28 @@ static void* check_alloc(void *ptr) {
 }
 
 
+static void resize_target(int w, int h) {
+  if (target_width == w && target_height == h) { return; }
+  if (target_width > 0) {
+    kinc_g4_render_target_destroy(&target);
+    kinc_g4_render_target_destroy(&scratch);
+  }
+  kinc_g4_render_target_init(&target, w, h, KINC_G4_RENDER_TARGET_FORMAT_32BIT, 0, 0);
+  kr_image_from_render_target(&target_image, &target);
+  kinc_g4_render_target_init(&scratch, w, h, KINC_G4_RENDER_TARGET_FORMAT_32BIT, 0, 0);
+  kr_image_from_render_target(&scratch_image, &scratch);
+  target_width = w;
+  target_height = h;
+}
+
+
 void ren_init(void) {
   kr_g2_init();
-  int w = kinc_width();
-  int h = kinc_height();
+  resize_target(kinc_width(), kinc_height());
 }
 
+/* nothing to flush here: the dirty rects were already drawn into the render
+** target and `ren_end_frame` presents it */
 void ren_update_rects(RenRect *rects, int count) {}
 
 void ren_set_clip_rect(RenRect rect) {
@@ -138,21 +167,12 @@ void ren_free_font(RenFont *font) {
 
 
 void ren_set_font_tab_width(RenFont *font, int n) {
-  for(int i = 0; i < font->data->m_images_len;++i){
-    if((int)font->data->images[i].m_size  == (int)font->size ){
-      font->data->images[i].chars['\t'].xadvance = n;
-      break;
-    }
-  }
+  kr_ttf_set_tab_width(font->data, font->size, n);
 }
 
 
 int ren_get_font_tab_width(RenFont *font) {
-  for(int i = 0; i < font->data->m_images_len;++i){
-    if((int)font->data->images[i].m_size  == (int)font->size){
-      return font->data->images[i].chars['\t'].xadvance;
-    }
-  }
+  return kr_ttf_get_tab_width(font->data, font->size);
 }
 
 
@@ -161,22 +181,77 @@ int ren_get_font_width(RenFont *font, const char *text) {
 }
 
 
+float ren_get_font_advance(RenFont *font, const char *text, int len, float x) {
+  return kr_ttf_advance(font->data, font->size, text, len, x);
+}
+
+
+const char* ren_get_font_path(RenFont *font) {
+  return font->path;
+}
+
 int ren_get_font_height(RenFont *font) {
   return font->height;
 }
 
 void ren_begin_frame(void) {
+  int w = kinc_width();
+  int h = kinc_height();
+  bool resized = target_width != w || target_height != h;
+  resize_target(w, h);
+
   kinc_g4_begin(0);
+  kinc_g4_render_target_t *targets[1] = { &target };
+  kinc_g4_set_render_targets(targets, 1);
   kr_g2_begin(0);
-  kr_g2_clear(KINC_COLOR_BLACK);
+  kr_g2_set_render_target_dim(w, h);
+  if (resized) { kr_g2_clear(KINC_COLOR_BLACK); }
   kr_g2_set_transform(kr_matrix3x3_identity());
 }
 
+static void present_target(void) {
+  kr_g2_begin(0);
+  kr_g2_set_color(0xffffffff);
+  kr_g2_draw_scaled_sub_image(&target_image, 0, 0, target_width, target_height,
+                              0, 0, target_width, target_height);
+  kr_g2_end();
+}
+
 void ren_end_frame(void) {
   kr_g2_end();
+  kinc_g4_restore_render_target();
+  present_target();
   kinc_g4_end(0);
 }
 
+void ren_present(void) {
+  if (target_width == 0) { return; }
+  kinc_g4_begin(0);
+  present_target();
+  kinc_g4_end(0);
+}
+
+void ren_scroll_rect(RenRect rect, int dy) {
+  RenRect src = rect;
+  if (dy > 0) { src.height -= dy; }
+  else { src.y -= dy; src.height += dy; }
+  if (src.height <= 0) { return; }
+
+  kinc_g4_render_target_t *targets[1] = { &scratch };
+  kr_g2_flush();
+  kinc_g4_set_render_targets(targets, 1);
+  kr_g2_disable_scissor();
+  kr_g2_set_color(0xffffffff);
+  kr_g2_draw_scaled_sub_image(&target_image, src.x, src.y, src.width, src.height,
+                              src.x, src.y, src.width, src.height);
+  kr_g2_flush();
+  targets[0] = &target;
+  kinc_g4_set_render_targets(targets, 1);
+  kr_g2_draw_scaled_sub_image(&scratch_image, src.x, src.y, src.width, src.height,
+                              src.x, src.y + dy, src.width, src.height);
+}
+
+
 void ren_draw_rect(RenRect rect, RenColor color) {
   kr_g2_set_color(color_to_uint(color));
   kr_g2_fill_rect(rect.x,rect.y,rect.width,rect.height);
@@ -186,8 +261,14 @@ void ren_draw_rect(RenRect rect, RenColor color) {
 void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color) {}
 
 int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color) {
-  ren_set_font_tab_width(font, ren_get_font_tab_width(font));
   kr_g2_set_color(color_to_uint(color));
   kr_g2_set_font(font->data, font->size);
   return kr_g2_draw_string(text,x,y);
 }
+
+int ren_draw_line(RenFont *font, const char **texts, const RenColor *colors, int count, int x, int y) {
+  uint32_t line_colors[REN_MAX_LINE_TOKENS];
+  for (int i = 0; i < count; i++) { line_colors[i] = color_to_uint(colors[i]); }
+  kr_g2_set_font(font->data, font->size);
+  return kr_g2_draw_text_line(texts, line_colors, count, x, y);
+}
@@ -17,12 +17,15 @@ typedef enum { FONT_STYLE_BOLD = 1, FONT_STYLE_ITALIC = 2, FONT_STYLE_UNDERLINE
 typedef struct { uint8_t b, g, r, a; } RenColor;
 typedef struct { int x, y, width, height; } RenRect;
 
+#define REN_MAX_LINE_TOKENS 256
+
 
 void ren_init(void);
 void ren_update_rects(RenRect *rects, int count);
 void ren_set_clip_rect(RenRect rect);
 void ren_pop_clip_rect(void);
 void ren_get_size(int *x, int *y);
+void ren_scroll_rect(RenRect rect, int dy);
 
 RenImage* ren_new_image(int width, int height);
 void ren_free_image(RenImage *image);
@@ -32,12 +35,16 @@ void ren_free_font(RenFont *font);
 void ren_set_font_tab_width(RenFont *font, int n);
 int ren_get_font_tab_width(RenFont *font);
 int ren_get_font_width(RenFont *font, const char *text);
+float ren_get_font_advance(RenFont *font, const char *text, int len, float x);
 int ren_get_font_height(RenFont *font);
+const char* ren_get_font_path(RenFont *font);
 
 void ren_begin_frame(void);
 void ren_end_frame(void);
+void ren_present(void);
 void ren_draw_rect(RenRect rect, RenColor color);
 void ren_draw_image(RenImage *image, RenRect *sub, int x, int y, RenColor color);
 int ren_draw_text(RenFont *font, const char *text, int x, int y, RenColor color);
+int ren_draw_line(RenFont *font, const char **texts, const RenColor *colors, int count, int x, int y);
 
 #endif
@@ -1,15 +1,5 @@
 #include "graphics.h"
-#include "coloredpainter.h"
-#include "imagepainter.h"
-#include "sdfpainter.h"
-
-#ifdef KR_FULL_RGBA_FONTS
-#define kr_tsp_init()
-#define kr_tsp_set_projection_matrix(m)
-#define kr_tsp_end()
-#else
-#include "textpainter.h"
-#endif
+#include "uberpainter.h"
 
 #include <assert.h>
 #include <stdbool.h>
@@ -36,10 +26,7 @@ static int g2_last_height = -1;
 
 void kr_g2_init(void) {
 	if (!g2_painters_initialized) {
-		kr_isp_init();
-		kr_csp_init();
-		kr_tsp_init();
-		kr_sdf_init();
+		kr_usp_init();
 		g2_transformation = kr_matrix3x3_identity();
 	}
 }
@@ -61,10 +48,7 @@ static inline void internal_set_projection_matrix(int iwidth, int iheight) {
 		proj = kr_matrix4x4_orthogonal_projection(0.0f, width, height, 0.0f, 0.1f, 1000.0f);
 	}
 	g2_projection_matrix = kr_matrix4x4_to_kinc(&proj);
-	kr_isp_set_projection_matrix(g2_projection_matrix);
-	kr_tsp_set_projection_matrix(g2_projection_matrix);
-	kr_csp_set_projection_matrix(g2_projection_matrix);
-	kr_sdf_set_projection_matrix(g2_projection_matrix);
+	kr_usp_set_projection_matrix(g2_projection_matrix);
 }
 
 static void internal_update_projection_matrix(int window) {
@@ -95,10 +79,8 @@ void kr_g2_begin(int window) {
 
 void kr_g2_end(void) {
 	assert(begin && g2_active_window != -1);
-	kr_csp_end();
-	kr_tsp_end();
-	kr_isp_end();
-	kr_sdf_end();
+	kr_usp_end();
+	kr_usp_next_frame();
 	begin = false;
 	g2_active_window = -1;
 }
@@ -110,9 +92,13 @@ void kr_g2_set_render_target_dim(int width, int height) {
 
 void kr_g2_reset_render_target_dim(void) {
 	assert(begin && g2_active_window != -1);
-	int window = g2_active_window;
-	kr_g2_end();
-	kr_g2_begin(window);
+	kr_usp_end();
+	internal_update_projection_matrix(g2_active_window);
+}
+
+void kr_g2_flush(void) {
+	assert(begin);
+	kr_usp_end();
 }
 
 void kr_g2_clear(uint32_t color) {
@@ -130,28 +116,20 @@ void kr_g2_set_opacity(float opacity) {
 
 void kr_g2_draw_rect(float x, float y, float width, float height, float strength) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_sdf_end();
-
 	float hs = strength / 2.0f;
-	kr_csp_fill_rect(x - hs, y - hs, width + strength, strength, g2_color, g2_opacity,
+	kr_usp_fill_rect(x - hs, y - hs, width + strength, strength, g2_color, g2_opacity,
 	                 g2_transformation); // top
-	kr_csp_fill_rect(x - hs, y + hs, strength, height - strength, g2_color, g2_opacity,
+	kr_usp_fill_rect(x - hs, y + hs, strength, height - strength, g2_color, g2_opacity,
 	                 g2_transformation); // left
-	kr_csp_fill_rect(x - hs, y + height - hs, width + strength, strength, g2_color, g2_opacity,
+	kr_usp_fill_rect(x - hs, y + height - hs, width + strength, strength, g2_color, g2_opacity,
 	                 g2_transformation); // bottom
-	kr_csp_fill_rect(x + width - hs, y + hs, strength, height - strength, g2_color, g2_opacity,
+	kr_usp_fill_rect(x + width - hs, y + hs, strength, height - strength, g2_color, g2_opacity,
 	                 g2_transformation); // right
 }
 
 void kr_g2_fill_rect(float x, float y, float width, float height) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_sdf_end();
-
-	kr_csp_fill_rect(x, y, width, height, g2_color, g2_opacity, g2_transformation);
+	kr_usp_fill_rect(x, y, width, height, g2_color, g2_opacity, g2_transformation);
 }
 
 typedef struct center_radius {
@@ -181,10 +159,6 @@ static kr_vec2_t comp_corner(float x, float y, center_radius_t c, float f) {
 void kr_g2_draw_triangle(float x1, float y1, float x2, float y2, float x3, float y3,
                          float strength) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_sdf_end();
-
 	center_radius_t c = barycenter(x1, y1, x2, y2, x3, y3);
 	float s = (strength / 2.0f) / c.r;
 	kr_vec2_t ia, ib, ic, oa, ob, oc;
@@ -205,41 +179,27 @@ void kr_g2_draw_triangle(float x1, float y1, float x2, float y2, float x3, float
 
 void kr_g2_fill_triangle(float x1, float y1, float x2, float y2, float x3, float y3) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_sdf_end();
-
-	kr_csp_fill_triangle(x1, y1, x2, y2, x3, y3, g2_color, g2_opacity, g2_transformation);
+	kr_usp_fill_triangle(x1, y1, x2, y2, x3, y3, g2_color, g2_opacity, g2_transformation);
 }
 
 int kr_g2_draw_string(const char *text, float x, float y) {
 	assert(begin);
-#ifndef KR_FULL_RGBA_FONTS
-	kr_isp_end();
-#endif
-	kr_csp_end();
-	kr_sdf_end();
-
-	return kr_tsp_draw_string(text, g2_opacity, g2_color, x, y, g2_transformation);
+	return kr_usp_draw_string(text, g2_opacity, g2_color, x, y, g2_transformation);
 }
 
 int kr_g2_draw_characters(int *text, int start, int length, float x, float y) {
 	assert(begin);
-#ifndef KR_FULL_RGBA_FONTS
-	kr_isp_end();
-#endif
-	kr_csp_end();
-	kr_sdf_end();
+	return kr_usp_draw_characters(text, start, length, g2_opacity, g2_color, x, y, g2_transformation);
+}
 
-	return kr_tsp_draw_characters(text, start, length, g2_opacity, g2_color, x, y, g2_transformation);
+int kr_g2_draw_text_line(const char *const *texts, const uint32_t *colors, int count, float x,
+                         float y) {
+	assert(begin);
+	return kr_usp_draw_text_line(texts, colors, count, g2_opacity, x, y, g2_transformation);
 }
 
 void kr_g2_draw_line(float x1, float y1, float x2, float y2, float strength) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_sdf_end();
-
 	kr_vec2_t vec;
 
 	if (y2 == y1) {
@@ -255,20 +215,16 @@ void kr_g2_draw_line(float x1, float y1, float x2, float y2, float strength) {
 	kr_vec2_t p2 = (kr_vec2_t){x2 + 0.5f * vec.x, y2 + 0.5f * vec.y};
 	kr_vec2_t p3 = kr_vec2_subv(p1, vec);
 	kr_vec2_t p4 = kr_vec2_subv(p2, vec);
-	kr_csp_fill_triangle(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y, g2_color, g2_opacity,
+	kr_usp_fill_triangle(p1.x, p1.y, p2.x, p2.y, p3.x, p3.y, g2_color, g2_opacity,
 	                     g2_transformation);
-	kr_csp_fill_triangle(p3.x, p3.y, p2.x, p2.y, p4.x, p4.y, g2_color, g2_opacity,
+	kr_usp_fill_triangle(p3.x, p3.y, p2.x, p2.y, p4.x, p4.y, g2_color, g2_opacity,
 	                     g2_transformation);
 }
 
 void kr_g2_draw_scaled_sub_image(kr_image_t *img, float sx, float sy, float sw, float sh, float dx,
                                  float dy, float dw, float dh) {
 	assert(begin);
-	kr_csp_end();
-	kr_tsp_end();
-	kr_sdf_end();
-
-	kr_isp_draw_scaled_sub_image(img, sx, sy, sw, sh, dx, dy, dw, dh, g2_opacity, g2_color,
+	kr_usp_draw_scaled_sub_image(img, sx, sy, sw, sh, dx, dy, dw, dh, g2_opacity, g2_color,
 	                             g2_transformation);
 }
 
@@ -291,70 +247,47 @@ int kr_g2_get_font_size(void) {
 void kr_g2_set_font(kr_ttf_font_t *font, int size) {
 	g2_font = font;
 	g2_font_size = size;
-	kr_tsp_set_font(font);
-	kr_tsp_set_font_size(size);
+	kr_usp_set_font(font);
+	kr_usp_set_font_size(size);
 }
 
 void kr_g2_draw_sdf_rect(float x, float y, float width, float height, kr_sdf_corner_radius_t corner,
                          float border, uint32_t border_color, float smooth) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_csp_end();
-
-	kr_sdf_draw_rect(x, y, width, height, corner, border, smooth, g2_color, border_color,
-	                 g2_opacity, g2_transformation);
+	kr_usp_draw_sdf_rect(x, y, width, height, corner, border, smooth, g2_color, border_color,
+	                     g2_opacity, g2_transformation);
 }
 
 void kr_g2_draw_sdf_rect_symm(float x, float y, float width, float height, float corner,
                               float border, uint32_t border_color, float smooth) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_csp_end();
-
-	kr_sdf_draw_rect_symm(x, y, width, height, corner, border, smooth, g2_color, border_color,
-	                      g2_opacity, g2_transformation);
+	kr_usp_draw_sdf_rect(x, y, width, height,
+	                     (kr_sdf_corner_radius_t){corner, corner, corner, corner}, border, smooth,
+	                     g2_color, border_color, g2_opacity, g2_transformation);
 }
 
 void kr_g2_draw_sdf_circle(float x, float y, float r, float border, uint32_t border_color,
                            float smooth) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_csp_end();
-
-	kr_sdf_draw_circle(x, y, r, border, smooth, g2_color, border_color, g2_opacity,
-	                   g2_transformation);
+	kr_usp_draw_sdf_circle(x, y, r, border, smooth, g2_color, border_color, g2_opacity,
+	                       g2_transformation);
 }
 
 void kr_g2_draw_sdf_line(float x1, float y1, float x2, float y2, float strength, float smooth) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_csp_end();
-
-	kr_sdf_draw_line(x1, y1, x2, y2, strength, smooth, g2_color, g2_opacity, g2_transformation);
+	kr_usp_draw_sdf_line(x1, y1, x2, y2, strength, smooth, g2_color, g2_opacity, g2_transformation);
 }
 
 void kr_g2_scissor(float x, float y, float w, float h) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_csp_end();
-	kr_sdf_end();
-	kinc_g4_scissor((int)(x + 0.5f), (int)(y + 0.5f), (int)(w + 0.5f), (int)(h + 0.5f));
+	kr_usp_set_clip_rect(x, y, w, h);
 }
 
 void kr_g2_disable_scissor(void) {
 	assert(begin);
-	kr_isp_end();
-	kr_tsp_end();
-	kr_csp_end();
-	kr_sdf_end();
-	kinc_g4_disable_scissor();
+	kr_usp_disable_clip_rect();
 }
 
 void kr_g2_set_bilinear_filter(bool bilinear) {
-	kr_isp_set_bilinear_filter(bilinear);
+	kr_usp_set_bilinear_filter(bilinear);
 }
@@ -1,5 +1,5 @@
 #pragma once
-#include "sdfpainter.h"
+#include "uberpainter.h"
 #include "ttf.h"
 #include <kinc/global.h>
 #include <krink/image.h>
@@ -22,11 +22,15 @@
    \note Calling `kinc_g4_begin` and `kinc_g4_end` of the windows to be rendered to
    is the users responsibility.
 
+   \brief All primitives are drawn by a single batching painter (see uberpainter.h), so switching
+   between shapes, text and images does not end the current batch. Scissor rects are applied per
+   vertex as well, so only running out of texture units, clip rects or vertex buffer space does.
+
    \brief If KR_FULL_RGBA_FONTS is defined, krink will generate all ttf
-   fonts as full RGBA textures and use the same pipeline for text that is also used for images.
+   fonts as full RGBA textures and shade text the same way as images.
 
    \note This is meant to be used in cases where all assets, including fonts are stored in a single
-   texture atlas and thus further optimizes batching of draw calls by not having to switch pipeline,
+   texture atlas and thus further optimizes batching of draw calls by not having to switch textures,
    at the cost of more VRAM being used.
 */
 
@@ -68,6 +72,12 @@ void kr_g2_reset_render_target_dim(void);
 /// </summary>
 void kr_g2_end(void);
 
+/// <summary>
+/// Draws all pending primitives. Needs to be called before switching render-targets in between
+/// `kr_g2_begin` and `kr_g2_end`.
+/// </summary>
+void kr_g2_flush(void);
+
 /// <summary>
 /// Clears the color, depth and/or stencil-components of the current framebuffer or render-target.
 /// </summary>
@@ -147,6 +157,19 @@ int kr_g2_draw_string(const char *text, float x, float y);
 /// <param name="y"></param>
 int kr_g2_draw_characters(int *text, int start, int length, float x, float y);
 
+/// <summary>
+/// Draw a line of strings in different colors, each one starting where the previous one ended
+/// (rounded to whole pixels). The glyphs of the line are cached, so drawing an unchanged line again
+/// at another position is cheap.
+/// </summary>
+/// <param name="texts">Array of null terminated UTF-8 strings</param>
+/// <param name="colors">Color of each string</param>
+/// <param name="count">Number of strings</param>
+/// <param name="x"></param>
+/// <param name="y"></param>
+int kr_g2_draw_text_line(const char *const *texts, const uint32_t *colors, int count, float x,
+                         float y);
+
 /// <summary>
 /// Draw a line.
 /// </summary>
@@ -255,7 +278,8 @@ void kr_g2_draw_sdf_circle(float x, float y, float r, float border, uint32_t bor
 void kr_g2_draw_sdf_line(float x1, float y1, float x2, float y2, float strength, float smooth);
 
 /// <summary>
-/// Enable scissor.
+/// Clip following drawing operations to a rect. Clipping is done per vertex, so changing it does
+/// not end the current batch.
 /// </summary>
 /// <param name="x"></param>
 /// <param name="y"></param>
@@ -264,7 +288,7 @@ void kr_g2_draw_sdf_line(float x1, float y1, float x2, float y2, float strength,
 void kr_g2_scissor(float x, float y, float w, float h);
 
 /// <summary>
-/// Disable scissor.
+/// Stop clipping following drawing operations.
 /// </summary>
 void kr_g2_disable_scissor(void);
 
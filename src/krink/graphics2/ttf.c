@@ -14,6 +14,8 @@
 #define KR_FONT_IMAGE_FORMAT KINC_IMAGE_FORMAT_GREY8
 #endif
 
+#define KR_TTF_MAX_DIRTY_PAGES 32
+
 static int *kr_ttf_glyph_blocks = NULL;
 static int *kr_ttf_glyphs = NULL;
 static int kr_ttf_num_glyph_blocks = -1;
@@ -44,35 +46,309 @@ kr_ttf_image_t *kr_ttf_get_image_internal(kr_ttf_font_t *font, int size) {
 	return NULL;
 }
 
-int kr_ttf_get_char_index_internal(kr_ttf_image_t *img, int char_index) {
-	if (kr_ttf_num_glyphs <= 0) {
-		return 0;
+static int kr_ttf_get_baked_index_internal(int codepoint) {
+	int base = 0;
+	for (int i = 0; i < kr_ttf_num_glyph_blocks; i += 2) {
+		int start = kr_ttf_glyph_blocks[i];
+		int end = kr_ttf_glyph_blocks[i + 1];
+		if (codepoint < start) return -1;
+		if (codepoint <= end) return base + codepoint - start;
+		base += end - start + 1;
+	}
+	return -1;
+}
+
+// Atlas pages are stamped with the current epoch whenever one of their glyphs is handed out. The
+// epoch advances in kr_ttf_upload_pages, right before the painter draws, so only pages which are
+// not referenced by pending quads can be evicted.
+static unsigned kr_ttf_epoch = 1;
+static kr_ttf_page_t *kr_ttf_dirty_pages[KR_TTF_MAX_DIRTY_PAGES];
+// generations are unique across all images, so one never matches an image destroyed earlier
+static unsigned kr_ttf_generation = 0;
+static int kr_ttf_num_dirty_pages = 0;
+
+static void kr_ttf_upload_page_internal(kr_ttf_page_t *page) {
+	uint8_t *data = kinc_g4_texture_lock(&page->tex);
+	int stride = kinc_g4_texture_stride(&page->tex);
+	for (int y = 0; y < KR_TTF_PAGE_SIZE; ++y) {
+		uint8_t *row = data + y * stride;
+		unsigned char *src = page->pixels + y * KR_TTF_PAGE_SIZE;
+#ifdef KR_FULL_RGBA_FONTS
+		for (int x = 0; x < KR_TTF_PAGE_SIZE; ++x) {
+			row[x * 4 + 0] = 255;
+			row[x * 4 + 1] = 255;
+			row[x * 4 + 2] = 255;
+			row[x * 4 + 3] = src[x];
+		}
+#else
+		memcpy(row, src, KR_TTF_PAGE_SIZE);
+#endif
 	}
-	int offset = kr_ttf_glyph_blocks[0];
-	if (char_index < offset) return 0;
+	kinc_g4_texture_unlock(&page->tex);
+	page->dirty = false;
+}
 
-	for (int i = 1; i < kr_ttf_num_glyph_blocks / 2; ++i) {
-		int prev_end = kr_ttf_glyph_blocks[i * 2 - 1];
-		int start = kr_ttf_glyph_blocks[i * 2];
-		if (char_index > start - 1) offset += start - 1 - prev_end;
+static void kr_ttf_mark_dirty_internal(kr_ttf_page_t *page) {
+	if (page->dirty) return;
+	if (kr_ttf_num_dirty_pages == KR_TTF_MAX_DIRTY_PAGES) {
+		for (int i = 0; i < kr_ttf_num_dirty_pages; ++i)
+			kr_ttf_upload_page_internal(kr_ttf_dirty_pages[i]);
+		kr_ttf_num_dirty_pages = 0;
 	}
+	kr_ttf_dirty_pages[kr_ttf_num_dirty_pages++] = page;
+	page->dirty = true;
+}
+
+void kr_ttf_upload_pages(void) {
+	for (int i = 0; i < kr_ttf_num_dirty_pages; ++i)
+		kr_ttf_upload_page_internal(kr_ttf_dirty_pages[i]);
+	kr_ttf_num_dirty_pages = 0;
+	++kr_ttf_epoch;
+}
 
-	if (char_index - offset >= kr_ttf_num_glyphs) return 0;
-	return char_index - offset;
+static void kr_ttf_page_clear_internal(kr_ttf_page_t *page) {
+	memset(page->pixels, 0, KR_TTF_PAGE_SIZE * KR_TTF_PAGE_SIZE);
+	page->num_shelves = 0;
+	page->next_y = 0;
+	kr_ttf_mark_dirty_internal(page);
 }
 
-float kr_ttf_get_char_width_internal(kr_ttf_image_t *img, int char_index) {
-	return img->chars[kr_ttf_get_char_index_internal(img, char_index)].xadvance;
+static void kr_ttf_page_destroy_internal(kr_ttf_page_t *page) {
+	for (int i = 0; i < kr_ttf_num_dirty_pages; ++i) {
+		if (kr_ttf_dirty_pages[i] == page) {
+			kr_ttf_dirty_pages[i] = kr_ttf_dirty_pages[--kr_ttf_num_dirty_pages];
+			break;
+		}
+	}
+	kinc_g4_texture_destroy(&page->tex);
+	kr_free(page->pixels);
+	kr_free(page);
 }
 
-float kr_ttf_get_string_width_internal(kr_ttf_image_t *img, const char *str) {
+// Finds room for a w*h rectangle. Prefers the tightest existing shelf and opens a new one if
+// that would waste more than half of the glyph height.
+static bool kr_ttf_page_pack_internal(kr_ttf_page_t *page, int w, int h, int *x, int *y) {
+	kr_ttf_shelf_t *best = NULL;
+	for (int i = 0; i < page->num_shelves; ++i) {
+		kr_ttf_shelf_t *shelf = &page->shelves[i];
+		if (shelf->height < h || shelf->x + w > KR_TTF_PAGE_SIZE) continue;
+		if (best == NULL || shelf->height < best->height) best = shelf;
+	}
+	if ((best == NULL || best->height > h + h / 2) && page->num_shelves < KR_TTF_MAX_SHELVES &&
+	    page->next_y + h <= KR_TTF_PAGE_SIZE && w <= KR_TTF_PAGE_SIZE) {
+		best = &page->shelves[page->num_shelves++];
+		best->y = page->next_y;
+		best->height = h;
+		best->x = 0;
+		page->next_y += h;
+	}
+	if (best == NULL) return false;
+	*x = best->x;
+	*y = best->y;
+	best->x += w;
+	return true;
+}
+
+static void kr_ttf_glyph_put_internal(kr_ttf_image_t *img, const kr_ttf_glyph_t *glyph) {
+	unsigned mask = (unsigned)img->glyphs_capacity - 1;
+	unsigned i = ((unsigned)glyph->codepoint * 2654435761u) & mask;
+	while (img->glyphs[i].codepoint != 0) i = (i + 1) & mask;
+	img->glyphs[i] = *glyph;
+	img->glyphs_len += 1;
+}
+
+// Rebuilds the glyph table with the given capacity, dropping all glyphs that live on
+// `evicted_page`.
+static void kr_ttf_glyphs_rehash_internal(kr_ttf_image_t *img, int capacity, int evicted_page) {
+	kr_ttf_glyph_t *old = img->glyphs;
+	int old_capacity = img->glyphs_capacity;
+	img->glyphs = (kr_ttf_glyph_t *)kr_calloc(capacity, sizeof(kr_ttf_glyph_t));
+	assert(img->glyphs != NULL);
+	img->glyphs_capacity = capacity;
+	img->glyphs_len = 0;
+	for (int i = 0; i < old_capacity; ++i) {
+		if (old[i].codepoint == 0) continue;
+		if (evicted_page >= 0 && old[i].page == evicted_page) continue;
+		kr_ttf_glyph_put_internal(img, &old[i]);
+	}
+	if (old != NULL) kr_free(old);
+}
+
+static kr_ttf_glyph_t *kr_ttf_glyph_find_internal(kr_ttf_image_t *img, int codepoint) {
+	if (img->glyphs_capacity == 0) return NULL;
+	unsigned mask = (unsigned)img->glyphs_capacity - 1;
+	unsigned i = ((unsigned)codepoint * 2654435761u) & mask;
+	while (img->glyphs[i].codepoint != 0) {
+		if (img->glyphs[i].codepoint == codepoint) return &img->glyphs[i];
+		i = (i + 1) & mask;
+	}
+	return NULL;
+}
+
+static kr_ttf_page_t *kr_ttf_page_alloc_internal(kr_ttf_image_t *img, int w, int h, int *x, int *y,
+                                                 int *page_index) {
+	for (int i = img->num_pages - 1; i >= 0; --i) {
+		if (kr_ttf_page_pack_internal(img->pages[i], w, h, x, y)) {
+			*page_index = i;
+			return img->pages[i];
+		}
+	}
+
+	// all pages are full, recycle the least recently used one unless it is still referenced
+	int index = -1;
+	if (img->num_pages >= KR_TTF_MAX_PAGES) {
+		unsigned oldest = kr_ttf_epoch;
+		for (int i = 0; i < img->num_pages; ++i) {
+			if (img->pages[i]->last_used < oldest) {
+				oldest = img->pages[i]->last_used;
+				index = i;
+			}
+		}
+	}
+
+	if (index >= 0) {
+		img->generation = ++kr_ttf_generation;
+		kr_ttf_page_clear_internal(img->pages[index]);
+		kr_ttf_glyphs_rehash_internal(img, img->glyphs_capacity, index);
+	}
+	else {
+		size_t pages_size = (img->num_pages + 1) * sizeof(kr_ttf_page_t *);
+		if (img->pages == NULL)
+			img->pages = (kr_ttf_page_t **)kr_malloc(pages_size);
+		else
+			img->pages = (kr_ttf_page_t **)kr_realloc(img->pages, pages_size);
+		assert(img->pages != NULL);
+		kr_ttf_page_t *page = (kr_ttf_page_t *)kr_malloc(sizeof(kr_ttf_page_t));
+		assert(page != NULL);
+		page->pixels = (unsigned char *)kr_malloc(KR_TTF_PAGE_SIZE * KR_TTF_PAGE_SIZE);
+		assert(page->pixels != NULL);
+		page->dirty = false;
+		page->last_used = 0;
+		kinc_g4_texture_init(&page->tex, KR_TTF_PAGE_SIZE, KR_TTF_PAGE_SIZE, KR_FONT_IMAGE_FORMAT);
+		kr_ttf_page_clear_internal(page);
+		index = img->num_pages++;
+		img->pages[index] = page;
+	}
+
+	if (!kr_ttf_page_pack_internal(img->pages[index], w, h, x, y)) return NULL;
+	*page_index = index;
+	return img->pages[index];
+}
+
+static kr_ttf_glyph_t *kr_ttf_rasterize_glyph_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                                       int codepoint) {
+	if (font->blob == NULL || codepoint <= 0) return NULL;
+
+	stbtt_fontinfo *info = &font->info;
+	int index = stbtt_FindGlyphIndex(info, codepoint);
+	int advance, lsb, x0, y0, x1, y1;
+	stbtt_GetGlyphHMetrics(info, index, &advance, &lsb);
+	stbtt_GetGlyphBitmapBox(info, index, img->scale, img->scale, &x0, &y0, &x1, &y1);
+
+	kr_ttf_glyph_t glyph;
+	memset(&glyph, 0, sizeof(glyph));
+	glyph.codepoint = codepoint;
+	glyph.page = -1;
+	glyph.baked.xoff = (float)x0;
+	glyph.baked.yoff = (float)(y0 + img->scaled_ascent);
+	glyph.baked.xadvance = floor(img->scale * advance);
+
+	int w = x1 - x0;
+	int h = y1 - y0;
+	if (w > 0 && h > 0) {
+		int x, y;
+		// one pixel of padding keeps neighbouring glyphs from bleeding into each other
+		kr_ttf_page_t *page = kr_ttf_page_alloc_internal(img, w + 1, h + 1, &x, &y, &glyph.page);
+		if (page != NULL) {
+			stbtt_MakeGlyphBitmap(info, page->pixels + y * KR_TTF_PAGE_SIZE + x, w, h,
+			                      KR_TTF_PAGE_SIZE, img->scale, img->scale, index);
+			glyph.baked.x0 = x;
+			glyph.baked.y0 = y;
+			glyph.baked.x1 = x + w;
+			glyph.baked.y1 = y + h;
+			kr_ttf_mark_dirty_internal(page);
+		}
+		else {
+			glyph.page = -1;
+		}
+	}
+
+	if ((img->glyphs_len + 1) * 4 > img->glyphs_capacity * 3)
+		kr_ttf_glyphs_rehash_internal(img, img->glyphs_capacity == 0 ? 64 : img->glyphs_capacity * 2,
+		                              -1);
+	kr_ttf_glyph_put_internal(img, &glyph);
+	return kr_ttf_glyph_find_internal(img, codepoint);
+}
+
+// Returns the glyph for a codepoint and the texture it lives in, rasterizing it if necessary.
+static const stbtt_bakedchar *kr_ttf_get_glyph_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                                        int codepoint, kinc_g4_texture_t **tex) {
+	if (tex != NULL) *tex = img->tex;
+	if (codepoint == '\t') return &img->tab;
+	if (codepoint == '\n') return &img->newline;
+
+	int index = kr_ttf_get_baked_index_internal(codepoint);
+	if (index >= 0) return &img->chars[index];
+
+	kr_ttf_glyph_t *glyph = kr_ttf_glyph_find_internal(img, codepoint);
+	if (glyph == NULL) glyph = kr_ttf_rasterize_glyph_internal(font, img, codepoint);
+	if (glyph == NULL) return NULL;
+	if (glyph->page >= 0) {
+		kr_ttf_page_t *page = img->pages[glyph->page];
+		page->last_used = kr_ttf_epoch;
+		if (tex != NULL) *tex = &page->tex;
+	}
+	return &glyph->baked;
+}
+
+static float kr_ttf_get_char_width_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                            int codepoint) {
+	const stbtt_bakedchar *b = kr_ttf_get_glyph_internal(font, img, codepoint, NULL);
+	return b != NULL ? b->xadvance : 0.0f;
+}
+
+static float kr_ttf_get_string_width_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                              const char *str) {
 	float width = 0.0f;
-	for (int i = 0; str[i] != 0; ++i) {
-		width += kr_ttf_get_char_width_internal(img, str[i]);
+	while (*str != 0) {
+		int codepoint;
+		str = kr_ttf_utf8_next(str, &codepoint);
+		width += kr_ttf_get_char_width_internal(font, img, codepoint);
 	}
 	return width;
 }
 
+static void kr_ttf_use_pages_internal(kr_ttf_image_t *img, unsigned pages) {
+	for (int i = 0; i < img->num_pages && i < 32; ++i) {
+		if (pages & (1u << i)) img->pages[i]->last_used = kr_ttf_epoch;
+	}
+}
+
+static const kr_ttf_run_t *kr_ttf_get_run_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                                   const char *str);
+
+const char *kr_ttf_utf8_next(const char *str, int *codepoint) {
+	const unsigned char *p = (const unsigned char *)str;
+	int c = *p++;
+	int n = 0;
+	if (c >= 0xf0) {
+		c &= 0x07;
+		n = 3;
+	}
+	else if (c >= 0xe0) {
+		c &= 0x0f;
+		n = 2;
+	}
+	else if (c >= 0xc0) {
+		c &= 0x1f;
+		n = 1;
+	}
+	// stop at truncated sequences instead of reading past the terminator
+	while (n-- > 0 && (*p & 0xc0) == 0x80) c = (c << 6) | (*p++ & 0x3f);
+	*codepoint = c;
+	return (const char *)p;
+}
+
 void kr_ttf_init(int *glyphs, int num_glyphs) {
 	if (glyphs == NULL) {
 		kr_ttf_glyph_blocks = (int *)kr_malloc(2 * sizeof(int));
@@ -136,6 +412,7 @@ void kr_ttf_font_init(kr_ttf_font_t *font, const char *fontpath, int font_index)
 	if (font->offset == -1) {
 		font->offset = stbtt_GetFontOffsetForIndex(font->blob, 0);
 	}
+	stbtt_InitFont(&font->info, font->blob, font->offset);
 }
 
 void kr_ttf_font_init_empty(kr_ttf_font_t *font) {
@@ -155,7 +432,7 @@ static inline bool prepare_font_load(kr_ttf_font_t *font, int size) {
 			font->images = (kr_ttf_image_t *)kr_malloc(new_capacity * sizeof(kr_ttf_image_t));
 		}
 		else {
-			while (font->m_capacity > new_capacity) new_capacity *= 2;
+			while (font->m_capacity >= new_capacity) new_capacity *= 2;
 			font->images =
 			    (kr_ttf_image_t *)kr_realloc(font->images, new_capacity * sizeof(kr_ttf_image_t));
 		}
@@ -166,11 +443,20 @@ static inline bool prepare_font_load(kr_ttf_font_t *font, int size) {
 	return true;
 }
 
+static void kr_ttf_image_init_glyphs_internal(kr_ttf_image_t *img) {
+	img->glyphs = NULL;
+	img->glyphs_capacity = 0;
+	img->glyphs_len = 0;
+	img->pages = NULL;
+	img->num_pages = 0;
+	img->generation = ++kr_ttf_generation;
+	img->runs = NULL;
+}
+
 float kr_ttf_load(kr_ttf_font_t *font, int size) {
-	if (!prepare_font_load(font, size)) return;
+	if (!prepare_font_load(font, size)) return kr_ttf_get_image_internal(font, size)->scale;
 
-	stbtt_fontinfo info;
-	stbtt_InitFont(&info, font->blob, font->offset);
+	stbtt_fontinfo *info = &font->info;
 
 	// create image
 	kr_ttf_image_t *img = &(font->images[font->m_images_len]);
@@ -180,9 +466,7 @@ float kr_ttf_load(kr_ttf_font_t *font, int size) {
 	stbtt_bakedchar *baked =
 	    (stbtt_bakedchar *)kr_malloc(kr_ttf_num_glyphs * sizeof(stbtt_bakedchar));
 	assert(baked != NULL);
-	 float s =
-    stbtt_ScaleForMappingEmToPixels(&info, 1) /
-    stbtt_ScaleForPixelHeight(&info, 1);
+	float s = stbtt_ScaleForMappingEmToPixels(info, 1) / stbtt_ScaleForPixelHeight(info, 1);
 	unsigned char *pixels = NULL;
 	int status = -1;
 	while (status <= 0) {
@@ -215,14 +499,9 @@ float kr_ttf_load(kr_ttf_font_t *font, int size) {
 	kr_free(pixels);
 	pixels = color_pixels;
 #endif
-	baked['\t'].x1 = baked['\t'].x0;
-  	baked['\n'].x1 = baked['\n'].x0;
-
-	// stbtt_fontinfo info;
-	// stbtt_InitFont(&info, font->blob, font->offset);
 	int ascent, descent, line_gap;
-	stbtt_GetFontVMetrics(&info, &ascent, &descent, &line_gap);
-	float scale = stbtt_ScaleForMappingEmToPixels(&info, (float)size);
+	stbtt_GetFontVMetrics(info, &ascent, &descent, &line_gap);
+	float scale = stbtt_ScaleForMappingEmToPixels(info, (float)size);
 	int scaled_ascent = ascent * scale + 0.5;
 	for (int i = 0; i < kr_ttf_num_glyphs; i++) {
 		baked[i].yoff += scaled_ascent;
@@ -237,6 +516,17 @@ float kr_ttf_load(kr_ttf_font_t *font, int size) {
 	img->chars = baked;
 	img->owns_tex = true;
 	img->first_unused_y = status;
+	img->scale = scale;
+	img->scaled_ascent = scaled_ascent;
+	kr_ttf_image_init_glyphs_internal(img);
+
+	// tab and newline are never drawn, tabs default to the width of a space
+	int space_advance, space_lsb;
+	stbtt_GetCodepointHMetrics(info, ' ', &space_advance, &space_lsb);
+	memset(&img->tab, 0, sizeof(img->tab));
+	img->tab.xadvance = floor(space_advance * scale);
+	img->newline = img->tab;
+
 	kinc_image_t fontimg;
 	kinc_image_init_from_bytes(&fontimg, pixels, width, height, KR_FONT_IMAGE_FORMAT);
 	img->tex = (kinc_g4_texture_t *)kr_malloc(sizeof(kinc_g4_texture_t));
@@ -274,6 +564,11 @@ void kr_ttf_load_baked_font(kr_ttf_font_t *font, kr_ttf_font_t *origin, int size
 	}
 	img->owns_tex = true;
 	img->tex = tex;
+	img->scale = origin_img->scale;
+	img->scaled_ascent = origin_img->scaled_ascent;
+	img->tab = origin_img->tab;
+	img->newline = origin_img->newline;
+	kr_ttf_image_init_glyphs_internal(img);
 }
 
 float kr_ttf_height(kr_ttf_font_t *font, int size) {
@@ -285,7 +580,21 @@ float kr_ttf_height(kr_ttf_font_t *font, int size) {
 float kr_ttf_width(kr_ttf_font_t *font, int size, const char *str) {
 	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
 	assert(img != NULL);
-	return kr_ttf_get_string_width_internal(img, str);
+	const kr_ttf_run_t *run = kr_ttf_get_run_internal(font, img, str);
+	if (run != NULL) return run->width;
+	return kr_ttf_get_string_width_internal(font, img, str);
+}
+
+float kr_ttf_advance(kr_ttf_font_t *font, int size, const char *str, int length, float x) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	const char *end = str + length;
+	while (str < end) {
+		int codepoint;
+		str = kr_ttf_utf8_next(str, &codepoint);
+		x += kr_ttf_get_char_width_internal(font, img, codepoint);
+	}
+	return x;
 }
 
 float kr_ttf_width_of_characters(kr_ttf_font_t *font, int size, int *characters, int start,
@@ -294,7 +603,7 @@ float kr_ttf_width_of_characters(kr_ttf_font_t *font, int size, int *characters,
 	assert(img != NULL);
 	float width = 0.0f;
 	for (int i = start; i < start + length; ++i) {
-		width += kr_ttf_get_char_width_internal(img, characters[i]);
+		width += kr_ttf_get_char_width_internal(font, img, characters[i]);
 	}
 	return width;
 }
@@ -317,16 +626,15 @@ float kr_ttf_line_gap(kr_ttf_font_t *font, int size) {
 	return img->line_gap;
 }
 
-bool kr_ttf_get_baked_quad(kr_ttf_font_t *font, int size, kr_ttf_aligned_quad_t *q, int char_code,
-                           float xpos, float ypos) {
-	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
-	assert(img != NULL);
-	int char_index = kr_ttf_get_char_index_internal(img, char_code);
-	if (char_index >= kr_ttf_num_glyphs) return false;
-	float ipw = 1.0f / (float)img->width;
-	float iph = 1.0f / (float)img->height;
-	stbtt_bakedchar b = img->chars[char_index & 0xff];
-	// if (b == NULL) return null;
+static bool kr_ttf_get_quad_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                     kr_ttf_aligned_quad_t *q, int char_code, float xpos,
+                                     float ypos) {
+	kinc_g4_texture_t *tex;
+	const stbtt_bakedchar *glyph = kr_ttf_get_glyph_internal(font, img, char_code, &tex);
+	if (glyph == NULL) return false;
+	stbtt_bakedchar b = *glyph;
+	float ipw = 1.0f / (float)(tex == img->tex ? img->width : KR_TTF_PAGE_SIZE);
+	float iph = 1.0f / (float)(tex == img->tex ? img->height : KR_TTF_PAGE_SIZE);
 	int round_x = (int)(xpos + b.xoff + 0.5);
 	int round_y = (int)(ypos + b.yoff + 0.5);
 
@@ -341,10 +649,128 @@ bool kr_ttf_get_baked_quad(kr_ttf_font_t *font, int size, kr_ttf_aligned_quad_t
 	q->t1 = b.y1 * iph;
 
 	q->xadvance = b.xadvance;
+	q->tex = tex;
 
 	return true;
 }
 
+bool kr_ttf_get_baked_quad(kr_ttf_font_t *font, int size, kr_ttf_aligned_quad_t *q, int char_code,
+                           float xpos, float ypos) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	return kr_ttf_get_quad_internal(font, img, q, char_code, xpos, ypos);
+}
+
+static kr_ttf_aligned_quad_t kr_ttf_run_quads[KR_TTF_MAX_RUN_LENGTH];
+
+static uint64_t kr_ttf_run_hash_internal(const char *str, int length, float tab_width) {
+	uint64_t hash = 14695981039346656037ull;
+	for (int i = 0; i < length; ++i) {
+		hash ^= (unsigned char)str[i];
+		hash *= 1099511628211ull;
+	}
+	hash ^= (uint64_t)(int)tab_width;
+	hash *= 1099511628211ull;
+	return hash;
+}
+
+static bool kr_ttf_run_build_internal(kr_ttf_font_t *font, kr_ttf_image_t *img, kr_ttf_run_t *run,
+                                      const char *str) {
+	int num_quads = 0;
+	unsigned pages = 0;
+	float xpos = 0.0f;
+	const char *p = str;
+	while (*p != 0) {
+		int codepoint;
+		p = kr_ttf_utf8_next(p, &codepoint);
+
+		kr_ttf_aligned_quad_t q;
+		if (!kr_ttf_get_quad_internal(font, img, &q, codepoint, xpos, 0.0f)) continue;
+		xpos += q.xadvance;
+		if (q.x1 <= q.x0 || q.y1 <= q.y0) continue;
+		if (q.tex != img->tex) {
+			int page = 0;
+			while (page < img->num_pages && &img->pages[page]->tex != q.tex) ++page;
+			// runs can only track the first 32 pages
+			if (page >= 32) return false;
+			pages |= 1u << page;
+		}
+		kr_ttf_run_quads[num_quads++] = q;
+	}
+
+	int length = (int)(p - str);
+	char *block = (char *)kr_malloc(length + 1 + num_quads * sizeof(kr_ttf_aligned_quad_t));
+	assert(block != NULL);
+	run->quads = (kr_ttf_aligned_quad_t *)block;
+	run->text = block + num_quads * sizeof(kr_ttf_aligned_quad_t);
+	memcpy(run->quads, kr_ttf_run_quads, num_quads * sizeof(kr_ttf_aligned_quad_t));
+	memcpy(run->text, str, length + 1);
+	run->length = length;
+	run->num_quads = num_quads;
+	run->pages = pages;
+	run->width = xpos;
+	// rasterizing may have recycled a page, which invalidates older runs but not this one
+	run->generation = img->generation;
+	return true;
+}
+
+static const kr_ttf_run_t *kr_ttf_get_run_internal(kr_ttf_font_t *font, kr_ttf_image_t *img,
+                                                   const char *str) {
+	size_t length = strlen(str);
+	if (length > KR_TTF_MAX_RUN_LENGTH) return NULL;
+	float tab_width = img->tab.xadvance;
+	uint64_t hash = kr_ttf_run_hash_internal(str, (int)length, tab_width);
+
+	if (img->runs == NULL) {
+		img->runs = (kr_ttf_run_t *)kr_calloc(KR_TTF_RUN_CACHE_SIZE, sizeof(kr_ttf_run_t));
+		assert(img->runs != NULL);
+	}
+	kr_ttf_run_t *run = &img->runs[hash & (KR_TTF_RUN_CACHE_SIZE - 1)];
+	if (run->quads != NULL && run->hash == hash && run->length == (int)length &&
+	    run->tab_width == tab_width && run->generation == img->generation &&
+	    memcmp(run->text, str, length) == 0) {
+		kr_ttf_use_pages_internal(img, run->pages);
+		return run;
+	}
+
+	if (run->quads != NULL) kr_free(run->quads);
+	run->quads = NULL;
+	if (!kr_ttf_run_build_internal(font, img, run, str)) return NULL;
+	run->hash = hash;
+	run->tab_width = tab_width;
+	return run;
+}
+
+const kr_ttf_run_t *kr_ttf_get_run(kr_ttf_font_t *font, int size, const char *str) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	return kr_ttf_get_run_internal(font, img, str);
+}
+
+unsigned kr_ttf_get_generation(kr_ttf_font_t *font, int size) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	return img->generation;
+}
+
+void kr_ttf_use_pages(kr_ttf_font_t *font, int size, unsigned pages) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	kr_ttf_use_pages_internal(img, pages);
+}
+
+void kr_ttf_set_tab_width(kr_ttf_font_t *font, int size, float width) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	img->tab.xadvance = width;
+}
+
+float kr_ttf_get_tab_width(kr_ttf_font_t *font, int size) {
+	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
+	assert(img != NULL);
+	return img->tab.xadvance;
+}
+
 kinc_g4_texture_t *kr_ttf_get_texture(kr_ttf_font_t *font, int size) {
 	kr_ttf_image_t *img = kr_ttf_get_image_internal(font, size);
 	assert(img != NULL);
@@ -361,6 +787,16 @@ void kr_ttf_font_destroy(kr_ttf_font_t *font) {
 		// Only destroy textures we own
 		if (font->images[i].owns_tex) kinc_g4_texture_destroy(font->images[i].tex);
 		kr_free(font->images[i].chars);
+		for (int j = 0; j < font->images[i].num_pages; ++j)
+			kr_ttf_page_destroy_internal(font->images[i].pages[j]);
+		if (font->images[i].pages != NULL) kr_free(font->images[i].pages);
+		if (font->images[i].glyphs != NULL) kr_free(font->images[i].glyphs);
+		if (font->images[i].runs != NULL) {
+			for (int j = 0; j < KR_TTF_RUN_CACHE_SIZE; ++j) {
+				if (font->images[i].runs[j].quads != NULL) kr_free(font->images[i].runs[j].quads);
+			}
+			kr_free(font->images[i].runs);
+		}
 	}
 	kr_free(font->blob);
 	kr_free(font->images);
@@ -1,12 +1,75 @@
 #pragma once
 #include <kinc/graphics4/texture.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include "stb_truetype.h"
 
 /*! \file ttf.h
     \brief Provides a basic TrueType Font handling.
 */
 
+#ifndef KR_TTF_PAGE_SIZE
+#define KR_TTF_PAGE_SIZE 512
+#endif
+
+#ifndef KR_TTF_MAX_PAGES
+#define KR_TTF_MAX_PAGES 4
+#endif
+
+#define KR_TTF_MAX_SHELVES 64
+
+#ifndef KR_TTF_RUN_CACHE_SIZE
+#define KR_TTF_RUN_CACHE_SIZE 1024
+#endif
+
+#define KR_TTF_MAX_RUN_LENGTH 256
+
+typedef struct kr_ttf_shelf {
+	int y, height, x;
+} kr_ttf_shelf_t;
+
+/// <summary>
+/// A glyph atlas page. Glyphs outside of the baked glyph set are rasterized on first use and
+/// shelf-packed into pages of KR_TTF_PAGE_SIZE x KR_TTF_PAGE_SIZE pixels.
+/// </summary>
+typedef struct kr_ttf_page {
+	kinc_g4_texture_t tex;
+	unsigned char *pixels;
+	kr_ttf_shelf_t shelves[KR_TTF_MAX_SHELVES];
+	int num_shelves;
+	int next_y;
+	unsigned last_used;
+	bool dirty;
+} kr_ttf_page_t;
+
+typedef struct kr_ttf_glyph {
+	int codepoint; // 0 marks an empty slot
+	int page;      // -1 for glyphs without pixels
+	stbtt_bakedchar baked;
+} kr_ttf_glyph_t;
+
+typedef struct kr_ttf_aligned_quad {
+	float x0, y0, s0, t0; // top-left
+	float x1, y1, s1, t1; // bottom-right
+	float xadvance;
+	kinc_g4_texture_t *tex;
+} kr_ttf_aligned_quad_t;
+
+/// <summary>
+/// A measured and laid out string. Quads are relative to the pen origin and exclude blank glyphs.
+/// </summary>
+typedef struct kr_ttf_run {
+	uint64_t hash;
+	char *text;
+	int length;
+	float tab_width;
+	unsigned generation;
+	unsigned pages; // bitmask of atlas pages referenced by the quads
+	float width;
+	kr_ttf_aligned_quad_t *quads;
+	int num_quads;
+} kr_ttf_run_t;
+
 typedef struct kr_ttf_image {
 	float m_size;
 	stbtt_bakedchar *chars;
@@ -14,18 +77,22 @@ typedef struct kr_ttf_image {
 	int width, height, first_unused_y;
 	float baseline, descent, line_gap;
 	bool owns_tex;
+	float scale;
+	int scaled_ascent;
+	stbtt_bakedchar tab, newline;
+	kr_ttf_glyph_t *glyphs; // open addressing table of rasterized glyphs, keyed by codepoint
+	int glyphs_capacity, glyphs_len;
+	kr_ttf_page_t **pages;
+	int num_pages;
+	unsigned generation; // changes whenever an atlas page is recycled
+	kr_ttf_run_t *runs;  // direct mapped cache of KR_TTF_RUN_CACHE_SIZE runs
 } kr_ttf_image_t;
 
 typedef struct kr_ttf_image kr_ttf_image_t;
 
-typedef struct kr_ttf_aligned_quad {
-	float x0, y0, s0, t0; // top-left
-	float x1, y1, s1, t1; // bottom-right
-	float xadvance;
-} kr_ttf_aligned_quad_t;
-
 typedef struct kr_ttf_font {
 	unsigned char *blob;
+	stbtt_fontinfo info;
 	kr_ttf_image_t *images;
 	size_t m_capacity;
 	size_t m_images_len;
@@ -89,9 +156,21 @@ float kr_ttf_height(kr_ttf_font_t *font, int size);
 /// </summary>
 /// <param name="font">Pointer to your font object</param>
 /// <param name="size">Font height in pixel</param>
-/// <param name="str">Null terminated C string</param>
+/// <param name="str">Null terminated UTF-8 string</param>
 float kr_ttf_width(kr_ttf_font_t *font, int size, const char *str);
 
+/// <summary>
+/// Advances the pen position `x` over the first `length` bytes of a string and returns it. Measuring
+/// a string in pieces this way, each one continuing from the previous result, adds up exactly like
+/// measuring it at once.
+/// </summary>
+/// <param name="font">Pointer to your font object</param>
+/// <param name="size">Font height in pixel</param>
+/// <param name="str">UTF-8 string, `length` should end on a character boundary</param>
+/// <param name="length">Number of bytes</param>
+/// <param name="x">Pen position to start from</param>
+float kr_ttf_advance(kr_ttf_font_t *font, int size, const char *str, int length, float x);
+
 /// <summary>
 /// Return the width of a subset of an array of characters in pixel.
 /// </summary>
@@ -125,7 +204,8 @@ float kr_ttf_descent(kr_ttf_font_t *font, int size);
 float kr_ttf_line_gap(kr_ttf_font_t *font, int size);
 
 /// <summary>
-/// Get an aligned quad for a character. Returns false if an error occurred.
+/// Get an aligned quad for a character. Characters that are not part of the glyph set passed to
+/// kr_ttf_init are rasterized into an atlas page on first use. Returns false if an error occurred.
 /// </summary>
 /// <param name="font">Pointer to your font object</param>
 /// <param name="size">Font height in pixel</param>
@@ -136,6 +216,61 @@ float kr_ttf_line_gap(kr_ttf_font_t *font, int size);
 bool kr_ttf_get_baked_quad(kr_ttf_font_t *font, int size, kr_ttf_aligned_quad_t *q, int char_code,
                            float xpos, float ypos);
 
+/// <summary>
+/// Returns the cached run for a string, laying it out on a miss. Returns NULL for strings longer
+/// than KR_TTF_MAX_RUN_LENGTH bytes. The run stays valid until the next call into kr_ttf.
+/// </summary>
+/// <param name="font">Pointer to your font object</param>
+/// <param name="size">Font height in pixel</param>
+/// <param name="str">Null terminated UTF-8 string</param>
+const kr_ttf_run_t *kr_ttf_get_run(kr_ttf_font_t *font, int size, const char *str);
+
+/// <summary>
+/// Returns the atlas generation of the font size. It changes whenever a page is recycled, which
+/// invalidates all quads handed out before, and is never shared with another font or size.
+/// </summary>
+/// <param name="font">Pointer to your font object</param>
+/// <param name="size">Font height in pixel</param>
+unsigned kr_ttf_get_generation(kr_ttf_font_t *font, int size);
+
+/// <summary>
+/// Marks atlas pages as used by the current frame, like kr_ttf_get_run does for the pages of a
+/// cached run, so they are not recycled while quads referencing them are pending.
+/// </summary>
+/// <param name="font">Pointer to your font object</param>
+/// <param name="size">Font height in pixel</param>
+/// <param name="pages">Bitmask of pages as in kr_ttf_run_t</param>
+void kr_ttf_use_pages(kr_ttf_font_t *font, int size, unsigned pages);
+
+/// <summary>
+/// Uploads glyphs rasterized since the last call to their atlas pages. Needs to be called before
+/// quads returned by kr_ttf_get_baked_quad are drawn. Pages used so far become eligible for
+/// eviction afterwards.
+/// </summary>
+void kr_ttf_upload_pages(void);
+
+/// <summary>
+/// Decodes the UTF-8 sequence at `str` and returns a pointer to the next one.
+/// </summary>
+/// <param name="str">Pointer into a null terminated UTF-8 string</param>
+/// <param name="codepoint">Receives the decoded codepoint</param>
+const char *kr_ttf_utf8_next(const char *str, int *codepoint);
+
+/// <summary>
+/// Sets the advance of the tab character in pixel.
+/// </summary>
+/// <param name="font">Pointer to your font object</param>
+/// <param name="size">Font height in pixel</param>
+/// <param name="width">Tab width in pixel</param>
+void kr_ttf_set_tab_width(kr_ttf_font_t *font, int size, float width);
+
+/// <summary>
+/// Returns the advance of the tab character in pixel.
+/// </summary>
+/// <param name="font">Pointer to your font object</param>
+/// <param name="size">Font height in pixel</param>
+float kr_ttf_get_tab_width(kr_ttf_font_t *font, int size);
+
 /// <summary>
 /// Get the baked texture of the font.
 /// </summary>
@@ -0,0 +1,1003 @@
+#include "uberpainter.h"
+
+#include <assert.h>
+#include <kinc/graphics4/graphics.h>
+#include <kinc/graphics4/indexbuffer.h>
+#include <kinc/graphics4/pipeline.h>
+#include <kinc/graphics4/rendertarget.h>
+#include <kinc/graphics4/shader.h>
+#include <kinc/graphics4/texture.h>
+#include <kinc/graphics4/textureunit.h>
+#include <kinc/graphics4/vertexbuffer.h>
+#include <kinc/graphics4/vertexstructure.h>
+#include <kinc/io/filereader.h>
+#include <kinc/log.h>
+#include <kinc/math/core.h>
+#include <krink/color.h>
+#include <krink/math/matrix.h>
+#include <krink/math/vector.h>
+#include <krink/memory.h>
+#include <string.h>
+
+#define KR_G2_USP_NO_CLIP 1e9f
+
+// Shading selected per vertex, must match kr-painter-uber.frag
+typedef enum kr_usp_kind {
+	KR_USP_COLORED = 0,
+	KR_USP_GLYPH = 1,
+	KR_USP_IMAGE = 2,
+	KR_USP_SDF_RECT = 3,
+	KR_USP_SDF_CIRCLE = 4,
+	KR_USP_SDF_LINE = 5
+} kr_usp_kind_t;
+
+// 60 bytes. `box`, `border`, `smooth` and `corner` are only read by the SDF kinds, `clip` indexes
+// the clip table uploaded with the batch.
+typedef struct kr_usp_vertex {
+	float x, y;
+	float s, t;
+	uint32_t color;
+	uint32_t border_color;
+	float box_x, box_y, border, smooth;
+	float corner[4];
+	uint8_t kind, slot, clip, pad;
+} kr_usp_vertex_t;
+
+// 20 bytes, one per glyph instead of four vertices. Position, width and height are whole pixels,
+// the atlas rect s0, t0, s1, t1 is normalized to 16 bits; see kr-painter-glyph.vert.
+typedef struct kr_usp_glyph {
+	int16_t x, y;
+	uint16_t s0, t0, s1, t1;
+	uint8_t width, height, slot, clip;
+	uint32_t color;
+} kr_usp_glyph_t;
+
+// Dynamic vertex buffers written round robin. A buffer is only written again once the GPU is done
+// reading it, which is assumed KR_G2_USP_FRAMES_IN_FLIGHT frames after the last draw from it.
+typedef struct kr_usp_ring {
+	kinc_g4_vertex_buffer_t **buffers;
+	int *last_frame;
+	int count, capacity;
+	int current;
+	bool warned;
+	kinc_g4_vertex_structure_t structure;
+	int vertex_count;
+	int instance_data_step_rate;
+} kr_usp_ring_t;
+
+#ifndef KR_FULL_RGBA_FONTS
+// A line of strings laid out as glyph instances relative to the line origin. Glyph slots index
+// `textures`, `key` holds the strings and colors the line was laid out from.
+typedef struct kr_usp_line {
+	uint64_t hash;
+	char *key;
+	int key_length;
+	kr_usp_glyph_t *glyphs; // start of the allocation holding textures and key as well
+	int num_glyphs;
+	kinc_g4_texture_t **textures;
+	int num_textures;
+	unsigned pages;
+	float bounds[4];
+	int width;
+} kr_usp_line_t;
+#endif
+
+typedef struct kr_usp_texture {
+	kinc_g4_texture_t *tex;
+	kinc_g4_render_target_t *render_target;
+} kr_usp_texture_t;
+
+static kr_usp_ring_t vertex_ring;
+static kinc_g4_index_buffer_t index_buffer;
+static kinc_g4_shader_t vert_shader;
+static kinc_g4_shader_t frag_shader;
+static kinc_g4_pipeline_t pipeline;
+static kinc_g4_texture_unit_t texunits[KR_G2_USP_TEXTURE_UNITS];
+static kr_usp_texture_t textures[KR_G2_USP_TEXTURE_UNITS];
+static int num_textures = 0;
+static bool has_glyphs = false;
+static kinc_g4_constant_location_t proj_mat_loc;
+static kinc_g4_constant_location_t clip_rects_loc;
+// Clip rects referenced by the vertices of the current batch as x0, y0, x1, y1, entry 0 never clips
+static float clip_rects[KR_G2_USP_MAX_CLIP_RECTS * 4];
+static int num_clip_rects = 1;
+static int clip_index = 0;
+static kinc_matrix4x4_t projection_matrix;
+static kr_usp_vertex_t *verts = NULL;
+static int buffer_index = 0;
+static int buffer_start = 0;
+
+static kinc_g4_vertex_buffer_t unit_quad_buffer;
+static kr_usp_ring_t glyph_ring;
+static kinc_g4_shader_t glyph_vert_shader;
+static kinc_g4_shader_t glyph_frag_shader;
+static kinc_g4_pipeline_t glyph_pipeline;
+static kinc_g4_texture_unit_t glyph_texunits[KR_G2_USP_TEXTURE_UNITS];
+static kinc_g4_constant_location_t glyph_proj_mat_loc;
+static kinc_g4_constant_location_t glyph_clip_rects_loc;
+static kr_usp_glyph_t *glyphs = NULL;
+static int num_glyphs = 0;
+// Bounds of the glyph runs pending in the batch as x0, y0, x1, y1 and their union
+static float glyph_runs[KR_G2_USP_MAX_GLYPH_RUNS * 4];
+static int num_glyph_runs = 0;
+static float glyph_runs_bounds[4];
+// Bounds of the run being appended, empty between runs
+static float run_bounds[4] = {KR_G2_USP_NO_CLIP, KR_G2_USP_NO_CLIP, -KR_G2_USP_NO_CLIP,
+                              -KR_G2_USP_NO_CLIP};
+
+static int frame = 0;
+
+#ifndef KR_FULL_RGBA_FONTS
+static kr_usp_line_t *lines = NULL; // direct mapped cache of KR_G2_USP_LINE_CACHE_SIZE lines
+static char line_key[KR_G2_USP_MAX_LINE_KEY];
+static kr_usp_glyph_t line_glyphs[KR_G2_USP_MAX_LINE_GLYPHS];
+static kinc_g4_texture_t *line_textures[KR_TTF_MAX_PAGES + 1];
+#endif
+
+static bool bilinear_filter = false;
+static kr_ttf_font_t *active_font = NULL;
+static int font_size = 0;
+
+static void load_shader(kinc_g4_shader_t *shader, const char *filename,
+                        kinc_g4_shader_type_t type) {
+	kinc_file_reader_t reader;
+	kinc_file_reader_open(&reader, filename, KINC_FILE_TYPE_ASSET);
+	size_t size = kinc_file_reader_size(&reader);
+	uint8_t *data = kr_malloc(size);
+	kinc_file_reader_read(&reader, data, size);
+	kinc_file_reader_close(&reader);
+
+	kinc_g4_shader_init(shader, data, size, type);
+	kr_free(data);
+}
+
+static kinc_g4_vertex_buffer_t *usp_ring_add(kr_usp_ring_t *ring, int index) {
+	if (ring->count == ring->capacity) {
+		ring->capacity = ring->capacity ? ring->capacity * 2 : 4;
+		ring->buffers = (kinc_g4_vertex_buffer_t **)kr_realloc(
+		    ring->buffers, ring->capacity * sizeof(kinc_g4_vertex_buffer_t *));
+		ring->last_frame = (int *)kr_realloc(ring->last_frame, ring->capacity * sizeof(int));
+	}
+	for (int i = ring->count; i > index; --i) {
+		ring->buffers[i] = ring->buffers[i - 1];
+		ring->last_frame[i] = ring->last_frame[i - 1];
+	}
+	++ring->count;
+	ring->buffers[index] = kr_malloc(sizeof(kinc_g4_vertex_buffer_t));
+	ring->last_frame[index] = -KR_G2_USP_FRAMES_IN_FLIGHT;
+	kinc_g4_vertex_buffer_init(ring->buffers[index], ring->vertex_count, &ring->structure,
+	                           KINC_G4_USAGE_DYNAMIC, ring->instance_data_step_rate);
+	return ring->buffers[index];
+}
+
+static void *usp_ring_init(kr_usp_ring_t *ring, kinc_g4_vertex_structure_t *structure,
+                           int vertex_count, int instance_data_step_rate) {
+	ring->count = ring->capacity = 0;
+	ring->buffers = NULL;
+	ring->last_frame = NULL;
+	ring->current = 0;
+	ring->warned = false;
+	ring->structure = *structure;
+	ring->vertex_count = vertex_count;
+	ring->instance_data_step_rate = instance_data_step_rate;
+	return kinc_g4_vertex_buffer_lock_all(usp_ring_add(ring, 0));
+}
+
+static inline kinc_g4_vertex_buffer_t *usp_ring_current(kr_usp_ring_t *ring) {
+	return ring->buffers[ring->current];
+}
+
+// Moves on to the next buffer of the ring and locks all of it. The ring grows rather than wait for
+// a buffer the GPU may still be reading, so it ends up sized for the peak number of buffers filled
+// within KR_G2_USP_FRAMES_IN_FLIGHT frames. Only a ring of KR_G2_USP_MAX_RING_BUFFERS, which
+// takes hundreds of flushes per frame, reuses such a buffer; that is logged once.
+static void *usp_ring_lock_next(kr_usp_ring_t *ring) {
+	ring->last_frame[ring->current] = frame;
+	int next = (ring->current + 1) % ring->count;
+	if (ring->last_frame[next] + KR_G2_USP_FRAMES_IN_FLIGHT > frame) {
+		if (ring->count < KR_G2_USP_MAX_RING_BUFFERS) {
+			next = ring->current + 1;
+			usp_ring_add(ring, next);
+		}
+		else if (!ring->warned) {
+			kinc_log(KINC_LOG_LEVEL_WARNING,
+			         "uberpainter: all %d buffers of a ring are in flight, reusing one", ring->count);
+			ring->warned = true;
+		}
+	}
+	ring->current = next;
+	return kinc_g4_vertex_buffer_lock_all(ring->buffers[next]);
+}
+
+void kr_usp_init(void) {
+	load_shader(&vert_shader, "kr-painter-uber.vert", KINC_G4_SHADER_TYPE_VERTEX);
+	load_shader(&frag_shader, "kr-painter-uber.frag", KINC_G4_SHADER_TYPE_FRAGMENT);
+
+	kinc_g4_vertex_structure_t structure;
+	kinc_g4_vertex_structure_init(&structure);
+	kinc_g4_vertex_structure_add(&structure, "vertexPosition", KINC_G4_VERTEX_DATA_FLOAT2);
+	kinc_g4_vertex_structure_add(&structure, "vertexUV", KINC_G4_VERTEX_DATA_FLOAT2);
+	kinc_g4_vertex_structure_add(&structure, "vertexColor", KINC_G4_VERTEX_DATA_U8_4X_NORMALIZED);
+	kinc_g4_vertex_structure_add(&structure, "vertexBorderColor",
+	                             KINC_G4_VERTEX_DATA_U8_4X_NORMALIZED);
+	kinc_g4_vertex_structure_add(&structure, "vertexShape", KINC_G4_VERTEX_DATA_FLOAT4);
+	kinc_g4_vertex_structure_add(&structure, "vertexCorner", KINC_G4_VERTEX_DATA_FLOAT4);
+	kinc_g4_vertex_structure_add(&structure, "vertexIds", KINC_G4_VERTEX_DATA_U8_4X_NORMALIZED);
+	kinc_g4_pipeline_init(&pipeline);
+	pipeline.input_layout[0] = &structure;
+	pipeline.input_layout[1] = NULL;
+	pipeline.vertex_shader = &vert_shader;
+	pipeline.fragment_shader = &frag_shader;
+	pipeline.blend_source = KINC_G4_BLEND_SOURCE_ALPHA;
+	pipeline.blend_destination = KINC_G4_BLEND_INV_SOURCE_ALPHA;
+	pipeline.alpha_blend_source = KINC_G4_BLEND_ONE;
+	pipeline.alpha_blend_destination = KINC_G4_BLEND_INV_SOURCE_ALPHA;
+	kinc_g4_pipeline_compile(&pipeline);
+
+	static const char *unit_names[KR_G2_USP_TEXTURE_UNITS] = {"tex0", "tex1", "tex2", "tex3"};
+	for (int i = 0; i < KR_G2_USP_TEXTURE_UNITS; ++i)
+		texunits[i] = kinc_g4_pipeline_get_texture_unit(&pipeline, unit_names[i]);
+	proj_mat_loc = kinc_g4_pipeline_get_constant_location(&pipeline, "projectionMatrix");
+	clip_rects_loc = kinc_g4_pipeline_get_constant_location(&pipeline, "clipRects");
+	clip_rects[0] = clip_rects[1] = -KR_G2_USP_NO_CLIP;
+	clip_rects[2] = clip_rects[3] = KR_G2_USP_NO_CLIP;
+
+	verts = (kr_usp_vertex_t *)usp_ring_init(&vertex_ring, &structure, KR_G2_USP_BUFFER_SIZE * 4, 0);
+
+	kinc_g4_index_buffer_init(&index_buffer, KR_G2_USP_BUFFER_SIZE * 3 * 2,
+	                          KINC_G4_INDEX_BUFFER_FORMAT_32BIT, KINC_G4_USAGE_STATIC);
+	int *indices = kinc_g4_index_buffer_lock(&index_buffer);
+	for (int i = 0; i < KR_G2_USP_BUFFER_SIZE; ++i) {
+		indices[i * 3 * 2 + 0] = i * 4 + 0;
+		indices[i * 3 * 2 + 1] = i * 4 + 1;
+		indices[i * 3 * 2 + 2] = i * 4 + 2;
+		indices[i * 3 * 2 + 3] = i * 4 + 0;
+		indices[i * 3 * 2 + 4] = i * 4 + 2;
+		indices[i * 3 * 2 + 5] = i * 4 + 3;
+	}
+	kinc_g4_index_buffer_unlock(&index_buffer);
+
+	load_shader(&glyph_vert_shader, "kr-painter-glyph.vert", KINC_G4_SHADER_TYPE_VERTEX);
+	load_shader(&glyph_frag_shader, "kr-painter-glyph.frag", KINC_G4_SHADER_TYPE_FRAGMENT);
+
+	kinc_g4_vertex_structure_t quad_structure;
+	kinc_g4_vertex_structure_init(&quad_structure);
+	kinc_g4_vertex_structure_add(&quad_structure, "corner", KINC_G4_VERTEX_DATA_FLOAT2);
+	kinc_g4_vertex_structure_t glyph_structure;
+	kinc_g4_vertex_structure_init(&glyph_structure);
+	glyph_structure.instanced = true;
+	kinc_g4_vertex_structure_add(&glyph_structure, "glyphPosition",
+	                             KINC_G4_VERTEX_DATA_I16_2X_NORMALIZED);
+	kinc_g4_vertex_structure_add(&glyph_structure, "glyphUV", KINC_G4_VERTEX_DATA_U16_4X_NORMALIZED);
+	kinc_g4_vertex_structure_add(&glyph_structure, "glyphSize",
+	                             KINC_G4_VERTEX_DATA_U8_4X_NORMALIZED);
+	kinc_g4_vertex_structure_add(&glyph_structure, "glyphColor",
+	                             KINC_G4_VERTEX_DATA_U8_4X_NORMALIZED);
+	kinc_g4_pipeline_init(&glyph_pipeline);
+	glyph_pipeline.input_layout[0] = &quad_structure;
+	glyph_pipeline.input_layout[1] = &glyph_structure;
+	glyph_pipeline.input_layout[2] = NULL;
+	glyph_pipeline.vertex_shader = &glyph_vert_shader;
+	glyph_pipeline.fragment_shader = &glyph_frag_shader;
+	glyph_pipeline.blend_source = KINC_G4_BLEND_SOURCE_ALPHA;
+	glyph_pipeline.blend_destination = KINC_G4_BLEND_INV_SOURCE_ALPHA;
+	glyph_pipeline.alpha_blend_source = KINC_G4_BLEND_ONE;
+	glyph_pipeline.alpha_blend_destination = KINC_G4_BLEND_INV_SOURCE_ALPHA;
+	kinc_g4_pipeline_compile(&glyph_pipeline);
+
+	for (int i = 0; i < KR_G2_USP_TEXTURE_UNITS; ++i)
+		glyph_texunits[i] = kinc_g4_pipeline_get_texture_unit(&glyph_pipeline, unit_names[i]);
+	glyph_proj_mat_loc = kinc_g4_pipeline_get_constant_location(&glyph_pipeline, "projectionMatrix");
+	glyph_clip_rects_loc = kinc_g4_pipeline_get_constant_location(&glyph_pipeline, "clipRects");
+
+	// corners in the vertex order of a quad, so the first six indices draw it
+	kinc_g4_vertex_buffer_init(&unit_quad_buffer, 4, &quad_structure, KINC_G4_USAGE_STATIC, 0);
+	float *corners = kinc_g4_vertex_buffer_lock_all(&unit_quad_buffer);
+	const float unit_quad[8] = {0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 1.0f};
+	memcpy(corners, unit_quad, sizeof(unit_quad));
+	kinc_g4_vertex_buffer_unlock_all(&unit_quad_buffer);
+
+	glyphs = (kr_usp_glyph_t *)usp_ring_init(&glyph_ring, &glyph_structure,
+	                                         KR_G2_USP_GLYPH_BUFFER_SIZE, 1);
+}
+
+static void usp_bind_textures(const kinc_g4_texture_unit_t *units) {
+	kinc_g4_texture_filter_t filter =
+	    bilinear_filter ? KINC_G4_TEXTURE_FILTER_LINEAR : KINC_G4_TEXTURE_FILTER_POINT;
+	for (int i = 0; i < num_textures; ++i) {
+		kinc_g4_texture_unit_t unit = units[i];
+		if (textures[i].render_target != NULL)
+			kinc_g4_render_target_use_color_as_texture(textures[i].render_target, unit);
+		else
+			kinc_g4_set_texture(unit, textures[i].tex);
+		kinc_g4_set_texture_addressing(unit, KINC_G4_TEXTURE_ADDRESSING_CLAMP,
+		                               KINC_G4_TEXTURE_ADDRESSING_CLAMP);
+		kinc_g4_set_texture_mipmap_filter(unit, KINC_G4_MIPMAP_FILTER_NONE);
+		kinc_g4_set_texture_minification_filter(unit, filter);
+		kinc_g4_set_texture_magnification_filter(unit, filter);
+	}
+}
+
+static void usp_draw_quads(void) {
+	if (buffer_index - buffer_start == 0) return;
+	kinc_g4_vertex_buffer_t *vertex_buffer = usp_ring_current(&vertex_ring);
+	kinc_g4_vertex_buffer_unlock(vertex_buffer, (buffer_index - buffer_start) * 4);
+	kinc_g4_set_pipeline(&pipeline);
+	kinc_g4_set_matrix4(proj_mat_loc, &projection_matrix);
+	kinc_g4_set_floats(clip_rects_loc, clip_rects, num_clip_rects * 4);
+	kinc_g4_set_vertex_buffer(vertex_buffer);
+	kinc_g4_set_index_buffer(&index_buffer);
+	usp_bind_textures(texunits);
+	kinc_g4_draw_indexed_vertices_from_to(buffer_start * 2 * 3,
+	                                      (buffer_index - buffer_start) * 2 * 3);
+
+	// the bound textures stay valid for the next batch, only a new texture resets them
+	// the next batch is appended behind this one, even across frames, so vertices the GPU may still
+	// read are never overwritten
+	if (buffer_index + 1 >= KR_G2_USP_BUFFER_SIZE) {
+		buffer_start = 0;
+		buffer_index = 0;
+		verts = (kr_usp_vertex_t *)usp_ring_lock_next(&vertex_ring);
+	}
+	else {
+		vertex_ring.last_frame[vertex_ring.current] = frame;
+		buffer_start = buffer_index;
+		verts = (kr_usp_vertex_t *)kinc_g4_vertex_buffer_lock(
+		    vertex_buffer, buffer_start * 4, (KR_G2_USP_BUFFER_SIZE - buffer_start) * 4);
+	}
+}
+
+static void usp_draw_glyphs(void) {
+	num_glyph_runs = 0;
+	if (num_glyphs == 0) return;
+	kinc_g4_vertex_buffer_unlock(usp_ring_current(&glyph_ring), num_glyphs);
+	kinc_g4_set_pipeline(&glyph_pipeline);
+	kinc_g4_set_matrix4(glyph_proj_mat_loc, &projection_matrix);
+	kinc_g4_set_floats(glyph_clip_rects_loc, clip_rects, num_clip_rects * 4);
+	kinc_g4_vertex_buffer_t *buffers[2] = {&unit_quad_buffer, usp_ring_current(&glyph_ring)};
+	kinc_g4_set_vertex_buffers(buffers, 2);
+	kinc_g4_set_index_buffer(&index_buffer);
+	usp_bind_textures(glyph_texunits);
+	kinc_g4_draw_indexed_vertices_instanced_from_to(num_glyphs, 0, 2 * 3);
+
+	// instanced draws can not start at an offset, so every batch of glyphs starts in a new buffer
+	num_glyphs = 0;
+	glyphs = (kr_usp_glyph_t *)usp_ring_lock_next(&glyph_ring);
+}
+
+// Draws the quads of the batch, then its glyph instances.
+static void usp_draw_buffer(void) {
+	if (has_glyphs) kr_ttf_upload_pages();
+	usp_draw_quads();
+	usp_draw_glyphs();
+}
+
+static inline void usp_grow_bounds(float *bounds, float x0, float y0, float x1, float y1) {
+	bounds[0] = kinc_min(bounds[0], x0);
+	bounds[1] = kinc_min(bounds[1], y0);
+	bounds[2] = kinc_max(bounds[2], x1);
+	bounds[3] = kinc_max(bounds[3], y1);
+}
+
+static inline bool usp_overlaps(const float *bounds, float x0, float y0, float x1, float y1) {
+	return x1 > bounds[0] && y1 > bounds[1] && x0 < bounds[2] && y0 < bounds[3];
+}
+
+static void usp_end_glyph_run(void) {
+	if (run_bounds[0] > run_bounds[2]) return;
+	if (num_glyph_runs < KR_G2_USP_MAX_GLYPH_RUNS) {
+		memcpy(&glyph_runs[num_glyph_runs * 4], run_bounds, sizeof(run_bounds));
+		++num_glyph_runs;
+	}
+	else {
+		// only makes the overlap test more conservative
+		usp_grow_bounds(&glyph_runs[(num_glyph_runs - 1) * 4], run_bounds[0], run_bounds[1],
+		                run_bounds[2], run_bounds[3]);
+	}
+	if (num_glyph_runs == 1)
+		memcpy(glyph_runs_bounds, run_bounds, sizeof(run_bounds));
+	else
+		usp_grow_bounds(glyph_runs_bounds, run_bounds[0], run_bounds[1], run_bounds[2],
+		                run_bounds[3]);
+	run_bounds[0] = run_bounds[1] = KR_G2_USP_NO_CLIP;
+	run_bounds[2] = run_bounds[3] = -KR_G2_USP_NO_CLIP;
+}
+
+// Glyph instances are drawn after the quads of the batch, which is only correct if the quad does
+// not cover any of the pending glyphs.
+static bool usp_overlaps_glyph_runs(float x0, float y0, float x1, float y1) {
+	if (!usp_overlaps(glyph_runs_bounds, x0, y0, x1, y1)) return false;
+	for (int i = 0; i < num_glyph_runs; ++i) {
+		if (usp_overlaps(&glyph_runs[i * 4], x0, y0, x1, y1)) return true;
+	}
+	return false;
+}
+
+// Returns the slot the texture is bound to in the current batch, flushing it when all texture
+// units are taken by other textures.
+static int usp_texture_slot(kinc_g4_texture_t *tex, kinc_g4_render_target_t *render_target) {
+	for (int i = 0; i < num_textures; ++i) {
+		if (textures[i].tex == tex && textures[i].render_target == render_target) return i;
+	}
+	if (num_textures == KR_G2_USP_TEXTURE_UNITS) {
+		usp_draw_buffer();
+		num_textures = 0;
+	}
+	textures[num_textures].tex = tex;
+	textures[num_textures].render_target = render_target;
+	return num_textures++;
+}
+
+static inline uint32_t usp_apply_opacity(uint32_t color, float opacity) {
+	uint32_t a = kr_color_get_channel(color, 'A');
+	a = (uint32_t)((float)a * opacity);
+	return kr_color_set_channel(color, 'A', a);
+}
+
+// Appends a quad with the corners `p` in the order kr_matrix3x3_multquad returns them (bottom-left,
+// top-left, top-right, bottom-right). Everything but position and texture coordinates is from `v`.
+static void usp_push_quad(const kr_vec2_t *p, float left, float top, float right, float bottom,
+                          kr_usp_vertex_t v) {
+	if (clip_index != 0 || num_glyph_runs > 0) {
+		float bounds[4] = {p[0].x, p[0].y, p[0].x, p[0].y};
+		for (int i = 1; i < 4; ++i)
+			usp_grow_bounds(bounds, p[i].x, p[i].y, p[i].x, p[i].y);
+		if (clip_index != 0 &&
+		    !usp_overlaps(&clip_rects[clip_index * 4], bounds[0], bounds[1], bounds[2], bounds[3]))
+			return;
+		if (num_glyph_runs > 0 &&
+		    usp_overlaps_glyph_runs(bounds[0], bounds[1], bounds[2], bounds[3]))
+			usp_draw_buffer();
+	}
+	if (buffer_index + 1 >= KR_G2_USP_BUFFER_SIZE) usp_draw_buffer();
+	v.clip = (uint8_t)clip_index;
+	kr_usp_vertex_t *q = verts + (buffer_index - buffer_start) * 4;
+	v.x = p[0].x;
+	v.y = p[0].y;
+	v.s = left;
+	v.t = bottom;
+	q[0] = v;
+	v.x = p[1].x;
+	v.y = p[1].y;
+	v.t = top;
+	q[1] = v;
+	v.x = p[2].x;
+	v.y = p[2].y;
+	v.s = right;
+	q[2] = v;
+	v.x = p[3].x;
+	v.y = p[3].y;
+	v.t = bottom;
+	q[3] = v;
+	++buffer_index;
+}
+
+void kr_usp_set_clip_rect(float x, float y, float width, float height) {
+	// rounded like kinc_g4_scissor would be
+	float x0 = (int)(x + 0.5f);
+	float y0 = (int)(y + 0.5f);
+	float x1 = x0 + (int)(width + 0.5f);
+	float y1 = y0 + (int)(height + 0.5f);
+	for (int i = num_clip_rects - 1; i > 0; --i) {
+		const float *clip = &clip_rects[i * 4];
+		if (clip[0] == x0 && clip[1] == y0 && clip[2] == x1 && clip[3] == y1) {
+			clip_index = i;
+			return;
+		}
+	}
+	if (num_clip_rects == KR_G2_USP_MAX_CLIP_RECTS) {
+		usp_draw_buffer();
+		num_clip_rects = 1;
+	}
+	float *clip = &clip_rects[num_clip_rects * 4];
+	clip[0] = x0;
+	clip[1] = y0;
+	clip[2] = x1;
+	clip[3] = y1;
+	clip_index = num_clip_rects++;
+}
+
+void kr_usp_disable_clip_rect(void) {
+	clip_index = 0;
+}
+
+void kr_usp_next_frame(void) {
+	++frame;
+}
+
+void kr_usp_set_projection_matrix(kinc_matrix4x4_t mat) {
+	kr_usp_end();
+	projection_matrix = mat;
+}
+
+void kr_usp_set_bilinear_filter(bool bilinear) {
+	if (bilinear_filter == bilinear) return;
+	if (num_textures > 0) usp_draw_buffer();
+	bilinear_filter = bilinear;
+}
+
+void kr_usp_fill_rect(float x, float y, float width, float height, uint32_t color, float opacity,
+                      kr_matrix3x3_t transformation) {
+	kr_vec2_t p[4];
+	kr_matrix3x3_multquad(&transformation, (kr_quad_t){x, y, width, height}, p);
+	usp_push_quad(p, 0.0f, 0.0f, 0.0f, 0.0f,
+	              (kr_usp_vertex_t){.color = usp_apply_opacity(color, opacity),
+	                                .kind = KR_USP_COLORED});
+}
+
+void kr_usp_fill_triangle(float x0, float y0, float x1, float y1, float x2, float y2,
+                          uint32_t color, float opacity, kr_matrix3x3_t transformation) {
+	// drawn as a quad with a collapsed last edge so triangles share the quad index buffer
+	kr_vec2_t p[4];
+	p[0] = kr_matrix3x3_multvec(&transformation, (kr_vec2_t){x0, y0});
+	p[1] = kr_matrix3x3_multvec(&transformation, (kr_vec2_t){x1, y1});
+	p[2] = kr_matrix3x3_multvec(&transformation, (kr_vec2_t){x2, y2});
+	p[3] = p[2];
+	usp_push_quad(p, 0.0f, 0.0f, 0.0f, 0.0f,
+	              (kr_usp_vertex_t){.color = usp_apply_opacity(color, opacity),
+	                                .kind = KR_USP_COLORED});
+}
+
+void kr_usp_draw_scaled_sub_image(kr_image_t *img, float sx, float sy, float sw, float sh, float dx,
+                                  float dy, float dw, float dh, float opacity, uint32_t color,
+                                  kr_matrix3x3_t transformation) {
+	kinc_g4_render_target_t *rt = img->render_target;
+	int slot = usp_texture_slot(rt != NULL ? NULL : img->tex, rt);
+
+	float top = sy / img->real_height;
+	float bottom = (sy + sh) / img->real_height;
+	if (rt != NULL && kinc_g4_render_targets_inverted_y()) {
+		top = 1.0f - top;
+		bottom = 1.0f - bottom;
+	}
+	kr_vec2_t p[4];
+	kr_matrix3x3_multquad(&transformation, (kr_quad_t){dx, dy, dw, dh}, p);
+	usp_push_quad(p, sx / img->real_width, top, (sx + sw) / img->real_width, bottom,
+	              (kr_usp_vertex_t){.color = usp_apply_opacity(color, opacity),
+	                                .kind = KR_USP_IMAGE,
+	                                .slot = slot});
+}
+
+// Glyph Impl
+
+void kr_usp_set_font(kr_ttf_font_t *font) {
+	active_font = font;
+}
+
+void kr_usp_set_font_size(int size) {
+	assert(active_font != NULL);
+	kr_ttf_load(active_font, size);
+	font_size = size;
+}
+
+static void usp_draw_glyph_quad(const kr_ttf_aligned_quad_t *q, float x, float y, uint32_t color,
+                                kr_matrix3x3_t *transformation) {
+	int slot = usp_texture_slot(q->tex, NULL);
+	has_glyphs = true;
+	kr_vec2_t p[4];
+	kr_matrix3x3_multquad(transformation,
+	                      (kr_quad_t){x + q->x0, y + q->y0, q->x1 - q->x0, q->y1 - q->y0}, p);
+#ifdef KR_FULL_RGBA_FONTS
+	uint8_t kind = KR_USP_IMAGE;
+#else
+	uint8_t kind = KR_USP_GLYPH;
+#endif
+	usp_push_quad(p, q->s0, q->t0, q->s1, q->t1,
+	              (kr_usp_vertex_t){.color = color, .kind = kind, .slot = slot});
+}
+
+#ifndef KR_FULL_RGBA_FONTS
+// Appends the glyph as an instance if it lands on whole pixels, otherwise it has to be drawn as a
+// quad. Only valid while the transformation is a translation by whole pixels, see usp_translation.
+static bool usp_push_glyph(const kr_ttf_aligned_quad_t *q, float x, float y, uint32_t color) {
+	float x0 = x + q->x0;
+	float y0 = y + q->y0;
+	float width = q->x1 - q->x0;
+	float height = q->y1 - q->y0;
+	if (x0 < -32767.0f || y0 < -32767.0f || x0 > 32767.0f || y0 > 32767.0f || width > 255.0f ||
+	    height > 255.0f || x0 != (int)x0 || y0 != (int)y0)
+		return false;
+	if (clip_index != 0 &&
+	    !usp_overlaps(&clip_rects[clip_index * 4], x0, y0, x0 + width, y0 + height))
+		return true;
+	int slot = usp_texture_slot(q->tex, NULL);
+	if (num_glyphs == KR_G2_USP_GLYPH_BUFFER_SIZE) usp_draw_buffer();
+	has_glyphs = true;
+	glyphs[num_glyphs++] = (kr_usp_glyph_t){.x = (int16_t)x0,
+	                                        .y = (int16_t)y0,
+	                                        .s0 = (uint16_t)(q->s0 * 65535.0f + 0.5f),
+	                                        .t0 = (uint16_t)(q->t0 * 65535.0f + 0.5f),
+	                                        .s1 = (uint16_t)(q->s1 * 65535.0f + 0.5f),
+	                                        .t1 = (uint16_t)(q->t1 * 65535.0f + 0.5f),
+	                                        .width = (uint8_t)width,
+	                                        .height = (uint8_t)height,
+	                                        .slot = (uint8_t)slot,
+	                                        .clip = (uint8_t)clip_index,
+	                                        .color = color};
+	usp_grow_bounds(run_bounds, x0, y0, x0 + width, y0 + height);
+	return true;
+}
+
+// Returns whether glyphs can be instanced under the transformation and its translation if so.
+static bool usp_translation(const kr_matrix3x3_t *m, float *dx, float *dy) {
+	if (m->m00 != 1.0f || m->m10 != 0.0f || m->m01 != 0.0f || m->m11 != 1.0f || m->m02 != 0.0f ||
+	    m->m12 != 0.0f || m->m22 != 1.0f)
+		return false;
+	*dx = m->m20;
+	*dy = m->m21;
+	return true;
+}
+#endif
+
+static void usp_draw_run_glyph(const kr_ttf_aligned_quad_t *q, float x, float y, uint32_t color,
+                               kr_matrix3x3_t *transformation, bool instanced, float dx, float dy) {
+#ifndef KR_FULL_RGBA_FONTS
+	if (instanced) {
+		if (usp_push_glyph(q, x + dx, y + dy, color)) return;
+		// quads have to be ordered after the glyphs already appended
+		usp_end_glyph_run();
+	}
+#endif
+	usp_draw_glyph_quad(q, x, y, color, transformation);
+}
+
+static float usp_draw_glyph(int codepoint, uint32_t color, float xpos, float ypos,
+                            kr_matrix3x3_t *transformation, bool instanced, float dx, float dy) {
+	kr_ttf_aligned_quad_t q;
+	if (!kr_ttf_get_baked_quad(active_font, font_size, &q, codepoint, xpos, ypos)) return xpos;
+	// blank glyphs only advance the pen
+	if (q.x1 > q.x0 && q.y1 > q.y0)
+		usp_draw_run_glyph(&q, 0.0f, 0.0f, color, transformation, instanced, dx, dy);
+	return xpos + q.xadvance;
+}
+
+int kr_usp_draw_string(const char *text, float opacity, uint32_t color, float x, float y,
+                       kr_matrix3x3_t transformation) {
+	color = usp_apply_opacity(color, opacity);
+	float dx = 0.0f, dy = 0.0f;
+#ifdef KR_FULL_RGBA_FONTS
+	bool instanced = false;
+#else
+	bool instanced = usp_translation(&transformation, &dx, &dy);
+#endif
+	// cached runs are laid out at the origin, which only matches on whole pixel positions
+	if (x == (int)x && y == (int)y) {
+		const kr_ttf_run_t *run = kr_ttf_get_run(active_font, font_size, text);
+		if (run != NULL) {
+			for (int i = 0; i < run->num_quads; ++i)
+				usp_draw_run_glyph(&run->quads[i], x, y, color, &transformation, instanced, dx, dy);
+			usp_end_glyph_run();
+			return x + run->width;
+		}
+	}
+
+	// strings too long to be cached as runs may be far wider than the clip rect, glyphs well outside
+	// of it are only measured
+	float left = -KR_G2_USP_NO_CLIP;
+	float right = KR_G2_USP_NO_CLIP;
+	if (instanced && clip_index != 0) {
+		left = clip_rects[clip_index * 4] - dx - 2 * font_size;
+		right = clip_rects[clip_index * 4 + 2] - dx + font_size;
+	}
+	float xpos = x;
+	while (*text != 0) {
+		if (xpos >= right) {
+			xpos = kr_ttf_advance(active_font, font_size, text, (int)strlen(text), xpos);
+			break;
+		}
+		int codepoint;
+		const char *next = kr_ttf_utf8_next(text, &codepoint);
+		if (xpos < left)
+			xpos = kr_ttf_advance(active_font, font_size, text, (int)(next - text), xpos);
+		else
+			xpos = usp_draw_glyph(codepoint, color, xpos, y, &transformation, instanced, dx, dy);
+		text = next;
+	}
+	usp_end_glyph_run();
+	return xpos;
+}
+
+int kr_usp_draw_characters(const int *text, int start, int length, float opacity, uint32_t color,
+                           float x, float y, kr_matrix3x3_t transformation) {
+	color = usp_apply_opacity(color, opacity);
+	float dx = 0.0f, dy = 0.0f;
+#ifdef KR_FULL_RGBA_FONTS
+	bool instanced = false;
+#else
+	bool instanced = usp_translation(&transformation, &dx, &dy);
+#endif
+	float xpos = x;
+	for (int i = start; i < start + length; ++i) {
+		xpos = usp_draw_glyph(text[i], color, xpos, y, &transformation, instanced, dx, dy);
+	}
+	usp_end_glyph_run();
+	return xpos;
+}
+
+#ifndef KR_FULL_RGBA_FONTS
+// Packs what the line is laid out from into line_key. Returns its length, -1 if it is too long.
+static int usp_line_key(const char *const *texts, const uint32_t *colors, int count,
+                        float opacity) {
+	unsigned generation = kr_ttf_get_generation(active_font, font_size);
+	float tab_width = kr_ttf_get_tab_width(active_font, font_size);
+	memcpy(line_key, &generation, sizeof(generation));
+	memcpy(line_key + sizeof(generation), &tab_width, sizeof(tab_width));
+	int length = sizeof(generation) + sizeof(tab_width);
+	for (int i = 0; i < count; ++i) {
+		uint32_t color = usp_apply_opacity(colors[i], opacity);
+		int size = (int)strlen(texts[i]) + 1;
+		if (length + (int)sizeof(color) + size > KR_G2_USP_MAX_LINE_KEY) return -1;
+		memcpy(line_key + length, &color, sizeof(color));
+		memcpy(line_key + length + sizeof(color), texts[i], size);
+		length += sizeof(color) + size;
+	}
+	return length;
+}
+
+// Lays the line out at the origin from the runs of its strings. Fails for strings which are not
+// cached as runs and glyphs which can not be instanced relative to the origin.
+static bool usp_line_build(kr_usp_line_t *line, const char *const *texts, const uint32_t *colors,
+                           int count, float opacity, int key_length) {
+	unsigned generation = kr_ttf_get_generation(active_font, font_size);
+	float bounds[4] = {KR_G2_USP_NO_CLIP, KR_G2_USP_NO_CLIP, -KR_G2_USP_NO_CLIP,
+	                   -KR_G2_USP_NO_CLIP};
+	unsigned pages = 0;
+	int num_glyphs = 0;
+	int num_textures = 0;
+	int pen = 0;
+	for (int i = 0; i < count; ++i) {
+		const kr_ttf_run_t *run = kr_ttf_get_run(active_font, font_size, texts[i]);
+		if (run == NULL || num_glyphs + run->num_quads > KR_G2_USP_MAX_LINE_GLYPHS) return false;
+		uint32_t color = usp_apply_opacity(colors[i], opacity);
+		for (int j = 0; j < run->num_quads; ++j) {
+			const kr_ttf_aligned_quad_t *q = &run->quads[j];
+			float x0 = pen + q->x0;
+			float y0 = q->y0;
+			float width = q->x1 - q->x0;
+			float height = q->y1 - q->y0;
+			if (x0 < -32767.0f || y0 < -32767.0f || x0 > 32767.0f || y0 > 32767.0f ||
+			    width > 255.0f || height > 255.0f || x0 != (int)x0 || y0 != (int)y0)
+				return false;
+			int slot = 0;
+			while (slot < num_textures && line_textures[slot] != q->tex) ++slot;
+			if (slot == num_textures) {
+				if (num_textures == KR_TTF_MAX_PAGES + 1) return false;
+				line_textures[num_textures++] = q->tex;
+			}
+			line_glyphs[num_glyphs++] = (kr_usp_glyph_t){.x = (int16_t)x0,
+			                                             .y = (int16_t)y0,
+			                                             .s0 = (uint16_t)(q->s0 * 65535.0f + 0.5f),
+			                                             .t0 = (uint16_t)(q->t0 * 65535.0f + 0.5f),
+			                                             .s1 = (uint16_t)(q->s1 * 65535.0f + 0.5f),
+			                                             .t1 = (uint16_t)(q->t1 * 65535.0f + 0.5f),
+			                                             .width = (uint8_t)width,
+			                                             .height = (uint8_t)height,
+			                                             .slot = (uint8_t)slot,
+			                                             .color = color};
+			usp_grow_bounds(bounds, x0, y0, x0 + width, y0 + height);
+		}
+		pages |= run->pages;
+		pen += (int)run->width;
+	}
+	// laying out a later string may have recycled a page the earlier ones are on
+	if (kr_ttf_get_generation(active_font, font_size) != generation) return false;
+
+	size_t glyphs_size = num_glyphs * sizeof(kr_usp_glyph_t);
+	size_t textures_size = num_textures * sizeof(kinc_g4_texture_t *);
+	char *block = (char *)kr_malloc(glyphs_size + textures_size + key_length);
+	assert(block != NULL);
+	line->glyphs = (kr_usp_glyph_t *)block;
+	line->textures = (kinc_g4_texture_t **)(block + glyphs_size);
+	line->key = block + glyphs_size + textures_size;
+	memcpy(line->glyphs, line_glyphs, glyphs_size);
+	memcpy(line->textures, line_textures, textures_size);
+	memcpy(line->key, line_key, key_length);
+	line->key_length = key_length;
+	line->num_glyphs = num_glyphs;
+	line->num_textures = num_textures;
+	line->pages = pages;
+	memcpy(line->bounds, bounds, sizeof(bounds));
+	line->width = pen;
+	return true;
+}
+
+// Returns the cached line, laying it out on a miss. The atlas generation is part of the key, so
+// lines referencing a recycled page miss as well.
+static const kr_usp_line_t *usp_get_line(const char *const *texts, const uint32_t *colors,
+                                         int count, float opacity) {
+	int key_length = usp_line_key(texts, colors, count, opacity);
+	if (key_length < 0) return NULL;
+	uint64_t hash = 14695981039346656037ull;
+	for (int i = 0; i < key_length; ++i) {
+		hash ^= (unsigned char)line_key[i];
+		hash *= 1099511628211ull;
+	}
+
+	if (lines == NULL) {
+		lines = (kr_usp_line_t *)kr_calloc(KR_G2_USP_LINE_CACHE_SIZE, sizeof(kr_usp_line_t));
+		assert(lines != NULL);
+	}
+	kr_usp_line_t *line = &lines[hash & (KR_G2_USP_LINE_CACHE_SIZE - 1)];
+	if (line->glyphs != NULL && line->hash == hash && line->key_length == key_length &&
+	    memcmp(line->key, line_key, key_length) == 0) {
+		kr_ttf_use_pages(active_font, font_size, line->pages);
+		return line;
+	}
+
+	if (line->glyphs != NULL) kr_free(line->glyphs);
+	line->glyphs = NULL;
+	if (!usp_line_build(line, texts, colors, count, opacity, key_length)) {
+		if (line->glyphs != NULL) kr_free(line->glyphs);
+		line->glyphs = NULL;
+		return NULL;
+	}
+	line->hash = hash;
+	return line;
+}
+
+// Appends the instances of the line translated to x, y, which are whole pixels. Returns false if
+// the line does not fit the instance position range there.
+static bool usp_emit_line(const kr_usp_line_t *line, float x, float y) {
+	if (line->num_glyphs == 0) return true;
+	float x0 = x + line->bounds[0];
+	float y0 = y + line->bounds[1];
+	float x1 = x + line->bounds[2];
+	float y1 = y + line->bounds[3];
+	if (x0 < -32767.0f || y0 < -32767.0f || x1 > 32767.0f || y1 > 32767.0f) return false;
+	const float *clip = &clip_rects[clip_index * 4];
+	if (!usp_overlaps(clip, x0, y0, x1, y1)) return true;
+	bool inside = x0 >= clip[0] && y0 >= clip[1] && x1 <= clip[2] && y1 <= clip[3];
+
+	has_glyphs = true;
+	int16_t dx = (int16_t)x;
+	int16_t dy = (int16_t)y;
+	kinc_g4_texture_t *tex = NULL;
+	int slot = 0;
+	// a clipped line only covers the glyphs it emits, and of those only what the clip rect shows,
+	// or quads drawn later next to the visible part would flush the batch for nothing
+	float bounds[4] = {x0, y0, x1, y1};
+	if (!inside) {
+		bounds[0] = bounds[1] = KR_G2_USP_NO_CLIP;
+		bounds[2] = bounds[3] = -KR_G2_USP_NO_CLIP;
+	}
+	for (int i = 0; i < line->num_glyphs; ++i) {
+		kr_usp_glyph_t g = line->glyphs[i];
+		g.x += dx;
+		g.y += dy;
+		if (!inside) {
+			if (!usp_overlaps(clip, g.x, g.y, g.x + g.width, g.y + g.height)) continue;
+			usp_grow_bounds(bounds, g.x, g.y, g.x + g.width, g.y + g.height);
+		}
+		// the slot of the previous texture stays valid, only looking up another one resets slots
+		if (line->textures[g.slot] != tex) {
+			tex = line->textures[g.slot];
+			slot = usp_texture_slot(tex, NULL);
+		}
+		if (num_glyphs == KR_G2_USP_GLYPH_BUFFER_SIZE) usp_draw_buffer();
+		g.slot = (uint8_t)slot;
+		g.clip = (uint8_t)clip_index;
+		glyphs[num_glyphs++] = g;
+	}
+	if (!inside && bounds[0] <= bounds[2]) {
+		bounds[0] = kinc_max(bounds[0], clip[0]);
+		bounds[1] = kinc_max(bounds[1], clip[1]);
+		bounds[2] = kinc_min(bounds[2], clip[2]);
+		bounds[3] = kinc_min(bounds[3], clip[3]);
+	}
+	if (bounds[0] < bounds[2] && bounds[1] < bounds[3])
+		usp_grow_bounds(run_bounds, bounds[0], bounds[1], bounds[2], bounds[3]);
+	usp_end_glyph_run();
+	return true;
+}
+#endif
+
+int kr_usp_draw_text_line(const char *const *texts, const uint32_t *colors, int count,
+                          float opacity, float x, float y, kr_matrix3x3_t transformation) {
+#ifndef KR_FULL_RGBA_FONTS
+	float dx, dy;
+	if (usp_translation(&transformation, &dx, &dy) && x + dx == (int)(x + dx) &&
+	    y + dy == (int)(y + dy)) {
+		const kr_usp_line_t *line = usp_get_line(texts, colors, count, opacity);
+		if (line != NULL && usp_emit_line(line, x + dx, y + dy)) return x + line->width;
+	}
+#endif
+	for (int i = 0; i < count; ++i) {
+		kr_usp_draw_string(texts[i], opacity, colors[i], x, y, transformation);
+		x += (int)kr_ttf_width(active_font, font_size, texts[i]);
+	}
+	return x;
+}
+
+// SDF Impl
+
+void kr_usp_draw_sdf_rect(float x, float y, float width, float height,
+                          kr_sdf_corner_radius_t corner, float border, float smooth, uint32_t color,
+                          uint32_t border_color, float opacity, kr_matrix3x3_t transformation) {
+	kr_vec2_t p[4];
+	kr_matrix3x3_multquad(&transformation, (kr_quad_t){x, y, width, height}, p);
+	float w = kr_vec2_length(kr_vec2_subv(p[2], p[1]));
+	float h = kr_vec2_length(kr_vec2_subv(p[0], p[1]));
+	float u = w / (w > h ? w : h);
+	float v = h / (w > h ? w : h);
+	float f = (u >= v ? u / w : v / h) * kinc_max(w / width, h / height);
+
+	usp_push_quad(p, 0.0f, 0.0f, u, v,
+	              (kr_usp_vertex_t){.color = usp_apply_opacity(color, opacity),
+	                                .border_color = usp_apply_opacity(border_color, opacity),
+	                                .box_x = u / 2.0f,
+	                                .box_y = v / 2.0f,
+	                                .border = border * f,
+	                                .smooth = smooth * f,
+	                                .corner = {corner.bottom_right * f, corner.top_right * f,
+	                                           corner.bottom_left * f, corner.top_left * f},
+	                                .kind = KR_USP_SDF_RECT});
+}
+
+void kr_usp_draw_sdf_circle(float x, float y, float radius, float border, float smooth,
+                            uint32_t color, uint32_t border_color, float opacity,
+                            kr_matrix3x3_t transformation) {
+	kr_vec2_t p[4];
+	kr_matrix3x3_multquad(&transformation,
+	                      (kr_quad_t){x - radius, y - radius, radius * 2.0f, radius * 2.0f}, p);
+	float w = kr_vec2_length(kr_vec2_subv(p[2], p[1]));
+	float h = kr_vec2_length(kr_vec2_subv(p[0], p[1]));
+	float u = w / (w > h ? w : h);
+	float v = h / (w > h ? w : h);
+	float f = (u >= v ? u / w : v / h) * kinc_max(w / (2 * radius), h / (2 * radius));
+
+	usp_push_quad(p, 0.0f, 0.0f, 1.0f, 1.0f,
+	              (kr_usp_vertex_t){.color = usp_apply_opacity(color, opacity),
+	                                .border_color = usp_apply_opacity(border_color, opacity),
+	                                .border = border * f,
+	                                .smooth = smooth * f,
+	                                .kind = KR_USP_SDF_CIRCLE});
+}
+
+static kr_vec2_t get_corner_vec(kr_vec2_t a, kr_vec2_t d0, kr_vec2_t d1) {
+	return kr_vec2_addv(kr_vec2_addv(a, d0), d1);
+}
+
+void kr_usp_draw_sdf_line(float x0, float y0, float x1, float y1, float strength, float smooth,
+                          uint32_t color, float opacity, kr_matrix3x3_t transformation) {
+	kr_vec2_t a = x0 <= x1 ? ((kr_vec2_t){x0, y0}) : ((kr_vec2_t){x1, y1});
+	kr_vec2_t b = x0 <= x1 ? ((kr_vec2_t){x1, y1}) : ((kr_vec2_t){x0, y0});
+	kr_vec2_t fw = kr_vec2_normalized(kr_vec2_subv(b, a));
+	kr_vec2_t bw = kr_vec2_mult(fw, -1.0f);
+	kr_vec2_t up = (kr_vec2_t){fw.y, -fw.x};
+	kr_vec2_t down = kr_vec2_mult(up, -1.0f);
+	float hs = strength / 2.0f;
+	fw = kr_vec2_mult(fw, hs);
+	bw = kr_vec2_mult(bw, hs);
+	up = kr_vec2_mult(up, hs);
+	down = kr_vec2_mult(down, hs);
+
+	kr_vec2_t p[4];
+	p[0] = kr_matrix3x3_multvec(&transformation, get_corner_vec(a, down, bw)); // bottom-left
+	p[1] = kr_matrix3x3_multvec(&transformation, get_corner_vec(a, up, bw));   // top-left
+	p[2] = kr_matrix3x3_multvec(&transformation, get_corner_vec(b, up, fw));   // top-right
+	p[3] = kr_matrix3x3_multvec(&transformation, get_corner_vec(b, down, fw)); // bottom-right
+
+	float w = kr_vec2_length(kr_vec2_subv(p[2], p[1]));
+	float h = kr_vec2_length(kr_vec2_subv(p[0], p[1]));
+	float u = w / (w > h ? w : h);
+	float v = h / (w > h ? w : h);
+	float wd = kr_vec2_length(kr_vec2_subv(a, b));
+	float f = (u >= v ? u / w : v / h) * kinc_max(w / wd, h / strength);
+
+	usp_push_quad(p, 0.0f, 0.0f, u, v,
+	              (kr_usp_vertex_t){.color = usp_apply_opacity(color, opacity),
+	                                .box_x = u / 2.0f,
+	                                .box_y = v / 2.0f,
+	                                .smooth = smooth * f,
+	                                .kind = KR_USP_SDF_LINE});
+}
+
+void kr_usp_end(void) {
+	usp_draw_buffer();
+	num_textures = 0;
+	has_glyphs = false;
+	// only the active clip rect outlives the batch
+	if (clip_index > 1) memcpy(&clip_rects[4], &clip_rects[clip_index * 4], 4 * sizeof(float));
+	if (clip_index != 0) clip_index = 1;
+	num_clip_rects = clip_index + 1;
+}
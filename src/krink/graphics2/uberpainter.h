@@ -0,0 +1,128 @@
+#pragma once
+
+#include "ttf.h"
+
+#include <kinc/math/matrix.h>
+#include <krink/image.h>
+#include <krink/math/matrix.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/*! \file uberpainter.h
+    \brief A single batching painter for every graphics2 primitive.
+
+    Colored shapes, glyphs, images and SDF shapes share one vertex format and one pipeline, the
+    fragment shader picks the shading per vertex. Primitives of different kinds can therefore be
+    freely interleaved without ending the batch. Up to KR_G2_USP_TEXTURE_UNITS textures are bound
+    at the same time and clipping is done per vertex against a table of clip rects uploaded with the
+    batch. A batch is only flushed when it is full, when it needs yet another texture or clip rect
+    or when render state (filtering, projection) changes.
+
+    Glyphs at whole pixel positions without rotation or scaling skip the quad vertices and are
+    appended as one compact instance each, which kr-painter-glyph.vert expands from a unit quad.
+    Those instances are drawn after the quads of the batch, a quad overlapping an already pending
+    glyph run flushes the batch first so the draw order is kept.
+
+    Lines of text drawn with kr_usp_draw_text_line keep their glyph instances laid out relative to
+    the line origin in a cache keyed by the strings, their colors, the font size, the tab width and
+    the atlas generation. Drawing an unchanged line again only copies its instances with the
+    translation added, a changed line simply no longer matches its entry.
+
+    Batches are appended to dynamic vertex buffers without ever overwriting vertices of an earlier
+    draw. A full buffer is swapped for the next one of a ring, which grows up to
+    KR_G2_USP_MAX_RING_BUFFERS when that one was drawn from in the last KR_G2_USP_FRAMES_IN_FLIGHT
+    frames.
+*/
+
+#ifndef KR_G2_USP_BUFFER_SIZE
+#define KR_G2_USP_BUFFER_SIZE 4096
+#endif
+
+#ifndef KR_G2_USP_GLYPH_BUFFER_SIZE
+#define KR_G2_USP_GLYPH_BUFFER_SIZE 8192
+#endif
+
+// pending glyph runs tracked for draw ordering, further runs are merged into the last one
+#ifndef KR_G2_USP_MAX_GLYPH_RUNS
+#define KR_G2_USP_MAX_GLYPH_RUNS 256
+#endif
+
+// lines cached by kr_usp_draw_text_line, must be a power of two
+#ifndef KR_G2_USP_LINE_CACHE_SIZE
+#define KR_G2_USP_LINE_CACHE_SIZE 512
+#endif
+
+// longer lines are drawn string by string without being cached
+#define KR_G2_USP_MAX_LINE_GLYPHS 1024
+#define KR_G2_USP_MAX_LINE_KEY 4096
+
+#ifndef KR_G2_USP_FRAMES_IN_FLIGHT
+#define KR_G2_USP_FRAMES_IN_FLIGHT 3
+#endif
+
+// rings grow to the buffers in flight up to this many, only a safety net against runaway flushes
+#ifndef KR_G2_USP_MAX_RING_BUFFERS
+#define KR_G2_USP_MAX_RING_BUFFERS 256
+#endif
+
+#define KR_G2_USP_TEXTURE_UNITS 4
+
+// must match the size of clipRects in kr-painter-uber.vert and kr-painter-glyph.vert
+#define KR_G2_USP_MAX_CLIP_RECTS 64
+
+typedef struct kr_sdf_corner_radius {
+	float top_left, bottom_left, bottom_right, top_right;
+} kr_sdf_corner_radius_t;
+
+void kr_usp_init(void);
+void kr_usp_set_projection_matrix(kinc_matrix4x4_t mat);
+void kr_usp_set_bilinear_filter(bool bilinear);
+
+/// <summary>
+/// Clips all following primitives to the rect, which is rounded to whole pixels. Does not end the
+/// current batch unless the clip table of the batch is full.
+/// </summary>
+void kr_usp_set_clip_rect(float x, float y, float width, float height);
+void kr_usp_disable_clip_rect(void);
+
+void kr_usp_fill_rect(float x, float y, float width, float height, uint32_t color, float opacity,
+                      kr_matrix3x3_t transformation);
+void kr_usp_fill_triangle(float x0, float y0, float x1, float y1, float x2, float y2,
+                          uint32_t color, float opacity, kr_matrix3x3_t transformation);
+void kr_usp_draw_scaled_sub_image(kr_image_t *img, float sx, float sy, float sw, float sh, float dx,
+                                  float dy, float dw, float dh, float opacity, uint32_t color,
+                                  kr_matrix3x3_t transformation);
+void kr_usp_set_font(kr_ttf_font_t *font);
+void kr_usp_set_font_size(int size);
+int kr_usp_draw_string(const char *text, float opacity, uint32_t color, float x, float y,
+                       kr_matrix3x3_t transformation);
+int kr_usp_draw_characters(const int *text, int start, int length, float opacity, uint32_t color,
+                           float x, float y, kr_matrix3x3_t transformation);
+
+/// <summary>
+/// Draws `count` strings in a row, each one starting at the whole pixel the previous one ended on
+/// (its start plus its width rounded towards zero). Returns the end of the line. Lines at whole
+/// pixels under a translation reuse the glyphs cached for them, see KR_G2_USP_LINE_CACHE_SIZE.
+/// </summary>
+int kr_usp_draw_text_line(const char *const *texts, const uint32_t *colors, int count,
+                          float opacity, float x, float y, kr_matrix3x3_t transformation);
+
+void kr_usp_draw_sdf_rect(float x, float y, float width, float height,
+                          kr_sdf_corner_radius_t corner, float border, float smooth, uint32_t color,
+                          uint32_t border_color, float opacity, kr_matrix3x3_t transformation);
+void kr_usp_draw_sdf_circle(float x, float y, float radius, float border, float smooth,
+                            uint32_t color, uint32_t border_color, float opacity,
+                            kr_matrix3x3_t transformation);
+void kr_usp_draw_sdf_line(float x0, float y0, float x1, float y1, float strength, float smooth,
+                          uint32_t color, float opacity, kr_matrix3x3_t transformation);
+
+/// <summary>
+/// Draws all pending primitives. Needs to be called before changing any render state outside of
+/// the painter and at the end of the frame.
+/// </summary>
+void kr_usp_end(void);
+
+/// <summary>
+/// Marks the end of a frame, used to tell which vertex buffers the GPU might still be reading.
+/// </summary>
+void kr_usp_next_frame(void);
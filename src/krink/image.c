@@ -7,6 +7,7 @@ void kr_image_init(kr_image_t *img) {
 	img->real_width = 0.0f;
 	img->real_height = 0.0f;
 	img->tex = NULL;
+	img->render_target = NULL;
 	img->path = NULL;
 	img->image = NULL;
 	img->in_memory = false;
@@ -73,6 +74,15 @@ void kr_image_from_texture(kr_image_t *img, kinc_g4_texture_t *tex, float real_w
 	img->owns_tex = false;
 }
 
+void kr_image_from_render_target(kr_image_t *img, kinc_g4_render_target_t *rt) {
+	kr_image_init(img);
+	img->render_target = rt;
+	img->path = "";
+	img->loaded = true;
+	img->real_width = (float)rt->width;
+	img->real_height = (float)rt->height;
+}
+
 void kr_image_generate_mipmaps(kr_image_t *img, int levels) {
 	kinc_g4_texture_generate_mipmaps(img->tex, levels);
 }
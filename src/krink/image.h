@@ -1,5 +1,6 @@
 #pragma once
 
+#include <kinc/graphics4/rendertarget.h>
 #include <kinc/graphics4/texture.h>
 #include <kinc/image.h>
 #include <stdbool.h>
@@ -11,6 +12,7 @@
 
 typedef struct kr_image {
 	kinc_g4_texture_t *tex;
+	kinc_g4_render_target_t *render_target;
 	kinc_image_t *image;
 	float real_width, real_height;
 	const char *path;
@@ -51,6 +53,14 @@ void kr_image_load(kr_image_t *img, const char *path, bool keep_in_memory);
 void kr_image_from_texture(kr_image_t *img, kinc_g4_texture_t *tex, float real_width,
                            float real_height);
 
+/// <summary>
+/// Initialize an image from a render-target. The color attachment is sampled when the image is
+/// drawn; the render-target stays owned by the caller.
+/// </summary>
+/// <param name="img"></param>
+/// <param name="rt"></param>
+void kr_image_from_render_target(kr_image_t *img, kinc_g4_render_target_t *rt);
+
 /// <summary>
 /// Generate mipmaps for a loaded image.
 /// </summary>
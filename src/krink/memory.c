@@ -5,7 +5,9 @@
 #include "util/tlsf.h"
 #include <assert.h>
 #include <kinc/threads/mutex.h>
+#include <kinc/threads/threadlocal.h>
 #include <stdint.h>
+#include <string.h>
 
 #if !defined(NDEBUG) && !defined(KR_NO_ALLOCATION_TRACKER)
 
@@ -99,47 +101,211 @@ static void *kr_heap = NULL;
 static tlsf_t kr_tlsf;
 static kinc_mutex_t memlock;
 
+/*
+ * Small allocations are served from per-thread free lists, one per power of two
+ * size class. They are refilled from and drained to a shared depot
+ * KR_MEMORY_CACHE_BATCH blocks at a time, so the lock is only taken once per
+ * batch. The depot carves its blocks out of KR_MEMORY_SLAB_SIZE aligned slabs
+ * taken from TLSF; a byte per slab sized page of the heap records the class of
+ * the slab covering it, which lets any thread free a block without touching the
+ * TLSF headers. Slabs stay with their class once created.
+ */
+
+#ifndef KR_MEMORY_CACHE_CLASSES
+#define KR_MEMORY_CACHE_CLASSES 5
+#endif
+#define KR_MEMORY_CACHE_MIN 16
+#define KR_MEMORY_CACHE_MAX (KR_MEMORY_CACHE_MIN << (KR_MEMORY_CACHE_CLASSES - 1))
+#define KR_MEMORY_CACHE_BATCH 16
+#define KR_MEMORY_CACHE_LIMIT (4 * KR_MEMORY_CACHE_BATCH)
+#define KR_MEMORY_SLAB_SIZE (16 * 1024)
+
+typedef struct kr_memory_cache {
+	void *lists[KR_MEMORY_CACHE_CLASSES];
+	int counts[KR_MEMORY_CACHE_CLASSES];
+} kr_memory_cache_t;
+
+static kinc_thread_local_t kr_cache_key;
+static kr_memory_cache_t kr_depot;
+static uint8_t *kr_slab_map = NULL;
+static uintptr_t kr_slab_base;
+
+static kr_memory_cache_t *kr_memory_get_cache(void) {
+	kr_memory_cache_t *cache = (kr_memory_cache_t *)kinc_thread_local_get(&kr_cache_key);
+	if (cache == NULL) {
+		kinc_mutex_lock(&memlock);
+		cache = (kr_memory_cache_t *)tlsf_malloc(kr_tlsf, sizeof(kr_memory_cache_t));
+		kinc_mutex_unlock(&memlock);
+		assert(cache);
+		memset(cache, 0, sizeof(kr_memory_cache_t));
+		kinc_thread_local_set(&kr_cache_key, cache);
+	}
+	return cache;
+}
+
+// smallest class that holds `size`
+static int kr_memory_class(size_t size) {
+	int c = 0;
+	while ((size_t)(KR_MEMORY_CACHE_MIN << c) < size) ++c;
+	return c;
+}
+
+// class of the slab `ptr` lies in, -1 for blocks that came from TLSF directly
+static int kr_memory_slab_class(void *ptr) {
+	return (int)kr_slab_map[((uintptr_t)ptr - kr_slab_base) / KR_MEMORY_SLAB_SIZE] - 1;
+}
+
+static void kr_memory_push(kr_memory_cache_t *cache, int c, void *block) {
+	*(void **)block = cache->lists[c];
+	cache->lists[c] = block;
+	++cache->counts[c];
+}
+
+static void *kr_memory_pop(kr_memory_cache_t *cache, int c) {
+	void *block = cache->lists[c];
+	cache->lists[c] = *(void **)block;
+	--cache->counts[c];
+	return block;
+}
+
+// called with memlock held
+static void kr_memory_new_slab(int c) {
+	uint8_t *slab = (uint8_t *)tlsf_memalign(kr_tlsf, KR_MEMORY_SLAB_SIZE, KR_MEMORY_SLAB_SIZE);
+	if (slab == NULL) return;
+	kr_slab_map[((uintptr_t)slab - kr_slab_base) / KR_MEMORY_SLAB_SIZE] = (uint8_t)(c + 1);
+	size_t class_size = KR_MEMORY_CACHE_MIN << c;
+	for (size_t offset = 0; offset + class_size <= KR_MEMORY_SLAB_SIZE; offset += class_size) {
+		kr_memory_push(&kr_depot, c, slab + offset);
+	}
+}
+
+static void kr_memory_drain(kr_memory_cache_t *cache, int c, int keep) {
+	kinc_mutex_lock(&memlock);
+	while (cache->counts[c] > keep) kr_memory_push(&kr_depot, c, kr_memory_pop(cache, c));
+	kinc_mutex_unlock(&memlock);
+}
+
+static void *kr_memory_alloc(size_t size) {
+	void *ptr;
+	if (size > KR_MEMORY_CACHE_MAX) {
+		kinc_mutex_lock(&memlock);
+		ptr = tlsf_malloc(kr_tlsf, size);
+		kinc_mutex_unlock(&memlock);
+		return ptr;
+	}
+	kr_memory_cache_t *cache = kr_memory_get_cache();
+	int c = kr_memory_class(size);
+	if (cache->lists[c] == NULL) {
+		kinc_mutex_lock(&memlock);
+		if (kr_depot.counts[c] < KR_MEMORY_CACHE_BATCH) kr_memory_new_slab(c);
+		for (int i = 0; i < KR_MEMORY_CACHE_BATCH && kr_depot.lists[c] != NULL; ++i) {
+			kr_memory_push(cache, c, kr_memory_pop(&kr_depot, c));
+		}
+		// out of room for a whole slab, fall back to a plain TLSF block
+		ptr = cache->lists[c] == NULL ? tlsf_malloc(kr_tlsf, size) : NULL;
+		kinc_mutex_unlock(&memlock);
+		if (ptr != NULL || cache->lists[c] == NULL) return ptr;
+	}
+	return kr_memory_pop(cache, c);
+}
+
+static void kr_memory_release(void *ptr) {
+	int c = kr_memory_slab_class(ptr);
+	if (c < 0) {
+		kinc_mutex_lock(&memlock);
+		tlsf_free(kr_tlsf, ptr);
+		kinc_mutex_unlock(&memlock);
+		return;
+	}
+	kr_memory_cache_t *cache = kr_memory_get_cache();
+	kr_memory_push(cache, c, ptr);
+	if (cache->counts[c] > KR_MEMORY_CACHE_LIMIT) kr_memory_drain(cache, c, KR_MEMORY_CACHE_LIMIT - KR_MEMORY_CACHE_BATCH);
+}
+
 void kr_memory_init(void *ptr, size_t size) {
 	assert(kr_heap == NULL);
 	assert(ptr != NULL);
 	kr_heap = ptr;
 	kr_tlsf = tlsf_create_with_pool(ptr, size);
 	kinc_mutex_init(&memlock);
+	kinc_thread_local_init(&kr_cache_key);
+	kr_slab_base = (uintptr_t)ptr & ~(uintptr_t)(KR_MEMORY_SLAB_SIZE - 1);
+	size_t pages = ((uintptr_t)ptr + size - kr_slab_base) / KR_MEMORY_SLAB_SIZE + 1;
+	kr_slab_map = (uint8_t *)tlsf_malloc(kr_tlsf, pages);
+	assert(kr_slab_map);
+	memset(kr_slab_map, 0, pages);
 	kr_alloctrack_set_total(size);
 }
 
-void *kr_malloc(size_t size) {
+void kr_memory_thread_flush(void) {
 	assert(kr_heap != NULL);
+	kr_memory_cache_t *cache = (kr_memory_cache_t *)kinc_thread_local_get(&kr_cache_key);
+	if (cache == NULL) return;
+	for (int c = 0; c < KR_MEMORY_CACHE_CLASSES; ++c) kr_memory_drain(cache, c, 0);
+	kinc_thread_local_set(&kr_cache_key, NULL);
 	kinc_mutex_lock(&memlock);
-	void *ptr = tlsf_malloc(kr_tlsf, size);
+	tlsf_free(kr_tlsf, cache);
 	kinc_mutex_unlock(&memlock);
+}
+
+void *kr_try_malloc(size_t size) {
+	assert(kr_heap != NULL);
+	void *ptr = kr_memory_alloc(size);
+	if (ptr != NULL) kr_alloctrack_malloc(ptr, size);
+	return ptr;
+}
+
+void *kr_malloc(size_t size) {
+	void *ptr = kr_try_malloc(size);
 	assert(ptr);
-	kr_alloctrack_malloc(ptr, size);
 	return ptr;
 }
 
 void kr_free(void *ptr) {
 	assert(kr_heap != NULL);
 	kr_alloctrack_free(ptr);
-	kinc_mutex_lock(&memlock);
-	tlsf_free(kr_tlsf, ptr);
-	kinc_mutex_unlock(&memlock);
+	if (ptr == NULL) return;
+	kr_memory_release(ptr);
 }
 
 void *kr_calloc(size_t n, size_t size) {
 	// Naive implementation!!!
 	uint8_t *ptr = (uint8_t *)kr_malloc(n * size);
-	for (int i = 0; i < size; ++i) ptr[i] = 0;
+	for (size_t i = 0; i < n * size; ++i) ptr[i] = 0;
 	return ptr;
 }
 
-void *kr_realloc(void *ptr, size_t size) {
+void *kr_try_realloc(void *ptr, size_t size) {
 	assert(kr_heap != NULL);
-	kinc_mutex_lock(&memlock);
-	void *nptr = tlsf_realloc(kr_tlsf, ptr, size);
-	kinc_mutex_unlock(&memlock);
+	void *nptr;
+	int c = ptr != NULL ? kr_memory_slab_class(ptr) : -1;
+	if (c >= 0 && size <= (size_t)(KR_MEMORY_CACHE_MIN << c)) {
+		nptr = ptr;
+	}
+	else if (c >= 0 || (ptr != NULL && size <= KR_MEMORY_CACHE_MAX)) {
+		size_t old_size = KR_MEMORY_CACHE_MIN << c;
+		if (c < 0) {
+			kinc_mutex_lock(&memlock);
+			old_size = tlsf_block_size(ptr);
+			kinc_mutex_unlock(&memlock);
+		}
+		nptr = kr_memory_alloc(size);
+		if (nptr == NULL) return NULL;
+		memcpy(nptr, ptr, old_size < size ? old_size : size);
+		kr_memory_release(ptr);
+	}
+	else {
+		kinc_mutex_lock(&memlock);
+		nptr = tlsf_realloc(kr_tlsf, ptr, size);
+		kinc_mutex_unlock(&memlock);
+	}
+	if (nptr != NULL) kr_alloctrack_realloc(ptr, nptr, size);
+	return nptr;
+}
+
+void *kr_realloc(void *ptr, size_t size) {
+	void *nptr = kr_try_realloc(ptr, size);
 	assert(nptr);
-	kr_alloctrack_realloc(ptr, nptr, size);
 	return nptr;
 }
 
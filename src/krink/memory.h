@@ -18,12 +18,26 @@ extern "C" {
 /// <param name="size"></param>
 void kr_memory_init(void *ptr, size_t size);
 
+/// <summary>
+/// Returns the blocks cached by the calling thread to the heap. Small allocations
+/// are served from per-thread caches, threads that used the allocator should call
+/// this before they exit.
+/// </summary>
+void kr_memory_thread_flush(void);
+
 /// <summary>
 /// `malloc` equivalent.
 /// </summary>
 /// <param name="size"></param>
 void *kr_malloc(size_t size);
 
+/// <summary>
+/// `malloc` equivalent that returns NULL when the heap is exhausted, where
+/// `kr_malloc` asserts.
+/// </summary>
+/// <param name="size"></param>
+void *kr_try_malloc(size_t size);
+
 /// <summary>
 /// `free` equivalent.
 /// </summary>
@@ -44,6 +58,14 @@ void *kr_calloc(size_t n, size_t size);
 /// <param name="size"></param>
 void *kr_realloc(void *ptr, size_t size);
 
+/// <summary>
+/// `realloc` equivalent that returns NULL and leaves `ptr` as it was when the
+/// heap is exhausted, where `kr_realloc` asserts.
+/// </summary>
+/// <param name="ptr"></param>
+/// <param name="size"></param>
+void *kr_try_realloc(void *ptr, size_t size);
+
 /// <summary>
 /// When compiled in debug mode, tracks the number of allocations.
 /// </summary>
@@ -74,10 +96,13 @@ int kr_allocation_total(void);
 #include <stdlib.h>
 
 #define kr_memory_init(A, B)
+#define kr_memory_thread_flush()
 #define kr_malloc(SIZE) malloc(SIZE)
+#define kr_try_malloc(SIZE) malloc(SIZE)
 #define kr_free(PTR) free(PTR)
 #define kr_calloc(N, SIZE) calloc((N), (SIZE))
 #define kr_realloc(PTR, SIZE) realloc((PTR), (SIZE))
+#define kr_try_realloc(PTR, SIZE) realloc((PTR), (SIZE))
 
 #define kr_allocation_count() -1
 #define kr_allocation_size() -1
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <string.h>
+#include <krink/memory.h>
+#include "luaalloc.h"
+
+/* Allocator for the Lua state. Lua always passes the old size of a block, so
+** blocks need no header: requests of up to LUAALLOC_MAX bytes are rounded up
+** to a multiple of LUAALLOC_GRAIN and served from per-class free lists backed
+** by slabs from the krink heap, larger ones go to the krink heap directly.
+** Tables, strings, closures and upvalues churned by the GC then reuse slots of
+** their own size instead of fragmenting the TLSF pool. Failing allocations
+** return NULL, so Lua raises "not enough memory" instead of the krink heap
+** asserting. Lua runs on a single thread, so none of this is locked. */
+
+#define LUAALLOC_GRAIN 16
+#define LUAALLOC_MAX (LUAALLOC_GRAIN * LUAALLOC_CLASSES)
+#define LUAALLOC_SLAB_SIZE (64 * 1024)
+
+typedef struct Slab {
+  struct Slab *next;
+} Slab;
+
+typedef struct {
+  void *free_list;
+  char *bump, *bump_end;
+} SizeClass;
+
+static SizeClass classes[LUAALLOC_CLASSES];
+static LuaAllocStats stats;
+static Slab *slabs;
+
+
+static inline int size_class(size_t size) {
+  return (int) ((size + LUAALLOC_GRAIN - 1) / LUAALLOC_GRAIN) - 1;
+}
+
+
+static void* class_alloc(int c) {
+  SizeClass *sc = &classes[c];
+  LuaAllocClass *st = &stats.classes[c];
+  void *ptr = sc->free_list;
+  if (ptr) {
+    sc->free_list = *(void**) ptr;
+    st->free--;
+  } else {
+    size_t size = (size_t) (c + 1) * LUAALLOC_GRAIN;
+    if (!sc->bump || sc->bump + size > sc->bump_end) {
+      Slab *slab = kr_try_malloc(LUAALLOC_SLAB_SIZE);
+      if (!slab) { return NULL; }
+      slab->next = slabs;
+      slabs = slab;
+      stats.slabs++;
+      sc->bump = (char*) slab + LUAALLOC_GRAIN;
+      sc->bump_end = (char*) slab + LUAALLOC_SLAB_SIZE;
+    }
+    ptr = sc->bump;
+    sc->bump += size;
+  }
+  st->used++;
+  st->allocs++;
+  return ptr;
+}
+
+
+static void class_free(int c, void *ptr) {
+  *(void**) ptr = classes[c].free_list;
+  classes[c].free_list = ptr;
+  stats.classes[c].used--;
+  stats.classes[c].free++;
+}
+
+
+static void* large_alloc(size_t size) {
+  void *ptr = kr_try_malloc(size);
+  if (ptr) {
+    stats.large_blocks++;
+    stats.large_bytes += size;
+  }
+  return ptr;
+}
+
+
+static void large_free(void *ptr, size_t size) {
+  kr_free(ptr);
+  stats.large_blocks--;
+  stats.large_bytes -= size;
+}
+
+
+static void* alloc_fn(void *ud, void *ptr, size_t osize, size_t nsize) {
+  (void) ud;
+  /* for new blocks `osize` is the object type, not a size */
+  if (!ptr) { osize = 0; }
+
+  if (nsize == 0) {
+    if (!ptr) { return NULL; }
+    if (osize <= LUAALLOC_MAX) {
+      class_free(size_class(osize), ptr);
+    } else {
+      large_free(ptr, osize);
+    }
+    return NULL;
+  }
+
+  if (nsize <= LUAALLOC_MAX) {
+    int c = size_class(nsize);
+    if (ptr && osize <= LUAALLOC_MAX && size_class(osize) == c) { return ptr; }
+    void *nptr = class_alloc(c);
+    if (!nptr && ptr && nsize <= osize) {
+      /* Lua doesn't let a shrinking realloc fail, it shrinks inside the GC.
+      ** The old block is big enough, so it stays and from now on counts as
+      ** a slot of the smaller class: that is where it goes when Lua frees it
+      ** with its new size, its extra room unused */
+      if (osize > LUAALLOC_MAX) {
+        stats.large_blocks--;
+        stats.large_bytes -= osize;
+      } else {
+        stats.classes[size_class(osize)].used--;
+      }
+      stats.classes[c].used++;
+      return ptr;
+    }
+    if (!nptr) { return NULL; }
+    if (ptr) {
+      memcpy(nptr, ptr, osize < nsize ? osize : nsize);
+      alloc_fn(ud, ptr, osize, 0);
+    }
+    return nptr;
+  }
+
+  if (ptr && osize > LUAALLOC_MAX) {
+    void *nptr = kr_try_realloc(ptr, nsize);
+    /* the krink heap may move a shrinking block and fail to; as above, the
+    ** old one is big enough and kr_free() doesn't need its size */
+    if (!nptr && nsize <= osize) { nptr = ptr; }
+    if (nptr) { stats.large_bytes += nsize - osize; }
+    return nptr;
+  }
+  void *nptr = large_alloc(nsize);
+  if (nptr && ptr) {
+    memcpy(nptr, ptr, osize);
+    alloc_fn(ud, ptr, osize, 0);
+  }
+  return nptr;
+}
+
+
+static int panic(lua_State *L) {
+  fprintf(stderr, "PANIC: unprotected error in call to Lua API (%s)\n", lua_tostring(L, -1));
+  return 0;
+}
+
+
+/* luaL_newstate() with the pooled allocator */
+lua_State* luaalloc_newstate(void) {
+  for (int i = 0; i < LUAALLOC_CLASSES; i++) {
+    stats.classes[i].size = (size_t) (i + 1) * LUAALLOC_GRAIN;
+  }
+  lua_State *L = lua_newstate(alloc_fn, NULL);
+  if (L) { lua_atpanic(L, panic); }
+  return L;
+}
+
+
+/* releases the slabs; only valid once the state is closed */
+void luaalloc_close(void) {
+  while (slabs) {
+    Slab *next = slabs->next;
+    kr_free(slabs);
+    slabs = next;
+  }
+  memset(classes, 0, sizeof(classes));
+  memset(&stats, 0, sizeof(stats));
+}
+
+
+void luaalloc_get_stats(LuaAllocStats *out) {
+  *out = stats;
+}
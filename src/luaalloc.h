@@ -0,0 +1,26 @@
+#ifndef LUAALLOC_H
+#define LUAALLOC_H
+
+#include <stddef.h>
+#include "lib/lua52/lua.h"
+
+#define LUAALLOC_CLASSES 32
+
+typedef struct {
+  size_t size;    /* block size of the class */
+  size_t used;    /* blocks handed out to Lua */
+  size_t free;    /* blocks waiting on the free list */
+  size_t allocs;  /* allocations served since startup */
+} LuaAllocClass;
+
+typedef struct {
+  LuaAllocClass classes[LUAALLOC_CLASSES];
+  size_t slabs;
+  size_t large_blocks, large_bytes;
+} LuaAllocStats;
+
+lua_State* luaalloc_newstate(void);
+void luaalloc_close(void);
+void luaalloc_get_stats(LuaAllocStats *stats);
+
+#endif
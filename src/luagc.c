@@ -0,0 +1,165 @@
+#include <kinc/system.h>
+#include "luagc.h"
+
+/* Scheduler for the Lua collector. Left to itself, Lua collects whenever an
+** allocation pushes it over its debt, which is mostly in the middle of drawing
+** a frame. Instead `luagc_step` is called once per frame, in the time left
+** after the frame's work: it does at least the work the collector would have
+** done for what was allocated since the last call, so memory stays bounded
+** when frames run long, and keeps stepping while the budget lasts. A cycle
+** only starts once memory in use reaches LUAGC_PAUSE percent of what the last
+** one left, like the collector's own pause.
+**
+** The collector itself keeps running with a pause of LUAGC_BACKSTOP_PAUSE, so
+** it only starts a cycle on its own when a frame allocates far more than the
+** scheduler expects, and a failed allocation still gets an emergency
+** collection before Lua gives up. While a cycle runs it also steps along with
+** allocation as usual; if that finishes the cycle before the scheduler does,
+** the scheduler notices by a marker table that only a weak table refers to.
+**
+** While the smoothed allocation rate is above LUAGC_GEN_RATE, when most of
+** what is allocated is short-lived, the collector is switched to generational
+** mode and a (minor) collection is done whenever memory passes the same
+** threshold; it switches back once the rate has dropped well below that. */
+
+#define LUAGC_STEP_KB 64
+#define LUAGC_PAUSE 200
+#define LUAGC_BACKSTOP_PAUSE 400
+#define LUAGC_MIN_THRESHOLD_KB 1024
+#define LUAGC_GEN_RATE (32 * 1024)
+#define LUAGC_RATE_SMOOTHING 0.1
+
+static LuaGCStats stats;
+static double last_time;
+/* memory in use after the last call */
+static int last_kb;
+/* a cycle starts once memory in use reaches this */
+static int threshold_kb;
+static bool cycle_running;
+/* registry key of the weak table holding the marker */
+static char marker_key;
+
+
+static int count_kb(lua_State *L) {
+  return lua_gc(L, LUA_GCCOUNT, 0);
+}
+
+
+static void set_threshold(lua_State *L) {
+  threshold_kb = count_kb(L) / 100 * LUAGC_PAUSE;
+  if (threshold_kb < LUAGC_MIN_THRESHOLD_KB) { threshold_kb = LUAGC_MIN_THRESHOLD_KB; }
+}
+
+
+/* makes a new marker; called before the steps of a cycle, so the marker is
+** collected by that cycle */
+static void set_marker(lua_State *L) {
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &marker_key);
+  lua_newtable(L);
+  lua_rawseti(L, -2, 1);
+  lua_pop(L, 1);
+}
+
+
+/* whether the running cycle is still before its atomic phase, the rest of a
+** cycle being sweeps the scheduler's steps finish anyway */
+static bool marker_alive(lua_State *L) {
+  lua_rawgetp(L, LUA_REGISTRYINDEX, &marker_key);
+  lua_rawgeti(L, -1, 1);
+  bool alive = !lua_isnil(L, -1);
+  lua_pop(L, 2);
+  return alive;
+}
+
+
+static void end_cycle(lua_State *L) {
+  cycle_running = false;
+  set_threshold(L);
+}
+
+
+static void set_mode(lua_State *L, bool generational) {
+  if (generational == stats.generational) { return; }
+  /* either way this finishes the cycle that was running */
+  lua_gc(L, generational ? LUA_GCGEN : LUA_GCINC, 0);
+  stats.generational = generational;
+  stats.switches++;
+  end_cycle(L);
+}
+
+
+void luagc_init(lua_State *L) {
+  lua_newtable(L);
+  lua_createtable(L, 0, 1);
+  lua_pushliteral(L, "v");
+  lua_setfield(L, -2, "__mode");
+  lua_setmetatable(L, -2);
+  lua_rawsetp(L, LUA_REGISTRYINDEX, &marker_key);
+  lua_gc(L, LUA_GCSETPAUSE, LUAGC_BACKSTOP_PAUSE);
+  /* a full collection sets the collector's debt by the new pause */
+  lua_gc(L, LUA_GCCOLLECT, 0);
+  last_time = kinc_time();
+  last_kb = count_kb(L);
+  set_threshold(L);
+}
+
+
+/* collects for about `budget` seconds, or longer if the memory allocated since
+** the last call needs it */
+void luagc_step(lua_State *L, double budget) {
+  double start = kinc_time();
+  double dt = start - last_time;
+  int kb = count_kb(L);
+  int allocated = kb > last_kb ? kb - last_kb : 0;
+  if (dt > 0) {
+    stats.alloc_rate += (allocated / dt - stats.alloc_rate) * LUAGC_RATE_SMOOTHING;
+  }
+  if (stats.alloc_rate > LUAGC_GEN_RATE) {
+    set_mode(L, true);
+  } else if (stats.alloc_rate < LUAGC_GEN_RATE / 4) {
+    set_mode(L, false);
+  }
+
+  if (cycle_running && !marker_alive(L)) {
+    /* the collector got through the cycle by itself */
+    stats.backstop++;
+    end_cycle(L);
+  }
+  if (stats.generational) {
+    if (count_kb(L) >= threshold_kb) {
+      lua_gc(L, LUA_GCSTEP, 0);
+      stats.minor++;
+      set_threshold(L);
+    }
+  } else if (cycle_running || kb >= threshold_kb) {
+    double deadline = start + budget;
+    int size = allocated > LUAGC_STEP_KB ? allocated : LUAGC_STEP_KB;
+    if (!cycle_running) {
+      set_marker(L);
+      /* the debt the backstop pause left would shrink the steps to almost
+      ** nothing */
+      lua_gc(L, LUA_GCRESTART, 0);
+      cycle_running = true;
+    }
+    do {
+      stats.steps++;
+      if (lua_gc(L, LUA_GCSTEP, size)) {
+        stats.cycles++;
+        end_cycle(L);
+        break;
+      }
+      size = LUAGC_STEP_KB;
+    } while (kinc_time() < deadline);
+  }
+
+  last_time = kinc_time();
+  last_kb = count_kb(L);
+  stats.pause = last_time - start;
+  if (stats.pause > stats.max_pause) { stats.max_pause = stats.pause; }
+  stats.total += stats.pause;
+}
+
+
+void luagc_get_stats(LuaGCStats *out) {
+  *out = stats;
+}
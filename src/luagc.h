@@ -0,0 +1,24 @@
+#ifndef LUAGC_H
+#define LUAGC_H
+
+#include <stdbool.h>
+#include "lib/lua52/lua.h"
+
+typedef struct {
+  bool generational;
+  double pause;        /* seconds spent collecting in the last call */
+  double max_pause;    /* longest of those */
+  double total;        /* seconds spent collecting altogether */
+  double alloc_rate;   /* smoothed allocation rate in KB per second */
+  size_t steps;        /* incremental steps taken */
+  size_t cycles;       /* incremental cycles finished */
+  size_t backstop;     /* cycles the collector finished on its own */
+  size_t minor;        /* generational collections */
+  size_t switches;     /* changes between the two modes */
+} LuaGCStats;
+
+void luagc_init(lua_State *L);
+void luagc_step(lua_State *L, double budget);
+void luagc_get_stats(LuaGCStats *stats);
+
+#endif
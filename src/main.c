@@ -6,6 +6,8 @@
 #include <krink/eventhandler.h>
 #include "api/api.h"
 #include "renderer.h"
+#include "luaalloc.h"
+#include "luagc.h"
 
 #ifdef _WIN32
   #include <windows.h>
@@ -57,6 +59,9 @@
 #endif
 
 static double get_scale(void) {
+#ifdef LITE_HEADLESS
+  return 1.0;
+#endif
   kinc_display_mode_t mode = kinc_display_current_mode(kinc_primary_display());
 #if _WIN32
   return mode.pixels_per_inch / 96.0;
@@ -84,20 +89,120 @@ static void get_exe_filename(char *buf, int sz) {
 }
 
 extern void event_handler(kr_evt_event_t event);
+extern void system_record_frame_time(double seconds);
 lua_State *L = NULL;
 
+/* `kore.run` and the error handler are compiled once and kept in the registry
+** so each frame is a plain lua_pcall instead of a parse + compile */
+static int run_ref = LUA_NOREF;
+static int error_handler_ref = LUA_NOREF;
+
+static const char *error_handler_src =
+  "local err = ...\n"
+  "print('Error: ' .. tostring(err))\n"
+  "print(debug.traceback(nil, 2))\n"
+  "if kore and kore.on_error then\n"
+  "  pcall(kore.on_error, err)\n"
+  "end\n"
+  "os.exit(1)";
+
+static void init_frame_entry(void) {
+  if (luaL_loadstring(L, error_handler_src) != LUA_OK) {
+    fprintf(stderr, "Error: %s\n", lua_tostring(L, -1));
+    exit(EXIT_FAILURE);
+  }
+  error_handler_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+
+  lua_getglobal(L, "kore");
+  lua_getfield(L, -1, "run");
+  if (!lua_isfunction(L, -1)) {
+    fprintf(stderr, "Error: kore.run is not a function\n");
+    exit(EXIT_FAILURE);
+  }
+  run_ref = luaL_ref(L, LUA_REGISTRYINDEX);
+  lua_pop(L, 1);
+}
+
 void update(void* data){
-    (void) luaL_dostring(L,
-    "xpcall(kore.run\n"
-    ", function(err)\n"
-    "  print('Error: ' .. tostring(err))\n"
-    "  print(debug.traceback(nil, 2))\n"
-    "  if kore and kore.on_error then\n"
-    "    pcall(kore.on_error, err)\n"
-    "  end\n"
-    "  os.exit(1)\n"
-    "end)");
+  double start = kinc_time();
+  lua_rawgeti(L, LUA_REGISTRYINDEX, error_handler_ref);
+  lua_rawgeti(L, LUA_REGISTRYINDEX, run_ref);
+  if (lua_pcall(L, 0, 0, -2) != LUA_OK) {
+    /* only reached if the error handler itself failed */
+    fprintf(stderr, "Error: %s\n", lua_tostring(L, -1));
+    exit(EXIT_FAILURE);
+  }
+  lua_pop(L, 1);
+  system_record_frame_time(kinc_time() - start);
+}
+
+#ifdef LITE_HEADLESS
+/* Headless runs are configured from the environment so the same binary can
+** be scripted by benchmarks and golden-image checks:
+**   LITE_HEADLESS_SIZE     framebuffer size, e.g. "1280x800"
+**   LITE_HEADLESS_FRAMES   number of steps of the main loop to run
+**   LITE_HEADLESS_DUMP     directory to write every redrawn frame to as PPM
+**   LITE_HEADLESS_TIMINGS  file to write the time of each frame to as CSV */
+static int headless_frames = 300;
+
+
+static void init_headless(void) {
+  int w = 1280, h = 800;
+  const char *size = getenv("LITE_HEADLESS_SIZE");
+  if (size && (sscanf(size, "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0)) {
+    fprintf(stderr, "Error: invalid LITE_HEADLESS_SIZE '%s'\n", size);
+    exit(EXIT_FAILURE);
+  }
+  const char *frames = getenv("LITE_HEADLESS_FRAMES");
+  if (frames) { headless_frames = atoi(frames); }
+  ren_set_headless(w, h, getenv("LITE_HEADLESS_DUMP"));
+}
+
+
+static int compare_double(const void *a, const void *b) {
+  double x = *(const double*) a, y = *(const double*) b;
+  return (x > y) - (x < y);
+}
+
+
+static void run_headless(void) {
+  if (headless_frames <= 0) { return; }
+  double *times = malloc(headless_frames * sizeof(double));
+  if (!times) {
+    fprintf(stderr, "Error: out of memory\n");
+    exit(EXIT_FAILURE);
+  }
+  double total = 0.0;
+  for (int i = 0; i < headless_frames; i++) {
+    double start = kinc_time();
+    update(NULL);
+    times[i] = kinc_time() - start;
+    total += times[i];
+  }
+
+  const char *timings = getenv("LITE_HEADLESS_TIMINGS");
+  if (timings) {
+    FILE *fp = fopen(timings, "w");
+    if (fp) {
+      fprintf(fp, "frame,ms\n");
+      for (int i = 0; i < headless_frames; i++) {
+        fprintf(fp, "%d,%.3f\n", i, times[i] * 1000.0);
+      }
+      fclose(fp);
+    } else {
+      fprintf(stderr, "Warning: could not write %s\n", timings);
+    }
+  }
+
+  qsort(times, headless_frames, sizeof(double), compare_double);
+  printf("frames: %d  mean: %.3f ms  median: %.3f ms  p95: %.3f ms  max: %.3f ms\n",
+    headless_frames, total / headless_frames * 1000.0,
+    times[headless_frames / 2] * 1000.0,
+    times[(int) (headless_frames * 0.95)] * 1000.0,
+    times[headless_frames - 1] * 1000.0);
+  free(times);
 }
+#endif
 
 int kickstart(int argc, char **argv) {
 #ifdef _WIN32
@@ -106,11 +211,15 @@ int kickstart(int argc, char **argv) {
   SetProcessDPIAware();
 #endif
 
+#ifdef LITE_HEADLESS
+  init_headless();
+#else
   kinc_display_init();
   kinc_display_mode_t dm = kinc_display_current_mode(kinc_primary_display());
 
   
   kinc_init("lit",dm.width * 0.8,dm.height * 0.8,NULL,NULL);
+#endif
   size_t mem_size = 1024 * 1024 * 1024;// 1 Gig
   void* memblck = malloc(mem_size);
   kr_init(memblck,mem_size,NULL,0);
@@ -119,7 +228,7 @@ int kickstart(int argc, char **argv) {
 
   ren_init();
 
-  L = luaL_newstate();
+  L = luaalloc_newstate();
   luaL_openlibs(L);
   api_load_libs(L);
 
@@ -143,6 +252,11 @@ int kickstart(int argc, char **argv) {
   lua_pushnumber(L, get_scale());
   lua_setglobal(L, "SCALE");
 
+#ifdef LITE_HEADLESS
+  lua_pushboolean(L, 1);
+  lua_setglobal(L, "HEADLESS");
+#endif
+
   char exename[2048];
   get_exe_filename(exename, sizeof(exename));
   lua_pushstring(L, exename);
@@ -166,12 +280,22 @@ int kickstart(int argc, char **argv) {
     "  end\n"
     "  os.exit(1)\n"
     "end)");
+  init_frame_entry();
+  /* from here on garbage is collected between frames, see luagc.c */
+  luagc_init(L);
+#ifdef LITE_HEADLESS
+  run_headless();
+#else
   kinc_set_update_callback(update,NULL);
 
   kinc_start();
+#endif
 
 
+  luaL_unref(L, LUA_REGISTRYINDEX, run_ref);
+  luaL_unref(L, LUA_REGISTRYINDEX, error_handler_ref);
   lua_close(L);
+  luaalloc_close();
   
   free(memblck);
   return EXIT_SUCCESS;
@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include "mapfile.h"
+
+#ifdef _WIN32
+  #include <windows.h>
+  #include "utfconv.h"
+#else
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+
+/* maps a regular file read-only; `*data` stays NULL for empty files */
+bool map_file(const char *filename, char **data, size_t *size) {
+  *data = NULL;
+#ifdef _WIN32
+  LPWSTR wpath = utfconv_utf8towc(filename);
+  if (!wpath) { return false; }
+  HANDLE file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  free(wpath);
+  if (file == INVALID_HANDLE_VALUE) { return false; }
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(file, &file_size)) {
+    CloseHandle(file);
+    return false;
+  }
+  *size = (size_t) file_size.QuadPart;
+  if (*size > 0) {
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping) {
+      *data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+      CloseHandle(mapping);
+    }
+  }
+  CloseHandle(file);
+#else
+  int fd = open(filename, O_RDONLY);
+  if (fd < 0) { return false; }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  *size = st.st_size;
+  if (*size > 0) {
+    void *p = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p != MAP_FAILED) { *data = p; }
+  }
+  close(fd);
+#endif
+  return *size == 0 || *data != NULL;
+}
+
+
+void unmap_file(char *data, size_t size) {
+#ifdef _WIN32
+  UnmapViewOfFile(data);
+#else
+  munmap(data, size);
+#endif
+}
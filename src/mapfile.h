@@ -0,0 +1,10 @@
+#ifndef MAPFILE_H
+#define MAPFILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+bool map_file(const char *filename, char **data, size_t *size);
+void unmap_file(char *data, size_t size);
+
+#endif
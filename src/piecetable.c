@@ -0,0 +1,511 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "piecetable.h"
+#include "mapfile.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define PT_SSE2
+#endif
+
+/* The document is a sequence of pieces, each a byte range of either the
+** original file or an append-only add buffer. Pieces live in a treap keyed by
+** position; every node caches the byte and newline totals of its subtree so
+** that edits and line lookups are O(log n). Newline offsets of both sources
+** are recorded once, which lets a piece find its n-th newline without
+** scanning its bytes. Buffers are allocated with malloc as documents can be
+** much larger than the krink heap.
+**
+** Files are memory mapped and only referenced, so opening a file costs one
+** newline scan and memory for the index. The original source only records
+** every 64th newline and finds the ones in between with memchr. A mapping is
+** only valid while nobody else rewrites the file, so saving and noticing an
+** outside change copy the source into memory first (pt_detach). */
+
+#define ORIGINAL_NEWLINE_SHIFT 6
+
+enum { SOURCE_ORIGINAL, SOURCE_ADD };
+
+typedef struct {
+  char *data;
+  size_t length, capacity;
+  /* offset of every (1 << shift)-th newline */
+  size_t *newlines;
+  size_t newline_capacity, checkpoint_count;
+  size_t newline_count;
+  int shift;
+  bool mapped;
+} Source;
+
+typedef struct Node Node;
+
+struct Node {
+  Node *left, *right;
+  unsigned priority;
+  int source;
+  size_t start, length;
+  size_t nl_first, nl_count;
+  size_t sum_length, sum_nl;
+};
+
+struct PieceTable {
+  Source sources[2];
+  Node *root;
+  unsigned seed;
+};
+
+
+static void* check_alloc(void *ptr) {
+  if (!ptr) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+static unsigned next_priority(PieceTable *pt) {
+  /* xorshift32 */
+  unsigned x = pt->seed;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return pt->seed = x;
+}
+
+
+static size_t lower_bound(const size_t *arr, size_t lo, size_t hi, size_t value) {
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (arr[mid] < value) { lo = mid + 1; } else { hi = mid; }
+  }
+  return lo;
+}
+
+
+static void source_add_newline(Source *src, size_t offset) {
+  if ((src->newline_count & ((1 << src->shift) - 1)) == 0) {
+    if (src->checkpoint_count == src->newline_capacity) {
+      src->newline_capacity = src->newline_capacity ? src->newline_capacity * 2 : 256;
+      src->newlines = check_alloc(realloc(src->newlines, src->newline_capacity * sizeof(size_t)));
+    }
+    src->newlines[src->checkpoint_count++] = offset;
+  }
+  src->newline_count++;
+}
+
+
+static void source_add_newlines(Source *src, size_t from) {
+  const char *p = src->data + from;
+  const char *end = src->data + src->length;
+  while ((p = memchr(p, '\n', end - p))) {
+    source_add_newline(src, p - src->data);
+    p++;
+  }
+}
+
+
+#ifdef PT_SSE2
+static inline int count_trailing_zeros(unsigned x) {
+#ifdef _MSC_VER
+  unsigned long idx;
+  _BitScanForward(&idx, x);
+  return idx;
+#else
+  return __builtin_ctz(x);
+#endif
+}
+#endif
+
+
+/* indexes the newlines of the whole source 16 bytes at a time, returns true
+** if a carriage return was seen */
+static bool source_scan(Source *src) {
+  const char *data = src->data;
+  size_t len = src->length, i = 0;
+  bool has_cr = false;
+#ifdef PT_SSE2
+  const __m128i nl = _mm_set1_epi8('\n');
+  const __m128i cr = _mm_set1_epi8('\r');
+  unsigned cr_mask = 0;
+  for (; i + 16 <= len; i += 16) {
+    __m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+    unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, nl));
+    cr_mask |= _mm_movemask_epi8(_mm_cmpeq_epi8(v, cr));
+    while (mask) {
+      source_add_newline(src, i + count_trailing_zeros(mask));
+      mask &= mask - 1;
+    }
+  }
+  has_cr = cr_mask != 0;
+#endif
+  for (; i < len; i++) {
+    if (data[i] == '\n') { source_add_newline(src, i); }
+    if (data[i] == '\r') { has_cr = true; }
+  }
+  return has_cr;
+}
+
+
+/* returns the offset of the k-th (0-based) newline */
+static size_t source_newline(Source *src, size_t k) {
+  size_t i = k >> src->shift;
+  const char *p = src->data + src->newlines[i];
+  const char *end = src->data + src->length;
+  for (size_t n = k - (i << src->shift); n > 0; n--) {
+    p = memchr(p + 1, '\n', end - p - 1);
+  }
+  return p - src->data;
+}
+
+
+/* returns the number of newlines before `offset` */
+static size_t source_newlines_before(Source *src, size_t offset) {
+  size_t i = lower_bound(src->newlines, 0, src->checkpoint_count, offset);
+  if (src->shift == 0 || i == 0) { return i; }
+  size_t count = ((i - 1) << src->shift) + 1;
+  const char *p = src->data + src->newlines[i - 1] + 1;
+  const char *end = src->data + offset;
+  while (p < end && (p = memchr(p, '\n', end - p))) {
+    count++;
+    p++;
+  }
+  return count;
+}
+
+
+static size_t sum_length(Node *n) { return n ? n->sum_length : 0; }
+static size_t sum_nl(Node *n) { return n ? n->sum_nl : 0; }
+
+
+static void update(Node *n) {
+  n->sum_length = n->length + sum_length(n->left) + sum_length(n->right);
+  n->sum_nl = n->nl_count + sum_nl(n->left) + sum_nl(n->right);
+}
+
+
+static Node* new_node(PieceTable *pt, int source, size_t start, size_t length, unsigned priority) {
+  Source *src = &pt->sources[source];
+  Node *n = check_alloc(calloc(1, sizeof(Node)));
+  n->priority = priority;
+  n->source = source;
+  n->start = start;
+  n->length = length;
+  n->nl_first = source_newlines_before(src, start);
+  n->nl_count = source_newlines_before(src, start + length) - n->nl_first;
+  update(n);
+  return n;
+}
+
+
+static void free_tree(Node *n) {
+  if (!n) { return; }
+  free_tree(n->left);
+  free_tree(n->right);
+  free(n);
+}
+
+
+static Node* merge(Node *a, Node *b) {
+  if (!a) { return b; }
+  if (!b) { return a; }
+  if (a->priority > b->priority) {
+    a->right = merge(a->right, b);
+    update(a);
+    return a;
+  }
+  b->left = merge(a, b->left);
+  update(b);
+  return b;
+}
+
+
+/* splits `n` into the bytes before `pos` and the bytes from `pos` on, cutting
+** a piece in two if `pos` falls inside of it */
+static void split(PieceTable *pt, Node *n, size_t pos, Node **l, Node **r) {
+  if (!n) {
+    *l = *r = NULL;
+    return;
+  }
+  size_t left_len = sum_length(n->left);
+  if (pos <= left_len) {
+    split(pt, n->left, pos, l, &n->left);
+    update(n);
+    *r = n;
+    return;
+  }
+  if (pos >= left_len + n->length) {
+    split(pt, n->right, pos - left_len - n->length, &n->right, r);
+    update(n);
+    *l = n;
+    return;
+  }
+  size_t at = pos - left_len;
+  Node *tail = new_node(pt, n->source, n->start + at, n->length - at, n->priority);
+  tail->right = n->right;
+  update(tail);
+  n->length = at;
+  n->nl_count = tail->nl_first - n->nl_first;
+  n->right = NULL;
+  update(n);
+  *l = n;
+  *r = tail;
+}
+
+
+PieceTable* pt_new(void) {
+  PieceTable *pt = check_alloc(calloc(1, sizeof(PieceTable)));
+  pt->seed = 0x9e3779b9;
+  Source *src = &pt->sources[SOURCE_ORIGINAL];
+  src->data = check_alloc(malloc(1));
+  src->data[0] = '\n';
+  src->length = src->capacity = 1;
+  source_add_newlines(src, 0);
+  pt->root = new_node(pt, SOURCE_ORIGINAL, 0, 1, next_priority(pt));
+  return pt;
+}
+
+
+static void source_free(Source *src) {
+  if (src->mapped) {
+    unmap_file(src->data, src->length);
+  } else {
+    free(src->data);
+  }
+  free(src->newlines);
+}
+
+
+PieceTable* pt_load(const char *filename, bool *crlf) {
+  char *data;
+  size_t size;
+  if (!map_file(filename, &data, &size)) { return NULL; }
+  *crlf = false;
+  if (size == 0) { return pt_new(); }
+
+  PieceTable *pt = check_alloc(calloc(1, sizeof(PieceTable)));
+  pt->seed = 0x9e3779b9;
+  Source *src = &pt->sources[SOURCE_ORIGINAL];
+  src->data = data;
+  src->length = src->capacity = size;
+  src->shift = ORIGINAL_NEWLINE_SHIFT;
+  src->mapped = true;
+
+  if (source_scan(src)) {
+    /* "\r\n" line endings are stripped, which needs a private copy */
+    char *copy = check_alloc(malloc(size));
+    char *dst = copy;
+    for (const char *p = data; p < data + size; p++) {
+      if (*p == '\r' && p + 1 < data + size && p[1] == '\n') {
+        *crlf = true;
+        continue;
+      }
+      *dst++ = *p;
+    }
+    source_free(src);
+    src->data = copy;
+    src->length = src->capacity = dst - copy;
+    src->mapped = false;
+    src->newlines = NULL;
+    src->newline_capacity = src->checkpoint_count = src->newline_count = 0;
+    source_scan(src);
+  }
+
+  if (src->length > 0) {
+    pt->root = new_node(pt, SOURCE_ORIGINAL, 0, src->length, next_priority(pt));
+  }
+  /* every document ends with a newline; the mapping can't be extended */
+  if (src->length == 0 || src->data[src->length - 1] != '\n') {
+    pt_insert(pt, src->length, "\n", 1);
+  }
+  return pt;
+}
+
+
+/* copies a mapped original source into memory, so the document no longer
+** reads the file. `file_size` is the size the file has now: if it shrank, the
+** end of the mapping can't be read anymore and false is returned */
+bool pt_detach(PieceTable *pt, size_t file_size) {
+  Source *src = &pt->sources[SOURCE_ORIGINAL];
+  if (!src->mapped) { return true; }
+  if (file_size < src->length) { return false; }
+  char *copy = check_alloc(malloc(src->length));
+  memcpy(copy, src->data, src->length);
+  unmap_file(src->data, src->length);
+  src->data = copy;
+  src->mapped = false;
+  return true;
+}
+
+
+void pt_free(PieceTable *pt) {
+  free_tree(pt->root);
+  for (int i = 0; i < 2; i++) {
+    source_free(&pt->sources[i]);
+  }
+  free(pt);
+}
+
+
+size_t pt_length(PieceTable *pt) {
+  return sum_length(pt->root);
+}
+
+
+size_t pt_line_count(PieceTable *pt) {
+  return sum_nl(pt->root);
+}
+
+
+/* returns the byte offset of the n-th newline (1-based) */
+static size_t find_newline(PieceTable *pt, size_t n) {
+  Node *node = pt->root;
+  size_t base = 0;
+  while (node) {
+    size_t left_nl = sum_nl(node->left);
+    if (n <= left_nl) {
+      node = node->left;
+      continue;
+    }
+    n -= left_nl;
+    base += sum_length(node->left);
+    if (n <= node->nl_count) {
+      Source *src = &pt->sources[node->source];
+      return base + source_newline(src, node->nl_first + n - 1) - node->start;
+    }
+    n -= node->nl_count;
+    base += node->length;
+    node = node->right;
+  }
+  return base;
+}
+
+
+/* lines are 1-based and include their trailing newline */
+size_t pt_line_offset(PieceTable *pt, size_t line) {
+  if (line <= 1) { return 0; }
+  if (line > pt_line_count(pt)) { return pt_length(pt); }
+  return find_newline(pt, line - 1) + 1;
+}
+
+
+size_t pt_line_length(PieceTable *pt, size_t line) {
+  if (line < 1 || line > pt_line_count(pt)) { return 0; }
+  return find_newline(pt, line) + 1 - pt_line_offset(pt, line);
+}
+
+
+void pt_position(PieceTable *pt, size_t offset, size_t *line, size_t *col) {
+  size_t count = 0, remaining = offset;
+  Node *node = pt->root;
+  while (node) {
+    size_t left_len = sum_length(node->left);
+    if (remaining < left_len) {
+      node = node->left;
+      continue;
+    }
+    remaining -= left_len;
+    count += sum_nl(node->left);
+    if (remaining < node->length) {
+      Source *src = &pt->sources[node->source];
+      count += source_newlines_before(src, node->start + remaining) - node->nl_first;
+      break;
+    }
+    remaining -= node->length;
+    count += node->nl_count;
+    node = node->right;
+  }
+  *line = count + 1;
+  *col = offset - pt_line_offset(pt, *line) + 1;
+}
+
+
+void pt_insert(PieceTable *pt, size_t offset, const char *text, size_t len) {
+  if (len == 0) { return; }
+  Source *src = &pt->sources[SOURCE_ADD];
+  size_t start = src->length;
+  if (src->length + len > src->capacity) {
+    while (src->length + len > src->capacity) {
+      src->capacity = src->capacity ? src->capacity * 2 : 4096;
+    }
+    src->data = check_alloc(realloc(src->data, src->capacity));
+  }
+  memcpy(src->data + start, text, len);
+  src->length += len;
+  size_t nl_before = src->newline_count;
+  source_add_newlines(src, start);
+  size_t nl = src->newline_count - nl_before;
+
+  Node *l, *r;
+  split(pt, pt->root, offset, &l, &r);
+
+  /* typing appends to the add buffer right behind the previous insert, in
+  ** which case the piece before the cursor simply grows */
+  Node *last = l;
+  while (last && last->right) { last = last->right; }
+  if (last && last->source == SOURCE_ADD && last->start + last->length == start) {
+    for (Node *n = l; n; n = n->right) {
+      n->sum_length += len;
+      n->sum_nl += nl;
+    }
+    last->length += len;
+    last->nl_count += nl;
+  } else {
+    l = merge(l, new_node(pt, SOURCE_ADD, start, len, next_priority(pt)));
+  }
+  pt->root = merge(l, r);
+}
+
+
+void pt_remove(PieceTable *pt, size_t offset, size_t len) {
+  if (len == 0) { return; }
+  Node *a, *b, *mid, *c;
+  split(pt, pt->root, offset, &a, &b);
+  split(pt, b, len, &mid, &c);
+  free_tree(mid);
+  pt->root = merge(a, c);
+}
+
+
+static int each_node(PieceTable *pt, Node *n, size_t base, size_t from, size_t to,
+  PieceTableEachFn fn, void *udata
+) {
+  if (!n || from >= to) { return 0; }
+  size_t node_start = base + sum_length(n->left);
+  size_t node_end = node_start + n->length;
+  int res;
+  if (from < node_start) {
+    if ((res = each_node(pt, n->left, base, from, to, fn, udata))) { return res; }
+  }
+  size_t s = from > node_start ? from : node_start;
+  size_t e = to < node_end ? to : node_end;
+  if (s < e) {
+    const char *data = pt->sources[n->source].data + n->start + (s - node_start);
+    if ((res = fn(data, e - s, udata))) { return res; }
+  }
+  if (to > node_end) {
+    return each_node(pt, n->right, node_end, from, to, fn, udata);
+  }
+  return 0;
+}
+
+
+/* calls `fn` with the raw byte ranges making up [offset, offset + len); stops
+** early and returns the first non-zero result of `fn` */
+int pt_each(PieceTable *pt, size_t offset, size_t len, PieceTableEachFn fn, void *udata) {
+  return each_node(pt, pt->root, 0, offset, offset + len, fn, udata);
+}
+
+
+static int copy_fn(const char *data, size_t len, void *udata) {
+  char **dst = udata;
+  memcpy(*dst, data, len);
+  *dst += len;
+  return 0;
+}
+
+
+void pt_copy(PieceTable *pt, size_t offset, size_t len, char *dst) {
+  pt_each(pt, offset, len, copy_fn, &dst);
+}
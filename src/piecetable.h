@@ -0,0 +1,25 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct PieceTable PieceTable;
+
+typedef int (*PieceTableEachFn)(const char *data, size_t len, void *udata);
+
+PieceTable* pt_new(void);
+PieceTable* pt_load(const char *filename, bool *crlf);
+void   pt_free(PieceTable *pt);
+bool   pt_detach(PieceTable *pt, size_t file_size);
+size_t pt_length(PieceTable *pt);
+size_t pt_line_count(PieceTable *pt);
+size_t pt_line_offset(PieceTable *pt, size_t line);
+size_t pt_line_length(PieceTable *pt, size_t line);
+void   pt_position(PieceTable *pt, size_t offset, size_t *line, size_t *col);
+void   pt_insert(PieceTable *pt, size_t offset, const char *text, size_t len);
+void   pt_remove(PieceTable *pt, size_t offset, size_t len);
+void   pt_copy(PieceTable *pt, size_t offset, size_t len, char *dst);
+int    pt_each(PieceTable *pt, size_t offset, size_t len, PieceTableEachFn fn, void *udata);
+
+#endif
@@ -0,0 +1,878 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rencache.h"
+
+/* a cache over the software renderer -- all drawing operations are stored as
+** commands when issued. At the end of the frame we write the commands to a grid
+** of hash values, take the cells that have changed since the previous frame,
+** merge them into dirty rectangles and redraw only those regions.
+**
+** Scroll regions keep their own grid of cells in content space: when a region
+** is only scrolled, the part that stays visible is moved with `ren_scroll_rect`
+** and just the cells which came into view or changed are redrawn.
+**
+** While hashing, draw commands are also bucketed by the cells they overlap, so
+** redrawing a rect only replays the commands which can touch it. Changed cells
+** are coalesced into runs per row which grow downwards over identical runs,
+** the resulting rects are then merged where that adds little overdraw.
+**
+** With a renderer that can draw from several threads the dirty rects are cut
+** along a grid of tiles. Each tile collects the commands overlapping it and is
+** replayed on its own; tiles never share a pixel, so they are drawn in
+** parallel */
+
+#define CELLS_X 80
+#define CELLS_Y 50
+#define CELL_SIZE 96
+#define COMMAND_BUF_SIZE (1024 * 512)
+#define MAX_SCROLL_REGIONS 8
+#define REGION_ROWS (CELLS_Y + 2)
+#define RECT_BUF_SIZE (CELLS_X * CELLS_Y / 2)
+#define TILE_SIZE (CELL_SIZE * 2)
+#define TILES_X (CELLS_X / 2)
+#define TILES_Y (CELLS_Y / 2)
+#define MAX_TILE_FONTS 32
+#define MERGE_WASTE (CELL_SIZE * CELL_SIZE / 2)
+#define MERGE_PASSES 4
+
+enum { FREE_FONT, SET_CLIP, DRAW_TEXT, DRAW_LINE, DRAW_RECT, BEGIN_SCROLL, END_SCROLL };
+
+typedef struct {
+  int type, size;
+  RenRect rect;
+  RenColor color;
+  RenFont *font;
+  int tab_width;
+  int scroll;
+  char text[0];
+} Command;
+
+typedef struct ScrollRegion ScrollRegion;
+struct ScrollRegion {
+  RenRect rect;
+  int scroll;
+  int first_row;   /* content row of the first row of cells */
+  ScrollRegion *prev;   /* same region in the previous frame, if any */
+  bool moved;
+  bool opaque;   /* fully painted over by an opaque fill */
+  RenRect overlay;   /* bounds of what was drawn over it from outside */
+  unsigned cells[CELLS_X * REGION_ROWS];
+};
+
+
+static unsigned cells_buf1[CELLS_X * CELLS_Y];
+static unsigned cells_buf2[CELLS_X * CELLS_Y];
+static unsigned *cells_prev = cells_buf1;
+static unsigned *cells = cells_buf2;
+static ScrollRegion regions_buf1[MAX_SCROLL_REGIONS];
+static ScrollRegion regions_buf2[MAX_SCROLL_REGIONS];
+static ScrollRegion *regions_prev = regions_buf1;
+static ScrollRegion *regions = regions_buf2;
+static int region_count_prev;
+static int region_count;
+static RenRect rect_buf[RECT_BUF_SIZE];
+static char command_buf[COMMAND_BUF_SIZE];
+static int command_buf_idx;
+static RenRect screen_rect;
+static bool show_debug;
+
+typedef struct {
+  Command *cmd;
+  RenRect clip;
+  RenRect bounds;   /* part of the screen the command can touch */
+} Draw;
+
+static Draw *draws;
+static int draw_count, draw_capacity;
+static int bucket_start[CELLS_X * CELLS_Y + 1];
+static int *bucket_items;
+static int bucket_capacity;
+static int *gather_buf;
+static int gather_capacity;
+
+#ifdef REN_THREADED
+typedef struct {
+  RenRect *rects;
+  int rect_count, rect_capacity;
+  int *draws;
+  int draw_count, draw_capacity;
+} Tile;
+
+static Tile tiles[TILES_X * TILES_Y];
+static int tile_list[TILES_X * TILES_Y];
+#endif
+
+
+static inline int min(int a, int b) { return a < b ? a : b; }
+static inline int max(int a, int b) { return a > b ? a : b; }
+static inline int floor_div(int a, int b) { return a / b - (a % b < 0); }
+
+/* 32bit fnv-1a hash */
+#define HASH_INITIAL 2166136261
+
+static void hash(unsigned *h, const void *data, int size) {
+  const unsigned char *p = data;
+  while (size--) {
+    *h = (*h ^ *p++) * 16777619;
+  }
+}
+
+
+static inline int cell_idx(int x, int y) {
+  return x + y * CELLS_X;
+}
+
+
+static inline bool rects_overlap(RenRect a, RenRect b) {
+  return b.x + b.width  >= a.x && b.x <= a.x + a.width
+      && b.y + b.height >= a.y && b.y <= a.y + a.height;
+}
+
+
+static inline bool rect_contains(RenRect a, RenRect b) {
+  return b.x >= a.x && b.y >= a.y
+      && b.x + b.width <= a.x + a.width && b.y + b.height <= a.y + a.height;
+}
+
+
+static inline bool rects_equal(RenRect a, RenRect b) {
+  return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+}
+
+
+static RenRect intersect_rects(RenRect a, RenRect b) {
+  int x1 = max(a.x, b.x);
+  int y1 = max(a.y, b.y);
+  int x2 = min(a.x + a.width, b.x + b.width);
+  int y2 = min(a.y + a.height, b.y + b.height);
+  return (RenRect) { x1, y1, max(0, x2 - x1), max(0, y2 - y1) };
+}
+
+
+static RenRect merge_rects(RenRect a, RenRect b) {
+  int x1 = min(a.x, b.x);
+  int y1 = min(a.y, b.y);
+  int x2 = max(a.x + a.width, b.x + b.width);
+  int y2 = max(a.y + a.height, b.y + b.height);
+  return (RenRect) { x1, y1, x2 - x1, y2 - y1 };
+}
+
+
+static Command* push_command(int type, int size) {
+  Command *cmd = (Command*) (command_buf + command_buf_idx);
+  int n = command_buf_idx + size;
+  if (n > COMMAND_BUF_SIZE) {
+    fprintf(stderr, "Warning: (" __FILE__ "): exhausted command buffer\n");
+    return NULL;
+  }
+  command_buf_idx = n;
+  memset(cmd, 0, sizeof(Command));
+  cmd->type = type;
+  cmd->size = size;
+  return cmd;
+}
+
+
+static bool next_command(Command **prev) {
+  if (*prev == NULL) {
+    *prev = (Command*) command_buf;
+  } else {
+    *prev = (Command*) (((char*) *prev) + (*prev)->size);
+  }
+  return *prev != ((Command*) (command_buf + command_buf_idx));
+}
+
+
+void rencache_show_debug(bool enable) {
+  show_debug = enable;
+}
+
+
+void rencache_free_font(RenFont *font) {
+  Command *cmd = push_command(FREE_FONT, sizeof(Command));
+  if (cmd) { cmd->font = font; }
+}
+
+
+void rencache_set_clip_rect(RenRect rect) {
+  Command *cmd = push_command(SET_CLIP, sizeof(Command));
+  if (cmd) { cmd->rect = intersect_rects(rect, screen_rect); }
+}
+
+
+void rencache_draw_rect(RenRect rect, RenColor color) {
+  if (!rects_overlap(screen_rect, rect)) { return; }
+  Command *cmd = push_command(DRAW_RECT, sizeof(Command));
+  if (cmd) {
+    cmd->rect = rect;
+    cmd->color = color;
+  }
+}
+
+
+int rencache_draw_text(RenFont *font, const char *text, int x, int y, RenColor color) {
+  RenRect rect;
+  rect.x = x;
+  rect.y = y;
+  rect.width = ren_get_font_width(font, text);
+  rect.height = ren_get_font_height(font);
+
+  if (rects_overlap(screen_rect, rect)) {
+    int sz = strlen(text) + 1;
+    Command *cmd = push_command(DRAW_TEXT, sizeof(Command) + sz);
+    if (cmd) {
+      memcpy(cmd->text, text, sz);
+      cmd->color = color;
+      cmd->font = font;
+      cmd->rect = rect;
+      cmd->tab_width = ren_get_font_tab_width(font);
+    }
+  }
+
+  return x + rect.width;
+}
+
+
+/* the tokens of a line are stored one after another as their color followed by
+** their null terminated text */
+int rencache_draw_line(RenFont *font, const char **texts, const RenColor *colors, int count, int x, int y) {
+  RenRect rect;
+  rect.x = x;
+  rect.y = y;
+  rect.width = 0;
+  rect.height = ren_get_font_height(font);
+  int sz = 0;
+  for (int i = 0; i < count; i++) {
+    rect.width += ren_get_font_width(font, texts[i]);
+    sz += sizeof(RenColor) + strlen(texts[i]) + 1;
+  }
+
+  if (rects_overlap(screen_rect, rect)) {
+    Command *cmd = push_command(DRAW_LINE, sizeof(Command) + sz);
+    if (cmd) {
+      char *p = cmd->text;
+      for (int i = 0; i < count; i++) {
+        int n = strlen(texts[i]) + 1;
+        memcpy(p, &colors[i], sizeof(RenColor));
+        memcpy(p + sizeof(RenColor), texts[i], n);
+        p += sizeof(RenColor) + n;
+      }
+      cmd->font = font;
+      cmd->rect = rect;
+      cmd->tab_width = ren_get_font_tab_width(font);
+    }
+  }
+
+  return x + rect.width;
+}
+
+
+void rencache_begin_scroll_region(RenRect rect, int scroll) {
+  Command *cmd = push_command(BEGIN_SCROLL, sizeof(Command));
+  if (cmd) {
+    cmd->rect = intersect_rects(rect, screen_rect);
+    cmd->scroll = scroll;
+  }
+}
+
+
+void rencache_end_scroll_region(void) {
+  push_command(END_SCROLL, sizeof(Command));
+}
+
+
+void rencache_invalidate(void) {
+  memset(cells_prev, 0xff, sizeof(cells_buf1));
+  region_count_prev = 0;
+}
+
+
+void rencache_begin_frame(void) {
+  /* reset all cells if the screen width/height has changed */
+  int w, h;
+  ren_get_size(&w, &h);
+  if (screen_rect.width != w || h != screen_rect.height) {
+    screen_rect.width = w;
+    screen_rect.height = h;
+    rencache_invalidate();
+  }
+}
+
+
+static void update_overlapping_cells(RenRect r, unsigned h) {
+  int x1 = r.x / CELL_SIZE;
+  int y1 = r.y / CELL_SIZE;
+  int x2 = (r.x + r.width) / CELL_SIZE;
+  int y2 = (r.y + r.height) / CELL_SIZE;
+
+  for (int y = y1; y <= y2; y++) {
+    for (int x = x1; x <= x2; x++) {
+      int idx = cell_idx(x, y);
+      hash(&cells[idx], &h, sizeof(h));
+    }
+  }
+}
+
+
+static void init_scroll_region(ScrollRegion *region, RenRect rect, int scroll) {
+  region->rect = rect;
+  region->scroll = scroll;
+  region->first_row = floor_div(scroll, CELL_SIZE);
+  region->prev = NULL;
+  region->moved = false;
+  region->opaque = false;
+  region->overlay = (RenRect) { 0, 0, 0, 0 };
+  for (int i = 0; i < CELLS_X * REGION_ROWS; i++) {
+    region->cells[i] = HASH_INITIAL;
+  }
+  for (int i = 0; i < region_count_prev; i++) {
+    if (rects_equal(regions_prev[i].rect, rect)) {
+      region->prev = &regions_prev[i];
+      break;
+    }
+  }
+  if (!region->prev || rect.height == 0) { return; }
+
+  /* move what stays visible, anything scrolled further is drawn from scratch */
+  int dy = region->prev->scroll - scroll;
+  if (abs(dy) >= rect.height) {
+    region->prev = NULL;
+  } else if (dy != 0) {
+    ren_scroll_rect(rect, dy);
+    region->moved = true;
+  }
+}
+
+
+static void update_region_cells(ScrollRegion *region, Command *cmd, RenRect r) {
+  r = intersect_rects(r, region->rect);
+  if (cmd->type == SET_CLIP || r.width == 0 || r.height == 0) { return; }
+
+  /* commands are hashed at their position in the content along with the part
+  ** of them that is visible, so moving under a clip edge still redraws them.
+  ** Fills of the whole region look the same at any scroll position */
+  Command c;
+  memcpy(&c, cmd, offsetof(Command, text));
+  RenRect visible = r;
+  int dx = -region->rect.x;
+  int dy = -region->rect.y;
+  if (cmd->type == DRAW_RECT && rect_contains(cmd->rect, region->rect)) {
+    region->opaque |= cmd->color.a == 0xff && rect_contains(r, region->rect);
+  } else {
+    dy += region->scroll;
+  }
+  c.rect.x += dx;
+  c.rect.y += dy;
+  visible.x += dx;
+  visible.y += dy;
+  unsigned h = HASH_INITIAL;
+  hash(&h, &c, offsetof(Command, text));
+  hash(&h, cmd->text, cmd->size - offsetof(Command, text));
+  hash(&h, &visible, sizeof(visible));
+
+  int x1 = (r.x - region->rect.x) / CELL_SIZE;
+  int x2 = (r.x + r.width - region->rect.x) / CELL_SIZE;
+  int content_y = region->scroll - region->rect.y;
+  int y1 = floor_div(r.y + content_y, CELL_SIZE) - region->first_row;
+  int y2 = floor_div(r.y + r.height + content_y, CELL_SIZE) - region->first_row;
+  for (int y = y1; y <= y2; y++) {
+    for (int x = x1; x <= x2; x++) {
+      hash(&region->cells[x + y * CELLS_X], &h, sizeof(h));
+    }
+  }
+}
+
+
+static void push_rect(RenRect r, int *count) {
+  if (r.width <= 0 || r.height <= 0) { return; }
+  /* out of room: grow the last rectangle instead */
+  if (*count == RECT_BUF_SIZE) {
+    rect_buf[*count - 1] = merge_rects(rect_buf[*count - 1], r);
+    return;
+  }
+  rect_buf[(*count)++] = r;
+}
+
+
+/* push rects for all cells changed from last frame and reset the cells. Runs
+** of changed cells in a row become one rect, which grows downwards as long as
+** the row below has a run with the same span */
+static void push_cell_rects(int *count) {
+  int open[CELLS_X], next_open[CELLS_X];
+  int open_count = 0;
+  int first = *count;
+  int max_x = screen_rect.width / CELL_SIZE + 1;
+  int max_y = screen_rect.height / CELL_SIZE + 1;
+  for (int y = 0; y < max_y; y++) {
+    int next_count = 0;
+    int o = 0;
+    for (int x = 0; x < max_x; x++) {
+      int x1 = x;
+      while (x < max_x && cells[cell_idx(x, y)] != cells_prev[cell_idx(x, y)]) {
+        cells_prev[cell_idx(x, y)] = HASH_INITIAL;
+        x++;
+      }
+      if (x < max_x) { cells_prev[cell_idx(x, y)] = HASH_INITIAL; }
+      if (x == x1) { continue; }
+      /* the open rects are sorted by x and don't overlap */
+      while (o < open_count && rect_buf[open[o]].x < x1) { o++; }
+      if (o < open_count && rect_buf[open[o]].x == x1 && rect_buf[open[o]].width == x - x1) {
+        rect_buf[open[o]].height++;
+        next_open[next_count++] = open[o];
+      } else {
+        if (*count < RECT_BUF_SIZE) { next_open[next_count++] = *count; }
+        push_rect((RenRect) { x1, y, x - x1, 1 }, count);
+      }
+    }
+    memcpy(open, next_open, next_count * sizeof(int));
+    open_count = next_count;
+  }
+
+  /* expand rects from cells to pixels */
+  for (int i = first; i < *count; i++) {
+    RenRect *r = &rect_buf[i];
+    r->x *= CELL_SIZE;
+    r->y *= CELL_SIZE;
+    r->width *= CELL_SIZE;
+    r->height *= CELL_SIZE;
+    *r = intersect_rects(*r, screen_rect);
+  }
+}
+
+
+static int compare_rect_y(const void *a, const void *b) {
+  return ((const RenRect*) a)->y - ((const RenRect*) b)->y;
+}
+
+
+/* merge rects where redrawing the area between them costs less than another
+** pass over their commands. Rects are sorted by their top, so only those
+** starting at most a row of cells below the bottom of a rect are tried */
+static int merge_dirty_rects(int count) {
+  qsort(rect_buf, count, sizeof(RenRect), compare_rect_y);
+  for (int pass = 0; pass < MERGE_PASSES; pass++) {
+    bool merged = false;
+    for (int i = 0; i < count; i++) {
+      RenRect *a = &rect_buf[i];
+      if (a->width == 0) { continue; }
+      for (int j = i + 1; j < count && rect_buf[j].y <= a->y + a->height + CELL_SIZE; j++) {
+        RenRect *b = &rect_buf[j];
+        if (b->width == 0) { continue; }
+        RenRect m = merge_rects(*a, *b);
+        RenRect o = intersect_rects(*a, *b);
+        int covered = a->width * a->height + b->width * b->height - o.width * o.height;
+        if (m.width * m.height - covered > MERGE_WASTE) { continue; }
+        *a = m;
+        b->width = 0;
+        merged = true;
+      }
+    }
+    int n = 0;
+    for (int i = 0; i < count; i++) {
+      if (rect_buf[i].width > 0 && rect_buf[i].height > 0) { rect_buf[n++] = rect_buf[i]; }
+    }
+    count = n;
+    if (!merged) { break; }
+  }
+  return count;
+}
+
+
+/* push rects (in pixels) for all cells of the region changed from last frame */
+static void push_region_rects(ScrollRegion *region, int *count) {
+  ScrollRegion *prev = region->prev;
+  if (!prev) {
+    push_rect(region->rect, count);
+    return;
+  }
+  int cols = region->rect.width / CELL_SIZE + 1;
+  int rows = region->rect.height / CELL_SIZE + 2;
+  for (int y = 0; y < rows; y++) {
+    int py = y + region->first_row - prev->first_row;
+    bool prev_row = py >= 0 && py < rows;
+    int sy = (region->first_row + y) * CELL_SIZE - region->scroll + region->rect.y;
+    for (int x = 0; x < cols; x++) {
+      int x1 = x;
+      while (x < cols && (!prev_row
+      || region->cells[x + y * CELLS_X] != prev->cells[x + py * CELLS_X])) {
+        x++;
+      }
+      if (x == x1) { continue; }
+      RenRect r = { region->rect.x + x1 * CELL_SIZE, sy, (x - x1) * CELL_SIZE, CELL_SIZE };
+      r = intersect_rects(r, region->rect);
+      if (r.width > 0 && r.height > 0) { push_rect(r, count); }
+    }
+  }
+
+  /* the strip scrolled into view was never drawn, and what was drawn over the
+  ** region last frame was moved along with it */
+  if (region->moved) {
+    RenRect o = prev->overlay;
+    if (o.width > 0) {
+      o.y += prev->scroll - region->scroll;
+      o = intersect_rects(o, region->rect);
+      if (o.width > 0 && o.height > 0) { push_rect(o, count); }
+    }
+    RenRect r = region->rect;
+    int dy = prev->scroll - region->scroll;
+    if (dy > 0) {
+      r.height = dy;
+    } else {
+      r.y += r.height + dy;
+      r.height = -dy;
+    }
+    push_rect(r, count);
+  }
+}
+
+
+static void draw_line(Command *cmd) {
+  const char *texts[REN_MAX_LINE_TOKENS];
+  RenColor colors[REN_MAX_LINE_TOKENS];
+  int count = 0;
+  const char *p = cmd->text;
+  const char *end = (const char*) cmd + cmd->size;
+  while (p < end) {
+    memcpy(&colors[count], p, sizeof(RenColor));
+    texts[count++] = p + sizeof(RenColor);
+    p += sizeof(RenColor) + strlen(p + sizeof(RenColor)) + 1;
+  }
+  ren_draw_line(cmd->font, texts, colors, count, cmd->rect.x, cmd->rect.y);
+}
+
+
+static void* grow(void *p, int *capacity, int count, size_t size) {
+  if (count < *capacity) { return p; }
+  while (*capacity <= count) { *capacity = *capacity ? *capacity * 2 : 16; }
+  p = realloc(p, *capacity * size);
+  if (!p) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return p;
+}
+
+
+/* keep draw commands with the clip rect they are drawn with; glyphs may reach a
+** bit beyond the measured text */
+static void push_draw(Command *cmd, RenRect clip) {
+  if (cmd->type != DRAW_RECT && cmd->type != DRAW_TEXT && cmd->type != DRAW_LINE) { return; }
+  RenRect b = cmd->rect;
+  if (cmd->type != DRAW_RECT) {
+    b.x -= b.height;
+    b.y -= b.height;
+    b.width += b.height * 2;
+    b.height *= 3;
+  }
+  b = intersect_rects(b, clip);
+  if (b.width == 0 || b.height == 0) { return; }
+  draws = grow(draws, &draw_capacity, draw_count, sizeof(Draw));
+  draws[draw_count++] = (Draw) { cmd, clip, b };
+}
+
+
+/* bucket the draws by the cells they overlap, each bucket lists its draws in
+** the order they were issued */
+static void bucket_draws(void) {
+  memset(bucket_start, 0, sizeof(bucket_start));
+  int total = 0;
+  for (int i = 0; i < draw_count; i++) {
+    RenRect b = draws[i].bounds;
+    int x2 = min((b.x + b.width - 1) / CELL_SIZE, CELLS_X - 1);
+    int y2 = min((b.y + b.height - 1) / CELL_SIZE, CELLS_Y - 1);
+    for (int y = b.y / CELL_SIZE; y <= y2; y++) {
+      for (int x = b.x / CELL_SIZE; x <= x2; x++) {
+        bucket_start[cell_idx(x, y) + 1]++;
+        total++;
+      }
+    }
+  }
+  for (int i = 0; i < CELLS_X * CELLS_Y; i++) {
+    bucket_start[i + 1] += bucket_start[i];
+  }
+  bucket_items = grow(bucket_items, &bucket_capacity, total, sizeof(int));
+  for (int i = 0; i < draw_count; i++) {
+    RenRect b = draws[i].bounds;
+    int x2 = min((b.x + b.width - 1) / CELL_SIZE, CELLS_X - 1);
+    int y2 = min((b.y + b.height - 1) / CELL_SIZE, CELLS_Y - 1);
+    for (int y = b.y / CELL_SIZE; y <= y2; y++) {
+      for (int x = b.x / CELL_SIZE; x <= x2; x++) {
+        bucket_items[bucket_start[cell_idx(x, y)]++] = i;
+      }
+    }
+  }
+  /* filling moved every start to the start of the next bucket */
+  for (int i = CELLS_X * CELLS_Y; i > 0; i--) {
+    bucket_start[i] = bucket_start[i - 1];
+  }
+  bucket_start[0] = 0;
+}
+
+
+static int compare_int(const void *a, const void *b) {
+  return *(const int*) a - *(const int*) b;
+}
+
+
+/* collects the draws overlapping `r` in the order they were issued; a draw is
+** only taken from the first of its cells inside `r` */
+static int gather_draws(RenRect r, int **buf, int *capacity) {
+  int n = 0;
+  int x2 = min((r.x + r.width - 1) / CELL_SIZE, CELLS_X - 1);
+  int y2 = min((r.y + r.height - 1) / CELL_SIZE, CELLS_Y - 1);
+  for (int y = r.y / CELL_SIZE; y <= y2; y++) {
+    for (int x = r.x / CELL_SIZE; x <= x2; x++) {
+      int idx = cell_idx(x, y);
+      for (int k = bucket_start[idx]; k < bucket_start[idx + 1]; k++) {
+        RenRect b = intersect_rects(draws[bucket_items[k]].bounds, r);
+        if (b.width == 0 || b.height == 0) { continue; }
+        if (b.x / CELL_SIZE != x || b.y / CELL_SIZE != y) { continue; }
+        *buf = grow(*buf, capacity, n, sizeof(int));
+        (*buf)[n++] = bucket_items[k];
+      }
+    }
+  }
+  qsort(*buf, n, sizeof(int), compare_int);
+  return n;
+}
+
+
+static void draw_command(Command *cmd) {
+  switch (cmd->type) {
+    case DRAW_RECT:
+      ren_draw_rect(cmd->rect, cmd->color);
+      break;
+    case DRAW_TEXT:
+      ren_draw_text(cmd->font, cmd->text, cmd->rect.x, cmd->rect.y, cmd->color);
+      break;
+    case DRAW_LINE:
+      draw_line(cmd);
+      break;
+  }
+}
+
+
+static void draw_rects(int rect_count) {
+  for (int i = 0; i < rect_count; i++) {
+    RenRect r = rect_buf[i];
+    int n = gather_draws(r, &gather_buf, &gather_capacity);
+    for (int j = 0; j < n; j++) {
+      Draw *d = &draws[gather_buf[j]];
+      ren_set_clip_rect(intersect_rects(d->clip, r));
+      if (d->cmd->type != DRAW_RECT) { ren_set_font_tab_width(d->cmd->font, d->cmd->tab_width); }
+      draw_command(d->cmd);
+    }
+  }
+}
+
+
+#ifdef REN_THREADED
+/* fonts hold a single tab width, so commands can only be replayed out of
+** order if no font is drawn with two different ones during the frame */
+static bool set_tab_widths(void) {
+  RenFont *fonts[MAX_TILE_FONTS];
+  int widths[MAX_TILE_FONTS];
+  int count = 0;
+  for (int d = 0; d < draw_count; d++) {
+    Command *cmd = draws[d].cmd;
+    if (cmd->type == DRAW_RECT) { continue; }
+    int i = 0;
+    while (i < count && fonts[i] != cmd->font) { i++; }
+    if (i < count) {
+      if (widths[i] != cmd->tab_width) { return false; }
+      continue;
+    }
+    if (count == MAX_TILE_FONTS) { return false; }
+    fonts[count] = cmd->font;
+    widths[count++] = cmd->tab_width;
+  }
+  for (int i = 0; i < count; i++) {
+    ren_set_font_tab_width(fonts[i], widths[i]);
+  }
+  return true;
+}
+
+
+static void draw_tile(int idx, void *udata) {
+  Tile *t = &tiles[tile_list[idx]];
+  for (int i = 0; i < t->rect_count; i++) {
+    RenRect r = t->rects[i];
+    for (int j = 0; j < t->draw_count; j++) {
+      Draw *d = &draws[t->draws[j]];
+      RenRect b = intersect_rects(d->bounds, r);
+      if (b.width == 0 || b.height == 0) { continue; }
+      ren_set_clip_rect(intersect_rects(d->clip, r));
+      draw_command(d->cmd);
+    }
+  }
+}
+
+
+static bool draw_tiles(int rect_count) {
+  if (rect_count == 0 || !set_tab_widths()) { return false; }
+
+  /* cut the dirty rects into the tiles they touch */
+  int tile_count = 0;
+  for (int i = 0; i < rect_count; i++) {
+    RenRect r = rect_buf[i];
+    if (r.width <= 0 || r.height <= 0) { continue; }
+    int x2 = min((r.x + r.width - 1) / TILE_SIZE, TILES_X - 1);
+    int y2 = min((r.y + r.height - 1) / TILE_SIZE, TILES_Y - 1);
+    for (int y = r.y / TILE_SIZE; y <= y2; y++) {
+      for (int x = r.x / TILE_SIZE; x <= x2; x++) {
+        RenRect tr = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+        RenRect piece = intersect_rects(r, tr);
+        if (piece.width == 0 || piece.height == 0) { continue; }
+        Tile *t = &tiles[x + y * TILES_X];
+        if (t->rect_count == 0) { tile_list[tile_count++] = x + y * TILES_X; }
+        t->rects = grow(t->rects, &t->rect_capacity, t->rect_count, sizeof(RenRect));
+        t->rects[t->rect_count++] = piece;
+      }
+    }
+  }
+
+  /* every tile replays the draws overlapping it */
+  for (int i = 0; i < tile_count; i++) {
+    Tile *t = &tiles[tile_list[i]];
+    int x = tile_list[i] % TILES_X;
+    int y = tile_list[i] / TILES_X;
+    RenRect tr = { x * TILE_SIZE, y * TILE_SIZE, TILE_SIZE, TILE_SIZE };
+    t->draw_count = gather_draws(intersect_rects(tr, screen_rect), &t->draws, &t->draw_capacity);
+  }
+
+  ren_parallel(tile_count, draw_tile, NULL);
+
+  for (int i = 0; i < tile_count; i++) {
+    tiles[tile_list[i]].rect_count = 0;
+  }
+  return true;
+}
+#endif
+
+
+void rencache_end_frame(void) {
+  /* set up scroll regions, moving their contents if they were scrolled */
+  Command *cmd = NULL;
+  region_count = 0;
+  while (next_command(&cmd)) {
+    if (cmd->type == BEGIN_SCROLL && region_count < MAX_SCROLL_REGIONS) {
+      init_scroll_region(&regions[region_count++], cmd->rect, cmd->scroll);
+    }
+  }
+
+  /* update cells from commands, keep the draws for replay */
+  cmd = NULL;
+  RenRect cr = screen_rect;
+  ScrollRegion *region = NULL;
+  int region_idx = 0;
+  draw_count = 0;
+  while (next_command(&cmd)) {
+    if (cmd->type == BEGIN_SCROLL) {
+      region = region_idx < region_count ? &regions[region_idx++] : NULL;
+      continue;
+    }
+    if (cmd->type == END_SCROLL) { region = NULL; continue; }
+    if (cmd->type == SET_CLIP) { cr = cmd->rect; }
+    push_draw(cmd, cr);
+    RenRect r = intersect_rects(cmd->rect, cr);
+    if (r.width == 0 || r.height == 0) { continue; }
+    if (region) {
+      update_region_cells(region, cmd, r);
+      continue;
+    }
+    unsigned h = HASH_INITIAL;
+    hash(&h, cmd, cmd->size);
+    update_overlapping_cells(r, h);
+  }
+  bucket_draws();
+
+  /* push rects for all cells changed from last frame, reset cells */
+  int rect_count = 0;
+  push_cell_rects(&rect_count);
+
+  /* push rects for scroll regions, redraw the ones which are gone */
+  for (int i = 0; i < region_count; i++) {
+    push_region_rects(&regions[i], &rect_count);
+  }
+  for (int i = 0; i < region_count_prev; i++) {
+    bool found = false;
+    for (int j = 0; j < region_count; j++) {
+      found |= regions[j].prev == &regions_prev[i];
+    }
+    if (!found) { push_rect(intersect_rects(regions_prev[i].rect, screen_rect), &rect_count); }
+  }
+
+  /* anything drawn over a scrolled region outside of it was moved along,
+  ** unless the region painted over it */
+  if (region_count > 0) {
+    cmd = NULL;
+    cr = screen_rect;
+    bool in_region = false;
+    region_idx = 0;
+    while (next_command(&cmd)) {
+      if (cmd->type == BEGIN_SCROLL) { in_region = true; region_idx++; continue; }
+      if (cmd->type == END_SCROLL) { in_region = false; continue; }
+      if (cmd->type == SET_CLIP) { cr = cmd->rect; continue; }
+      if (in_region || (cmd->type != DRAW_RECT && cmd->type != DRAW_TEXT
+      && cmd->type != DRAW_LINE)) { continue; }
+      RenRect r = intersect_rects(cmd->rect, cr);
+      for (int i = 0; i < region_count; i++) {
+        if (i >= region_idx && regions[i].opaque) { continue; }
+        RenRect ri = intersect_rects(r, regions[i].rect);
+        if (ri.width == 0 || ri.height == 0) { continue; }
+        RenRect *o = &regions[i].overlay;
+        *o = o->width > 0 ? merge_rects(*o, ri) : ri;
+        if (regions[i].moved) { push_rect(ri, &rect_count); }
+      }
+    }
+  }
+
+  rect_count = merge_dirty_rects(rect_count);
+
+  /* redraw updated regions */
+  bool has_free_commands = false;
+  cmd = NULL;
+  while (next_command(&cmd)) {
+    has_free_commands |= cmd->type == FREE_FONT;
+  }
+#ifdef REN_THREADED
+  if (!draw_tiles(rect_count)) { draw_rects(rect_count); }
+#else
+  draw_rects(rect_count);
+#endif
+
+  if (show_debug) {
+    for (int i = 0; i < rect_count; i++) {
+      RenColor color = { rand(), rand(), rand(), 50 };
+      ren_set_clip_rect(rect_buf[i]);
+      ren_draw_rect(rect_buf[i], color);
+    }
+  }
+
+  /* update dirty rects */
+  if (rect_count > 0) {
+    ren_update_rects(rect_buf, rect_count);
+  }
+
+  /* free fonts */
+  if (has_free_commands) {
+    cmd = NULL;
+    while (next_command(&cmd)) {
+      if (cmd->type == FREE_FONT) {
+        ren_free_font(cmd->font);
+      }
+    }
+  }
+
+  /* swap cell buffer and reset */
+  unsigned *tmp = cells;
+  cells = cells_prev;
+  cells_prev = tmp;
+  ScrollRegion *tmp_regions = regions;
+  regions = regions_prev;
+  regions_prev = tmp_regions;
+  region_count_prev = region_count;
+  command_buf_idx = 0;
+}
@@ -9,6 +9,9 @@ void rencache_free_font(RenFont *font);
 void rencache_set_clip_rect(RenRect rect);
 void rencache_draw_rect(RenRect rect, RenColor color);
 int  rencache_draw_text(RenFont *font, const char *text, int x, int y, RenColor color);
+int  rencache_draw_line(RenFont *font, const char **texts, const RenColor *colors, int count, int x, int y);
+void rencache_begin_scroll_region(RenRect rect, int scroll);
+void rencache_end_scroll_region(void);
 void rencache_invalidate(void);
 void rencache_begin_frame(void);
 void rencache_end_frame(void);
@@ -0,0 +1,717 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <ctype.h>
+#include "tokenizer.h"
+
+/* Native counterpart of `tokenizer.tokenize` in data/core/tokenizer.lua.
+** Every Lua pattern of a syntax is compiled once into a list of items, each
+** single-character class expanded into a 256 bit set, and matched with the
+** same backtracking rules as lstrlib.c. From the items we also know which
+** bytes a match can start with, so for every byte the tokenizer keeps the
+** (ordered) list of patterns worth trying there; most positions only try one
+** or two patterns instead of all of them.
+**
+** Tokens are runs of the line text and are merged exactly like `push_token`
+** does, so the output is the same as the one of the Lua tokenizer. A compiled
+** tokenizer is never modified after `tk_finish` and can be used from several
+** threads at once. */
+
+#define MAX_CAPTURES 32
+#define CAP_UNFINISHED (-1)
+#define CAP_POSITION   (-2)
+#define END_OF_TEXT    256
+
+#define SET_HAS(set, c) ((set)[(unsigned char) (c) >> 3] & (1 << ((unsigned char) (c) & 7)))
+#define SET_ADD(set, c) ((set)[(unsigned char) (c) >> 3] |= (1 << ((unsigned char) (c) & 7)))
+
+enum { OP_CLASS, OP_BALANCE, OP_FRONTIER, OP_OPEN, OP_POSITION, OP_CLOSE, OP_BACKREF, OP_END };
+
+typedef struct {
+  unsigned char op, quant, a, b;
+  unsigned char set[32];
+} Item;
+
+typedef struct {
+  Item *items;
+  int count;
+  bool anchored;
+  /* bytes a match can start with; `nullable` if it may match nothing */
+  unsigned char first[32];
+  bool nullable;
+} Program;
+
+typedef struct {
+  Program start, end;
+  bool pair;
+  int escape;
+  int type;
+} Pattern;
+
+typedef struct {
+  char *text;
+  size_t len;
+  int type;
+} Symbol;
+
+struct Tokenizer {
+  char **types;
+  int type_count, type_capacity;
+  Pattern *patterns;
+  int pattern_count, pattern_capacity;
+  /* open addressing hash table, capacity is a power of two */
+  Symbol *symbols;
+  int symbol_count, symbol_capacity;
+  size_t symbol_max_len;
+  /* patterns to try for a byte (or END_OF_TEXT) c are
+  ** dispatch[dispatch_start[c] .. dispatch_start[c + 1]) */
+  int dispatch_start[END_OF_TEXT + 2];
+  int *dispatch;
+};
+
+typedef struct {
+  const char *src_init, *src_end;
+  int level;
+  struct { const char *init; ptrdiff_t len; } capture[MAX_CAPTURES];
+} MatchState;
+
+
+static void* check_alloc(void *ptr) {
+  if (!ptr) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+/* %s of Lua patterns in the C locale */
+static inline bool is_space(unsigned char c) {
+  return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+
+/*
+** Pattern compilation
+*/
+
+static bool match_class(int c, int cl) {
+  bool res;
+  switch (tolower(cl)) {
+    case 'a': res = isalpha(c);  break;
+    case 'c': res = iscntrl(c);  break;
+    case 'd': res = isdigit(c);  break;
+    case 'g': res = isgraph(c);  break;
+    case 'l': res = islower(c);  break;
+    case 'p': res = ispunct(c);  break;
+    case 's': res = isspace(c);  break;
+    case 'u': res = isupper(c);  break;
+    case 'w': res = isalnum(c);  break;
+    case 'x': res = isxdigit(c); break;
+    default: return cl == c;
+  }
+  return isupper(cl) ? !res : res;
+}
+
+
+/* `p` is at the '[' of the set, `ec` at its closing ']' */
+static bool match_bracket(int c, const unsigned char *p, const unsigned char *ec) {
+  bool sig = true;
+  if (p[1] == '^') { sig = false; p++; }
+  while (++p < ec) {
+    if (*p == '%') {
+      p++;
+      if (match_class(c, *p)) { return sig; }
+    } else if (p[1] == '-' && p + 2 < ec) {
+      p += 2;
+      if (p[-2] <= c && c <= *p) { return sig; }
+    } else if (*p == c) {
+      return sig;
+    }
+  }
+  return !sig;
+}
+
+
+static bool single_match(int c, const unsigned char *p, const unsigned char *ep) {
+  switch (*p) {
+    case '.': return true;
+    case '%': return match_class(c, p[1]);
+    case '[': return match_bracket(c, p, ep - 1);
+    default:  return *p == c;
+  }
+}
+
+
+static const char* class_end(const unsigned char *p, const unsigned char *end,
+                             const unsigned char **out) {
+  unsigned char c = *p++;
+  if (c == '%') {
+    if (p >= end) { return "malformed pattern (ends with '%')"; }
+    p++;
+  } else if (c == '[') {
+    if (p < end && *p == '^') { p++; }
+    for (;;) {
+      if (p >= end) { return "malformed pattern (missing ']')"; }
+      c = *p++;
+      if (c == '%' && p < end) { p++; }
+      if (p < end && *p == ']') { break; }
+    }
+    p++;
+  }
+  *out = p;
+  return NULL;
+}
+
+
+static void build_set(unsigned char *set, const unsigned char *p, const unsigned char *ep) {
+  memset(set, 0, 32);
+  for (int c = 0; c < 256; c++) {
+    if (single_match(c, p, ep)) { SET_ADD(set, c); }
+  }
+}
+
+
+static void compute_first(Program *prog) {
+  memset(prog->first, 0, sizeof(prog->first));
+  prog->nullable = false;
+  for (int i = 0; i < prog->count; i++) {
+    const Item *it = &prog->items[i];
+    switch (it->op) {
+      case OP_CLASS:
+        for (int j = 0; j < 32; j++) { prog->first[j] |= it->set[j]; }
+        if (it->quant == 0 || it->quant == '+') { return; }
+        break;
+      case OP_BALANCE:
+        SET_ADD(prog->first, it->a);
+        return;
+      case OP_BACKREF:
+        /* the capture may be empty as well, try it everywhere */
+        memset(prog->first, 0xff, sizeof(prog->first));
+        prog->nullable = true;
+        return;
+      case OP_END:
+        prog->nullable = true;
+        return;
+      default:
+        /* captures and frontiers do not consume anything */
+        break;
+    }
+  }
+  /* may match nothing at all, so anywhere */
+  memset(prog->first, 0xff, sizeof(prog->first));
+  prog->nullable = true;
+}
+
+
+static const char* compile(Program *prog, const char *pattern, size_t len, bool allow_anchor) {
+  const unsigned char *p = (const unsigned char*) pattern;
+  const unsigned char *end = p + len;
+  int open[MAX_CAPTURES], open_count = 0, total = 0;
+  bool closed[MAX_CAPTURES] = { false };
+  int capacity = 0;
+
+  memset(prog, 0, sizeof(*prog));
+  if (allow_anchor && p < end && *p == '^') {
+    prog->anchored = true;
+    p++;
+  }
+
+  while (p < end) {
+    Item it;
+    memset(&it, 0, sizeof(it));
+    const char *err = NULL;
+    switch (*p) {
+      case '(':
+        if (total == MAX_CAPTURES) { return "too many captures"; }
+        if (p + 1 < end && p[1] == ')') {
+          it.op = OP_POSITION;
+          p += 2;
+        } else {
+          it.op = OP_OPEN;
+          open[open_count++] = total;
+          p++;
+        }
+        it.a = total++;
+        break;
+
+      case ')':
+        if (open_count == 0) { return "invalid pattern capture"; }
+        it.op = OP_CLOSE;
+        closed[open[--open_count]] = true;
+        p++;
+        break;
+
+      case '$':
+        if (p + 1 == end) {
+          it.op = OP_END;
+          p++;
+          break;
+        }
+        goto dflt;
+
+      case '%':
+        if (p + 1 < end && p[1] == 'b') {
+          if (p + 3 >= end) { return "missing arguments to '%b'"; }
+          it.op = OP_BALANCE;
+          it.a = p[2];
+          it.b = p[3];
+          p += 4;
+          break;
+        }
+        if (p + 1 < end && p[1] == 'f') {
+          const unsigned char *ep;
+          p += 2;
+          if (p >= end || *p != '[') { return "missing '[' after '%f' in pattern"; }
+          if ((err = class_end(p, end, &ep))) { return err; }
+          it.op = OP_FRONTIER;
+          build_set(it.set, p, ep);
+          p = ep;
+          break;
+        }
+        if (p + 1 < end && isdigit(p[1])) {
+          int l = p[1] - '1';
+          if (l < 0 || l >= total || !closed[l]) { return "invalid capture index"; }
+          it.op = OP_BACKREF;
+          it.a = l;
+          p += 2;
+          break;
+        }
+        goto dflt;
+
+      default: dflt: {
+        const unsigned char *ep;
+        if ((err = class_end(p, end, &ep))) { return err; }
+        it.op = OP_CLASS;
+        build_set(it.set, p, ep);
+        if (ep < end && (*ep == '?' || *ep == '+' || *ep == '*' || *ep == '-')) {
+          it.quant = *ep++;
+        }
+        p = ep;
+        break;
+      }
+    }
+
+    if (prog->count == capacity) {
+      capacity = capacity ? capacity * 2 : 8;
+      prog->items = check_alloc(realloc(prog->items, capacity * sizeof(Item)));
+    }
+    prog->items[prog->count++] = it;
+  }
+
+  if (open_count > 0) { return "unfinished capture"; }
+  compute_first(prog);
+  return NULL;
+}
+
+
+/*
+** Matching, the same rules as `match` in lstrlib.c
+*/
+
+static const char* match(MatchState *ms, const char *s, const Item *p, const Item *ep);
+
+
+static const char* max_expand(MatchState *ms, const char *s, const Item *p, const Item *ep) {
+  ptrdiff_t i = 0;
+  while (s + i < ms->src_end && SET_HAS(p->set, s[i])) { i++; }
+  while (i >= 0) {
+    const char *res = match(ms, s + i, p + 1, ep);
+    if (res) { return res; }
+    i--;
+  }
+  return NULL;
+}
+
+
+static const char* min_expand(MatchState *ms, const char *s, const Item *p, const Item *ep) {
+  for (;;) {
+    const char *res = match(ms, s, p + 1, ep);
+    if (res) { return res; }
+    if (s < ms->src_end && SET_HAS(p->set, *s)) {
+      s++;
+    } else {
+      return NULL;
+    }
+  }
+}
+
+
+static const char* match_balance(MatchState *ms, const char *s, int a, int b) {
+  if (s >= ms->src_end || (unsigned char) *s != a) { return NULL; }
+  int cont = 1;
+  while (++s < ms->src_end) {
+    if ((unsigned char) *s == b) {
+      if (--cont == 0) { return s + 1; }
+    } else if ((unsigned char) *s == a) {
+      cont++;
+    }
+  }
+  return NULL;
+}
+
+
+static const char* match(MatchState *ms, const char *s, const Item *p, const Item *ep) {
+  while (p < ep) {
+    switch (p->op) {
+      case OP_OPEN:
+      case OP_POSITION: {
+        ms->capture[ms->level].init = s;
+        ms->capture[ms->level].len = p->op == OP_OPEN ? CAP_UNFINISHED : CAP_POSITION;
+        ms->level++;
+        const char *res = match(ms, s, p + 1, ep);
+        if (!res) { ms->level--; }
+        return res;
+      }
+
+      case OP_CLOSE: {
+        int l = ms->level - 1;
+        while (ms->capture[l].len != CAP_UNFINISHED) { l--; }
+        ms->capture[l].len = s - ms->capture[l].init;
+        const char *res = match(ms, s, p + 1, ep);
+        if (!res) { ms->capture[l].len = CAP_UNFINISHED; }
+        return res;
+      }
+
+      case OP_END:
+        return s == ms->src_end ? s : NULL;
+
+      case OP_BALANCE:
+        if (!(s = match_balance(ms, s, p->a, p->b))) { return NULL; }
+        p++;
+        break;
+
+      case OP_FRONTIER: {
+        unsigned char prev = s == ms->src_init ? 0 : s[-1];
+        unsigned char cur = s < ms->src_end ? *s : 0;
+        if (SET_HAS(p->set, prev) || !SET_HAS(p->set, cur)) { return NULL; }
+        p++;
+        break;
+      }
+
+      case OP_BACKREF: {
+        size_t len = ms->capture[p->a].len;
+        if ((size_t) (ms->src_end - s) < len || memcmp(ms->capture[p->a].init, s, len) != 0) {
+          return NULL;
+        }
+        s += len;
+        p++;
+        break;
+      }
+
+      default: {
+        bool m = s < ms->src_end && SET_HAS(p->set, *s);
+        if (p->quant == '+') { return m ? max_expand(ms, s + 1, p, ep) : NULL; }
+        if (p->quant == '*') { return max_expand(ms, s, p, ep); }
+        if (p->quant == '-') { return min_expand(ms, s, p, ep); }
+        if (p->quant == '?') {
+          if (m) {
+            const char *res = match(ms, s + 1, p + 1, ep);
+            if (res) { return res; }
+          }
+          p++;
+          break;
+        }
+        if (!m) { return NULL; }
+        s++;
+        p++;
+        break;
+      }
+    }
+  }
+  return s;
+}
+
+
+static const char* match_at(const Program *prog, const char *text, size_t len, size_t at) {
+  MatchState ms;
+  ms.src_init = text;
+  ms.src_end = text + len;
+  ms.level = 0;
+  return match(&ms, text + at, prog->items, prog->items + prog->count);
+}
+
+
+/* like `text:find(pattern, offset)`; offsets are 0-based, the match is
+** [*s, *e) */
+static bool find(const Program *prog, const char *text, size_t len, size_t offset,
+                 size_t *s, size_t *e) {
+  for (size_t i = offset; i <= len; i++) {
+    bool candidate = i < len ? SET_HAS(prog->first, text[i]) : prog->nullable;
+    if (candidate) {
+      const char *res = match_at(prog, text, len, i);
+      if (res) {
+        *s = i;
+        *e = res - text;
+        return true;
+      }
+    }
+    if (prog->anchored) { break; }
+  }
+  return false;
+}
+
+
+static bool is_escaped(const char *text, size_t idx, int esc) {
+  size_t count = 0;
+  while (idx > 0 && (unsigned char) text[idx - 1] == esc) {
+    idx--;
+    count++;
+  }
+  return count % 2 == 1;
+}
+
+
+static bool find_non_escaped(const Pattern *p, const char *text, size_t len, size_t offset,
+                             size_t *s, size_t *e) {
+  while (offset <= len && find(&p->end, text, len, offset, s, e)) {
+    if (p->escape < 0 || !is_escaped(text, *s, p->escape)) { return true; }
+    /* the Lua version would loop forever on an escaped empty match */
+    offset = *e > *s ? *e : *s + 1;
+  }
+  return false;
+}
+
+
+/*
+** Tokenizer
+*/
+
+Tokenizer* tk_new(void) {
+  Tokenizer *tk = check_alloc(calloc(1, sizeof(Tokenizer)));
+  tk_add_type(tk, "normal");
+  return tk;
+}
+
+
+void tk_free(Tokenizer *tk) {
+  for (int i = 0; i < tk->type_count; i++) { free(tk->types[i]); }
+  for (int i = 0; i < tk->pattern_count; i++) {
+    free(tk->patterns[i].start.items);
+    free(tk->patterns[i].end.items);
+  }
+  for (int i = 0; i < tk->symbol_capacity; i++) { free(tk->symbols[i].text); }
+  free(tk->types);
+  free(tk->patterns);
+  free(tk->symbols);
+  free(tk->dispatch);
+  free(tk);
+}
+
+
+int tk_add_type(Tokenizer *tk, const char *name) {
+  for (int i = 0; i < tk->type_count; i++) {
+    if (strcmp(tk->types[i], name) == 0) { return i; }
+  }
+  if (tk->type_count == tk->type_capacity) {
+    tk->type_capacity = tk->type_capacity ? tk->type_capacity * 2 : 16;
+    tk->types = check_alloc(realloc(tk->types, tk->type_capacity * sizeof(char*)));
+  }
+  tk->types[tk->type_count] = check_alloc(malloc(strlen(name) + 1));
+  strcpy(tk->types[tk->type_count], name);
+  return tk->type_count++;
+}
+
+
+/* `end` is NULL for single patterns; `escape` is the escape byte of a pair or
+** -1. Returns an error message for malformed patterns */
+const char* tk_add_pattern(Tokenizer *tk, const char *start, size_t start_len,
+                           const char *end, size_t end_len, int escape, int type) {
+  Pattern p;
+  memset(&p, 0, sizeof(p));
+  p.pair = end != NULL;
+  p.escape = escape;
+  p.type = type;
+  /* the start is matched as "^" .. pattern, so a '^' of its own is a literal */
+  const char *err = compile(&p.start, start, start_len, false);
+  if (!err && p.pair) { err = compile(&p.end, end, end_len, true); }
+  if (err) {
+    free(p.start.items);
+    free(p.end.items);
+    return err;
+  }
+  if (tk->pattern_count == tk->pattern_capacity) {
+    tk->pattern_capacity = tk->pattern_capacity ? tk->pattern_capacity * 2 : 16;
+    tk->patterns = check_alloc(realloc(tk->patterns, tk->pattern_capacity * sizeof(Pattern)));
+  }
+  tk->patterns[tk->pattern_count++] = p;
+  return NULL;
+}
+
+
+static unsigned hash_text(const char *text, size_t len) {
+  /* FNV-1a */
+  unsigned h = 2166136261u;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (unsigned char) text[i]) * 16777619u;
+  }
+  return h;
+}
+
+
+static Symbol* find_symbol(const Tokenizer *tk, const char *text, size_t len) {
+  unsigned mask = tk->symbol_capacity - 1;
+  unsigned i = hash_text(text, len) & mask;
+  while (tk->symbols[i].text) {
+    Symbol *sym = &tk->symbols[i];
+    if (sym->len == len && memcmp(sym->text, text, len) == 0) { return sym; }
+    i = (i + 1) & mask;
+  }
+  return &tk->symbols[i];
+}
+
+
+void tk_add_symbol(Tokenizer *tk, const char *text, size_t len, int type) {
+  if ((tk->symbol_count + 1) * 2 > tk->symbol_capacity) {
+    Symbol *old = tk->symbols;
+    int old_capacity = tk->symbol_capacity;
+    tk->symbol_capacity = old_capacity ? old_capacity * 2 : 64;
+    tk->symbols = check_alloc(calloc(tk->symbol_capacity, sizeof(Symbol)));
+    for (int i = 0; i < old_capacity; i++) {
+      if (old[i].text) { *find_symbol(tk, old[i].text, old[i].len) = old[i]; }
+    }
+    free(old);
+  }
+  Symbol *sym = find_symbol(tk, text, len);
+  if (!sym->text) {
+    sym->text = check_alloc(malloc(len + 1));
+    memcpy(sym->text, text, len);
+    sym->text[len] = '\0';
+    sym->len = len;
+    tk->symbol_count++;
+  }
+  sym->type = type;
+  if (len > tk->symbol_max_len) { tk->symbol_max_len = len; }
+}
+
+
+/* builds the per byte lists of patterns to try, in the order of the syntax */
+void tk_finish(Tokenizer *tk) {
+  int total = 0;
+  for (int c = 0; c <= END_OF_TEXT; c++) {
+    tk->dispatch_start[c] = total;
+    for (int i = 0; i < tk->pattern_count; i++) {
+      const Program *prog = &tk->patterns[i].start;
+      if (c == END_OF_TEXT ? prog->nullable : SET_HAS(prog->first, c)) { total++; }
+    }
+  }
+  tk->dispatch_start[END_OF_TEXT + 1] = total;
+  free(tk->dispatch);
+  tk->dispatch = check_alloc(malloc((total + 1) * sizeof(int)));
+  int n = 0;
+  for (int c = 0; c <= END_OF_TEXT; c++) {
+    for (int i = 0; i < tk->pattern_count; i++) {
+      const Program *prog = &tk->patterns[i].start;
+      if (c == END_OF_TEXT ? prog->nullable : SET_HAS(prog->first, c)) { tk->dispatch[n++] = i; }
+    }
+  }
+}
+
+
+int tk_type_count(const Tokenizer *tk) {
+  return tk->type_count;
+}
+
+
+const char* tk_type_name(const Tokenizer *tk, int type) {
+  return type >= 0 && type < tk->type_count ? tk->types[type] : NULL;
+}
+
+
+static void push_token(TokenList *out, const char *text, int type, size_t start, size_t end) {
+  if (out->count > 0) {
+    /* tokens are contiguous, so merging only extends the previous one */
+    Token *prev = &out->tokens[out->count - 1];
+    bool merge = prev->type == type;
+    if (!merge) {
+      const char *p = text + prev->offset, *pe = p + prev->length;
+      while (p < pe && is_space(*p)) { p++; }
+      merge = p == pe;
+    }
+    if (merge) {
+      prev->type = type;
+      prev->length += end - start;
+      return;
+    }
+  }
+  if (out->count == out->capacity) {
+    out->capacity = out->capacity ? out->capacity * 2 : 32;
+    out->tokens = check_alloc(realloc(out->tokens, out->capacity * sizeof(Token)));
+  }
+  Token *t = &out->tokens[out->count++];
+  t->offset = start;
+  t->length = end - start;
+  t->type = type;
+}
+
+
+static int symbol_type(const Tokenizer *tk, const char *text, size_t len, int type) {
+  if (tk->symbol_count == 0 || len > tk->symbol_max_len) { return type; }
+  const Symbol *sym = find_symbol(tk, text, len);
+  return sym->text ? sym->type : type;
+}
+
+
+/* Tokenizes `text` starting in `state` (0, or the 1-based index of the pair
+** pattern whose end has not been seen yet) into `out` and returns the state at
+** the end of the text. */
+int tk_tokenize(const Tokenizer *tk, const char *text, size_t len, int state, TokenList *out) {
+  out->count = 0;
+  if (state < 1 || state > tk->pattern_count || !tk->patterns[state - 1].pair) { state = 0; }
+  if (tk->pattern_count == 0) {
+    push_token(out, text, 0, 0, len);
+    return 0;
+  }
+
+  size_t i = 0;
+  while (i < len) {
+    /* continue trying to match the end pattern of a pair if we have a state set */
+    if (state) {
+      const Pattern *p = &tk->patterns[state - 1];
+      size_t s, e;
+      if (find_non_escaped(p, text, len, i, &s, &e)) {
+        push_token(out, text, p->type, i, e);
+        state = 0;
+        i = e;
+      } else {
+        push_token(out, text, p->type, i, len);
+        break;
+      }
+    }
+
+    /* find matching pattern */
+    int c = i < len ? (unsigned char) text[i] : END_OF_TEXT;
+    const int *n = tk->dispatch + tk->dispatch_start[c];
+    const int *ne = tk->dispatch + tk->dispatch_start[c + 1];
+    bool matched = false;
+    for (; n < ne; n++) {
+      const Pattern *p = &tk->patterns[*n];
+      const char *res = match_at(&p->start, text, len, i);
+      if (!res) { continue; }
+      size_t e = res - text;
+      push_token(out, text, symbol_type(tk, text + i, e - i, p->type), i, e);
+      if (p->pair) { state = *n + 1; }
+      /* an empty match would make the Lua version loop forever; consume the
+      ** character as normal text instead */
+      matched = e > i || i == len;
+      i = e;
+      break;
+    }
+
+    /* consume character if we didn't match */
+    if (!matched) {
+      push_token(out, text, 0, i, i < len ? i + 1 : i);
+      i++;
+    }
+  }
+
+  return state;
+}
+
+
+void tk_list_free(TokenList *list) {
+  free(list->tokens);
+  list->tokens = NULL;
+  list->count = list->capacity = 0;
+}
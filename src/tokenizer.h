@@ -0,0 +1,33 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct Tokenizer Tokenizer;
+
+/* a run of `length` bytes starting at `offset` in the tokenized text; `type`
+** indexes the type names of the tokenizer, 0 is always "normal" */
+typedef struct {
+  uint32_t offset, length;
+  uint16_t type;
+} Token;
+
+typedef struct {
+  Token *tokens;
+  int count, capacity;
+} TokenList;
+
+Tokenizer*  tk_new(void);
+void        tk_free(Tokenizer *tk);
+int         tk_add_type(Tokenizer *tk, const char *name);
+const char* tk_add_pattern(Tokenizer *tk, const char *start, size_t start_len,
+                           const char *end, size_t end_len, int escape, int type);
+void        tk_add_symbol(Tokenizer *tk, const char *text, size_t len, int type);
+void        tk_finish(Tokenizer *tk);
+int         tk_type_count(const Tokenizer *tk);
+const char* tk_type_name(const Tokenizer *tk, int type);
+int         tk_tokenize(const Tokenizer *tk, const char *text, size_t len, int state, TokenList *out);
+void        tk_list_free(TokenList *list);
+
+#endif
@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "tokenlines.h"
+
+/* The highlighted lines of a document. Instead of a Lua table of type/text
+** strings per line, the tokens of all lines are runs of (offset, length, type)
+** in one arena and every line only records where its runs are, its states and
+** a hash of the text it was tokenized from; the text itself stays in the
+** document. A line that gets more runs than it had is appended to the arena,
+** and the arena is compacted in line order once more than half of it is
+** garbage.
+**
+** Type names are interned per TokenLines, so lines tokenized by the Lua
+** tokenizer can be stored too. Types of a native tokenizer are mapped once
+** for the last tokenizer used; the caller keeps that tokenizer alive. */
+
+#define MAX_RUN_LENGTH 0xffff
+
+typedef struct {
+  /* 0 for lines that were never set */
+  uint64_t hash;
+  uint32_t first, count;
+  uint32_t length;
+  uint16_t init_state, state;
+} Line;
+
+struct TokenLines {
+  Line *lines;
+  int line_capacity;
+  TokenRun *runs;
+  size_t run_count, run_capacity, garbage;
+  char **types;
+  int type_count, type_capacity;
+  /* types of `mapped` to ours */
+  const Tokenizer *mapped;
+  int *map;
+};
+
+
+static void* check_alloc(void *ptr) {
+  if (!ptr) {
+    fprintf(stderr, "Fatal error: memory allocation failed\n");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
+
+
+TokenLines* tl_new(void) {
+  TokenLines *tl = check_alloc(calloc(1, sizeof(TokenLines)));
+  tl_add_type(tl, "normal");
+  return tl;
+}
+
+
+void tl_free(TokenLines *tl) {
+  for (int i = 0; i < tl->type_count; i++) { free(tl->types[i]); }
+  free(tl->types);
+  free(tl->lines);
+  free(tl->runs);
+  free(tl->map);
+  free(tl);
+}
+
+
+int tl_add_type(TokenLines *tl, const char *name) {
+  for (int i = 0; i < tl->type_count; i++) {
+    if (strcmp(tl->types[i], name) == 0) { return i; }
+  }
+  if (tl->type_count == tl->type_capacity) {
+    tl->type_capacity = tl->type_capacity ? tl->type_capacity * 2 : 16;
+    tl->types = check_alloc(realloc(tl->types, tl->type_capacity * sizeof(char*)));
+  }
+  tl->types[tl->type_count] = check_alloc(malloc(strlen(name) + 1));
+  strcpy(tl->types[tl->type_count], name);
+  return tl->type_count++;
+}
+
+
+const char* tl_type_name(const TokenLines *tl, int type) {
+  return type >= 0 && type < tl->type_count ? tl->types[type] : NULL;
+}
+
+
+uint64_t tl_hash(const char *text, size_t len) {
+  /* FNV-1a, never 0 */
+  uint64_t h = 14695981039346656037ull;
+  for (size_t i = 0; i < len; i++) {
+    h = (h ^ (unsigned char) text[i]) * 1099511628211ull;
+  }
+  return h ? h : 1;
+}
+
+
+static Line* get_line(const TokenLines *tl, int idx) {
+  if (idx < 1 || idx > tl->line_capacity) { return NULL; }
+  Line *line = &tl->lines[idx - 1];
+  return line->hash ? line : NULL;
+}
+
+
+static void map_types(TokenLines *tl, const Tokenizer *tk) {
+  int n = tk_type_count(tk);
+  tl->map = check_alloc(realloc(tl->map, n * sizeof(int)));
+  for (int i = 0; i < n; i++) { tl->map[i] = tl_add_type(tl, tk_type_name(tk, i)); }
+  tl->mapped = tk;
+}
+
+
+static void compact(TokenLines *tl) {
+  TokenRun *runs = check_alloc(malloc(tl->run_capacity * sizeof(TokenRun)));
+  size_t n = 0;
+  for (int i = 0; i < tl->line_capacity; i++) {
+    Line *line = &tl->lines[i];
+    if (!line->hash) { continue; }
+    memcpy(runs + n, tl->runs + line->first, line->count * sizeof(TokenRun));
+    line->first = n;
+    n += line->count;
+  }
+  free(tl->runs);
+  tl->runs = runs;
+  tl->run_count = n;
+  tl->garbage = 0;
+}
+
+
+/* returns room for `count` runs of the line */
+static TokenRun* alloc_runs(TokenLines *tl, Line *line, size_t count) {
+  if (count <= line->count) {
+    tl->garbage += line->count - count;
+    line->count = count;
+    return tl->runs + line->first;
+  }
+  tl->garbage += line->count;
+  line->count = 0;
+  if (tl->run_count + count > tl->run_capacity && tl->garbage > tl->run_count / 2) {
+    compact(tl);
+  }
+  if (tl->run_count + count > tl->run_capacity) {
+    tl->run_capacity = (tl->run_count + count) * 2;
+    tl->runs = check_alloc(realloc(tl->runs, tl->run_capacity * sizeof(TokenRun)));
+  }
+  line->first = tl->run_count;
+  line->count = count;
+  tl->run_count += count;
+  return tl->runs + line->first;
+}
+
+
+/* stores the tokens of line `idx`, which had the text of `hash` and `length`.
+** Token types are those of `tk`, or already ours if it is NULL */
+void tl_set(TokenLines *tl, int idx, const Tokenizer *tk, const Token *tokens, int count,
+            int init_state, int state, uint64_t hash, size_t length) {
+  if (idx < 1) { return; }
+  if (idx > tl->line_capacity) {
+    int capacity = tl->line_capacity ? tl->line_capacity : 64;
+    while (capacity < idx) { capacity *= 2; }
+    tl->lines = check_alloc(realloc(tl->lines, capacity * sizeof(Line)));
+    memset(tl->lines + tl->line_capacity, 0, (capacity - tl->line_capacity) * sizeof(Line));
+    tl->line_capacity = capacity;
+  }
+  if (tk && tk != tl->mapped) { map_types(tl, tk); }
+
+  /* empty tokens are kept as the Lua tokenizer has them too */
+  size_t n = 0;
+  for (int i = 0; i < count; i++) {
+    n += tokens[i].length ? (tokens[i].length + MAX_RUN_LENGTH - 1) / MAX_RUN_LENGTH : 1;
+  }
+  Line *line = &tl->lines[idx - 1];
+  if (!line->hash) { line->count = 0; }
+  TokenRun *run = alloc_runs(tl, line, n);
+  for (int i = 0; i < count; i++) {
+    int type = tk ? tl->map[tokens[i].type] : tokens[i].type;
+    size_t offset = tokens[i].offset, end = offset + tokens[i].length;
+    do {
+      run->offset = offset;
+      run->length = end - offset < MAX_RUN_LENGTH ? end - offset : MAX_RUN_LENGTH;
+      run->type = type;
+      run++;
+      offset += run[-1].length;
+    } while (offset < end);
+  }
+  line->hash = hash;
+  line->length = length;
+  line->init_state = init_state;
+  line->state = state;
+}
+
+
+/* whether line `idx` was tokenized from the text of `hash` and `length` */
+bool tl_matches(const TokenLines *tl, int idx, uint64_t hash, size_t length) {
+  const Line *line = get_line(tl, idx);
+  return line && line->hash == hash && line->length == length;
+}
+
+
+bool tl_states(const TokenLines *tl, int idx, int *init_state, int *state) {
+  const Line *line = get_line(tl, idx);
+  if (!line) { return false; }
+  *init_state = line->init_state;
+  *state = line->state;
+  return true;
+}
+
+
+/* returns the runs of line `idx` or NULL if it was never set */
+const TokenRun* tl_get(const TokenLines *tl, int idx, int *count) {
+  static const TokenRun none;
+  const Line *line = get_line(tl, idx);
+  if (!line) { return NULL; }
+  *count = line->count;
+  return line->count ? tl->runs + line->first : &none;
+}
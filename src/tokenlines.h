@@ -0,0 +1,29 @@
+#ifndef TOKENLINES_H
+#define TOKENLINES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "tokenizer.h"
+
+typedef struct TokenLines TokenLines;
+
+/* a token as stored, longer runs are split; `type` indexes the type names of
+** the TokenLines, not of the tokenizer */
+typedef struct {
+  uint32_t offset;
+  uint16_t length, type;
+} TokenRun;
+
+TokenLines*     tl_new(void);
+void            tl_free(TokenLines *tl);
+int             tl_add_type(TokenLines *tl, const char *name);
+const char*     tl_type_name(const TokenLines *tl, int type);
+uint64_t        tl_hash(const char *text, size_t len);
+void            tl_set(TokenLines *tl, int idx, const Tokenizer *tk, const Token *tokens, int count,
+                       int init_state, int state, uint64_t hash, size_t length);
+bool            tl_matches(const TokenLines *tl, int idx, uint64_t hash, size_t length);
+bool            tl_states(const TokenLines *tl, int idx, int *init_state, int *state);
+const TokenRun* tl_get(const TokenLines *tl, int idx, int *count);
+
+#endif